@@ -0,0 +1,1327 @@
+/*
+Time-partitioned archive of the customer orders. Only the last ARCHIVE_HOT_DAYS days of orders are kept in
+memory; at startup every older line item is sealed, with its returns, into the snapshot file of the day it
+was placed and dropped from the order list. A sealed day is read back only when a listing, a lookup or a
+return asks for it, and only a few days stay loaded at once, so memory follows the hot window instead of the
+whole order history. The index file lists every day with the generation of its file and the range of its
+order numbers, so finding an order's day reads nothing but the index, which is loaded at startup. It also
+carries the units the sealed line items kept of every product, kept up to date by every seal and return, so
+the stock levels are settled at startup without reading any day.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "archive.h"
+#include "snapshot.h"
+
+//a line item or return on its way into a segment, position keeps equal days in the order they were found
+typedef struct {
+    order_t order;
+    long day;
+    size_t position;
+    int isReturnEntry;
+} sealed_item_t;
+
+//line items and returns of a day being read back
+typedef struct {
+    archive_segment_t *segment;
+    size_t itemCapacity;
+    size_t returnCapacity;
+} segment_reader_t;
+
+//days since 1970-01-01 of a date in the proleptic Gregorian calendar
+static long days_from_civil(long year, long month, long day) 
+{
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yearOfEra = year - era * 400;
+    long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+    return era * 146097 + dayOfEra - 719468;
+}
+
+//date of a day since 1970-01-01, the inverse of days_from_civil
+static void civil_from_days(long days, long *year, long *month, long *day) 
+{
+    days += 719468;
+    long era = (days >= 0 ? days : days - 146096) / 146097;
+    long dayOfEra = days - era * 146097;
+    long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    long monthIndex = (5 * dayOfYear + 2) / 153;
+
+    *day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    *month = monthIndex + (monthIndex < 10 ? 3 : -9);
+    *year = yearOfEra + era * 400 + (*month <= 2);
+}
+
+long day_of(unsigned int timestamp) 
+{
+    return (long)(timestamp / SECONDS_PER_DAY);
+}
+
+void format_day(long day, char *text) 
+{
+    long year, month, dayOfMonth;
+    civil_from_days(day, &year, &month, &dayOfMonth);
+
+    snprintf(text, MAX_DATE, "%04ld-%02ld-%02ld", year, month, dayOfMonth);
+}
+
+//reads the date at the start of text, returns the characters used or 0 if it isn't a date that exists
+static int read_date(const char *text, long *day) 
+{
+    int year, month, dayOfMonth;
+    int used = 0;
+
+    if (sscanf(text, "%4d-%2d-%2d%n", &year, &month, &dayOfMonth, &used) != 3 || used != MAX_DATE - 1) 
+    {
+        return 0;
+    }
+
+    //a date that doesn't exist (like February 30) comes back as a different one
+    long candidate = days_from_civil(year, month, dayOfMonth);
+    long checkYear, checkMonth, checkDay;
+    civil_from_days(candidate, &checkYear, &checkMonth, &checkDay);
+
+    if (checkYear != year || checkMonth != month || checkDay != dayOfMonth) 
+    {
+        return 0;
+    }
+
+    *day = candidate;
+    return used;
+}
+
+int parse_day(const char *text, long *day) 
+{
+    long candidate;
+
+    if (read_date(text, &candidate) == 0 || text[MAX_DATE - 1] != '\0') 
+    {
+        return 0;
+    }
+
+    *day = candidate;
+    return 1;
+}
+
+void format_timestamp(unsigned int timestamp, char *text) 
+{
+    char date[MAX_DATE];
+    unsigned int seconds = timestamp % SECONDS_PER_DAY;
+
+    format_day(day_of(timestamp), date);
+    snprintf(text, MAX_TIMESTAMP, "%s %02u:%02u:%02u", date, seconds / 3600, seconds / 60 % 60, seconds % 60);
+}
+
+int parse_timestamp(const char *text, unsigned int *timestamp) 
+{
+    long day;
+    int hours, minutes, seconds;
+    char rest;
+    int used = read_date(text, &day);
+
+    //anything after the time other than spaces means it isn't one
+    if (used == 0 || sscanf(text + used, " %2d:%2d:%2d %c", &hours, &minutes, &seconds, &rest) != 3 ||
+        hours > 23 || minutes > 59 || seconds > 59 || hours < 0 || minutes < 0 || seconds < 0) {
+        return 0;
+    }
+
+    long long value = (long long)day * SECONDS_PER_DAY + hours * 3600 + minutes * 60 + seconds;
+
+    if (value <= 0 || value > UINT_MAX) 
+    {
+        return 0;
+    }
+
+    *timestamp = (unsigned int)value;
+    return 1;
+}
+
+//file holding a generation of a sealed day
+static void segment_filename(const archive_t *archive, long day, unsigned long generation, char *filename) 
+{
+    char date[MAX_DATE];
+    format_day(day, date);
+
+    if (generation == 0) 
+    {
+        snprintf(filename, FILENAME_MAX, "%s/%s.seg", archive->directory, date);
+    } else {
+        snprintf(filename, FILENAME_MAX, "%s/%s.%lu.seg", archive->directory, date, generation);
+    }
+}
+
+//sorts sealed days oldest first
+static int compare_segments(const void *a, const void *b) 
+{
+    long dayA = ((const archive_segment_t *)a)->day;
+    long dayB = ((const archive_segment_t *)b)->day;
+
+    return (dayA > dayB) - (dayA < dayB);
+}
+
+//adds a day to the list, unloaded, and keeps the list in order
+static void add_segment(archive_t *archive, long day) 
+{
+    if (archive->count == archive->capacity) 
+    {
+        size_t capacity = archive->capacity == 0 ? 64 : archive->capacity * 2;
+        archive_segment_t *segments = (archive_segment_t *)realloc(archive->segments, capacity * sizeof(archive_segment_t));
+
+        if (!segments) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        archive->segments = segments;
+        archive->capacity = capacity;
+    }
+
+    memset(&archive->segments[archive->count], 0, sizeof(archive_segment_t));
+    archive->segments[archive->count++].day = day;
+
+    if (archive->count > 1 && archive->segments[archive->count - 2].day > day) 
+    {
+        qsort(archive->segments, archive->count, sizeof(archive_segment_t), compare_segments);
+    }
+}
+
+//finds the kept units of a product, or the empty slot where they belong
+static archive_kept_t *kept_slot(archive_kept_t *kept, size_t capacity, int productNumber) 
+{
+    size_t mask = capacity - 1;
+    size_t slot = hash_product_number(productNumber, mask);
+
+    while (kept[slot].used && kept[slot].productNumber != productNumber) 
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return &kept[slot];
+}
+
+//adds units to the kept units of a product (takes them off when negative), the archive lock is held
+static void add_kept_units(archive_t *archive, int productNumber, long long units) 
+{
+    //the table never gets more than half full
+    if ((archive->keptCount + 1) * 2 > archive->keptCapacity) 
+    {
+        size_t capacity = archive->keptCapacity == 0 ? 64 : archive->keptCapacity * 2;
+        archive_kept_t *kept = (archive_kept_t *)calloc(capacity, sizeof(archive_kept_t));
+
+        if (!kept) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        for (size_t i = 0; i < archive->keptCapacity; i++) 
+        {
+            if (archive->kept[i].used) 
+            {
+                *kept_slot(kept, capacity, archive->kept[i].productNumber) = archive->kept[i];
+            }
+        }
+
+        free(archive->kept);
+        archive->kept = kept;
+        archive->keptCapacity = capacity;
+    }
+
+    archive_kept_t *entry = kept_slot(archive->kept, archive->keptCapacity, productNumber);
+
+    if (!entry->used) 
+    {
+        entry->productNumber = productNumber;
+        entry->used = 1;
+        archive->keptCount++;
+    }
+
+    entry->units += units;
+}
+
+long long archive_kept_units(archive_t *archive, int productNumber) 
+{
+    long long units = 0;
+
+    pthread_mutex_lock(&archive->lock);
+
+    if (archive->keptCapacity > 0) 
+    {
+        const archive_kept_t *entry = kept_slot(archive->kept, archive->keptCapacity, productNumber);
+        units = entry->used ? entry->units : 0;
+    }
+
+    pthread_mutex_unlock(&archive->lock);
+
+    return units;
+}
+
+//reads a segment file name ('YYYY-MM-DD.seg' or 'YYYY-MM-DD.N.seg'), returns 0 if it isn't one
+static int parse_segment_filename(const char *name, long *day, unsigned long *generation) 
+{
+    char date[MAX_DATE];
+    char *end;
+    size_t length = strlen(name);
+
+    if (length < MAX_DATE - 1 + 4 || strcmp(name + length - 4, ".seg") != 0) 
+    {
+        return 0;
+    }
+
+    memcpy(date, name, MAX_DATE - 1);
+    date[MAX_DATE - 1] = '\0';
+
+    if (!parse_day(date, day)) 
+    {
+        return 0;
+    }
+
+    if (length == MAX_DATE - 1 + 4) 
+    {
+        *generation = 0;
+        return 1;
+    }
+
+    //'.N' between the date and '.seg', with N at least 1
+    if (name[MAX_DATE - 1] != '.' || name[MAX_DATE] < '1' || name[MAX_DATE] > '9') 
+    {
+        return 0;
+    }
+
+    *generation = strtoul(name + MAX_DATE, &end, 10);
+
+    return end == name + length - 4;
+}
+
+//widens the day's order number ranges to hold an order, each node gets its own range while there is room
+static void add_to_ranges(archive_segment_t *segment, order_id_t orderId) 
+{
+    order_id_t node = orderId >> ORDER_ID_NODE_SHIFT;
+    archive_range_t *range = NULL;
+
+    for (size_t i = 0; i < segment->rangeCount && range == NULL; i++) 
+    {
+        if (segment->ranges[i].first >> ORDER_ID_NODE_SHIFT == node && segment->ranges[i].last >> ORDER_ID_NODE_SHIFT == node) 
+        {
+            range = &segment->ranges[i];
+        }
+    }
+
+    if (range == NULL && segment->rangeCount < ARCHIVE_DAY_RANGES) 
+    {
+        range = &segment->ranges[segment->rangeCount++];
+        range->first = orderId;
+        range->last = orderId;
+    } else if (range == NULL) 
+    {
+        range = &segment->ranges[ARCHIVE_DAY_RANGES - 1];
+    }
+
+    if (orderId < range->first) 
+    {
+        range->first = orderId;
+    }
+    if (orderId > range->last) 
+    {
+        range->last = orderId;
+    }
+}
+
+//a day being read to rebuild the index
+typedef struct {
+    archive_t *archive;
+    archive_segment_t *segment;
+} segment_indexer_t;
+
+//widens the ranges of the segment being indexed by every record read, and counts the units its line items kept
+static void index_segment_record(void *context, const order_t *order, int isReturnEntry) 
+{
+    segment_indexer_t *indexer = (segment_indexer_t *)context;
+
+    add_to_ranges(indexer->segment, order->orderId);
+
+    if (!isReturnEntry) 
+    {
+        add_kept_units(indexer->archive, order->productNumber, order->quantity - order->returnedQuantity);
+    }
+}
+
+//sets a day's ranges to the order numbers of every line item held in a list of its records
+static void index_segment(archive_segment_t *segment, const order_list_t *day) 
+{
+    segment->rangeCount = 0;
+
+    for (size_t s = 0; s < ORDER_SHARDS; s++) 
+    {
+        for (const order_chunk_t *chunk = day->shards[s].current.head; chunk != NULL; chunk = chunk->next) 
+        {
+            for (size_t i = 0; i < chunk->count; i++) 
+            {
+                add_to_ranges(segment, chunk->orders[i].orderId);
+            }
+        }
+    }
+}
+
+//writes the index out through a synced temp file, this is what makes a new generation count
+//returns 0 on success and -1 on failure. The archive lock is held
+static int write_index(const archive_t *archive) 
+{
+    char filename[FILENAME_MAX];
+    char *data = NULL;
+    size_t size = 0;
+    FILE *text = open_memstream(&data, &size);
+
+    if (!text) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(text, "archive index 2\n");
+
+    for (size_t i = 0; i < archive->count; i++) 
+    {
+        const archive_segment_t *segment = &archive->segments[i];
+        char date[MAX_DATE];
+
+        format_day(segment->day, date);
+        fprintf(text, "%s %lu %zu", date, segment->generation, segment->rangeCount);
+
+        for (size_t r = 0; r < segment->rangeCount; r++) 
+        {
+            fprintf(text, " %llu %llu", (unsigned long long)segment->ranges[r].first, (unsigned long long)segment->ranges[r].last);
+        }
+
+        fprintf(text, "\n");
+    }
+
+    for (size_t i = 0; i < archive->keptCapacity; i++) 
+    {
+        if (archive->kept[i].used && archive->kept[i].units != 0) 
+        {
+            fprintf(text, "kept %d %lld\n", archive->kept[i].productNumber, archive->kept[i].units);
+        }
+    }
+
+    fclose(text);
+
+    snprintf(filename, sizeof(filename), "%s/%s", archive->directory, ARCHIVE_INDEX_FILE);
+    int result = replace_file(filename, data, size);
+
+    free(data);
+
+    return result;
+}
+
+//reads the days and kept units from the index, returns 0 on success and -1 if it's missing, can't be read or was
+//written before it carried kept units (nothing is kept then)
+static int read_index(archive_t *archive) 
+{
+    char filename[FILENAME_MAX];
+    char line[1024];
+    int valid = 1;
+
+    snprintf(filename, sizeof(filename), "%s/%s", archive->directory, ARCHIVE_INDEX_FILE);
+
+    FILE *file = fopen(filename, "r");
+
+    if (!file) 
+    {
+        return -1;
+    }
+
+    valid = fgets(line, sizeof(line), file) != NULL && strcmp(line, "archive index 2\n") == 0;
+
+    while (valid && fgets(line, sizeof(line), file) != NULL) 
+    {
+        char date[MAX_DATE];
+        long day;
+        unsigned long generation;
+        size_t rangeCount;
+        int used;
+        int productNumber;
+        long long units;
+
+        if (strncmp(line, "kept ", 5) == 0) 
+        {
+            valid = sscanf(line, "kept %d %lld", &productNumber, &units) == 2 && units >= 0;
+
+            if (valid) 
+            {
+                add_kept_units(archive, productNumber, units);
+            }
+            continue;
+        }
+
+        if (sscanf(line, "%10s %lu %zu%n", date, &generation, &rangeCount, &used) != 3 || !parse_day(date, &day) ||
+            rangeCount > ARCHIVE_DAY_RANGES || (archive->count > 0 && archive->segments[archive->count - 1].day >= day)) {
+            valid = 0;
+            break;
+        }
+
+        add_segment(archive, day);
+
+        archive_segment_t *segment = &archive->segments[archive->count - 1];
+        segment->generation = generation;
+
+        for (size_t r = 0; r < rangeCount && valid; r++) 
+        {
+            unsigned long long first;
+            unsigned long long last;
+            int length;
+
+            valid = sscanf(line + used, " %llu %llu%n", &first, &last, &length) == 2 && first <= last;
+            used += length;
+
+            segment->ranges[r].first = (order_id_t)first;
+            segment->ranges[r].last = (order_id_t)last;
+        }
+
+        segment->rangeCount = rangeCount;
+    }
+
+    fclose(file);
+
+    if (!valid) 
+    {
+        free(archive->kept);
+        archive->kept = NULL;
+        archive->keptCapacity = 0;
+        archive->keptCount = 0;
+        archive->count = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+//removes the segment files the index doesn't point at, left over from a seal or return a crash cut short
+static void remove_unused_segments(archive_t *archive, DIR *folder) 
+{
+    struct dirent *entry;
+
+    while ((entry = readdir(folder)) != NULL) 
+    {
+        long day;
+        unsigned long generation;
+
+        if (!parse_segment_filename(entry->d_name, &day, &generation)) 
+        {
+            continue;
+        }
+
+        size_t index = archive_find_day(archive, day);
+
+        if (index == archive->count || archive->segments[index].day != day || archive->segments[index].generation != generation) 
+        {
+            char filename[FILENAME_MAX];
+
+            segment_filename(archive, day, generation, filename);
+            remove(filename);
+        }
+    }
+}
+
+//rebuilds the index of a directory written without one (or with one that can't be read), from the newest
+//generation of every day, each day is read once for its order numbers and kept units
+static void rebuild_index(archive_t *archive, DIR *folder) 
+{
+    struct dirent *entry;
+
+    while ((entry = readdir(folder)) != NULL) 
+    {
+        long day;
+        unsigned long generation;
+
+        if (!parse_segment_filename(entry->d_name, &day, &generation)) 
+        {
+            continue;
+        }
+
+        size_t index = archive_find_day(archive, day);
+
+        if (index == archive->count || archive->segments[index].day != day) 
+        {
+            add_segment(archive, day);
+            index = archive_find_day(archive, day);
+            archive->segments[index].generation = generation;
+        } else if (archive->segments[index].generation < generation) 
+        {
+            archive->segments[index].generation = generation;
+        }
+    }
+
+    for (size_t i = 0; i < archive->count; i++) 
+    {
+        char filename[FILENAME_MAX];
+
+        segment_indexer_t indexer = { archive, &archive->segments[i] };
+
+        segment_filename(archive, archive->segments[i].day, archive->segments[i].generation, filename);
+
+        if (read_snapshot(filename, NULL, index_segment_record, &indexer, NULL) < 0) 
+        {
+            printf("Error opening file: %s\n", filename);
+        }
+    }
+
+    if (archive->count > 0 && write_index(archive) != 0) 
+    {
+        printf("Error writing file: %s/%s\n", archive->directory, ARCHIVE_INDEX_FILE);
+    }
+}
+
+void open_archive(archive_t *archive, const char *directory) 
+{
+    memset(archive, 0, sizeof(archive_t));
+    snprintf(archive->directory, sizeof(archive->directory), "%s", directory);
+    pthread_mutex_init(&archive->lock, NULL);
+
+    DIR *folder = opendir(directory);
+
+    //nothing has been sealed yet, the new directory is synced into its parent so the segments don't outlive it
+    if (folder == NULL) 
+    {
+        if (mkdir(directory, 0755) == 0) 
+        {
+            sync_directory_of(directory);
+        }
+        return;
+    }
+
+    //the index says which generation of each day counts, files it doesn't list are from a write that never finished
+    if (read_index(archive) == 0) 
+    {
+        remove_unused_segments(archive, folder);
+    } else {
+        rebuild_index(archive, folder);
+    }
+
+    closedir(folder);
+}
+
+size_t archive_find_day(archive_t *archive, long day) 
+{
+    size_t low = 0;
+    size_t high = archive->count;
+
+    while (low < high) 
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (archive->segments[middle].day < day) 
+        {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+//sorts the line items and returns to seal by day, keeping the order they were found in within a day
+static int compare_sealed(const void *a, const void *b) 
+{
+    const sealed_item_t *itemA = (const sealed_item_t *)a;
+    const sealed_item_t *itemB = (const sealed_item_t *)b;
+
+    if (itemA->day != itemB->day) 
+    {
+        return itemA->day < itemB->day ? -1 : 1;
+    }
+
+    return (itemA->position > itemB->position) - (itemA->position < itemB->position);
+}
+
+//appends every line item or return of a store placed before cutoff to the list to seal
+static void collect_sealed(const order_store_t *store, unsigned int cutoff, int isReturnEntry, sealed_item_t **items,
+                           size_t *count, size_t *capacity) 
+{
+    for (const order_chunk_t *chunk = store->head; chunk != NULL; chunk = chunk->next) 
+    {
+        for (size_t i = 0; i < chunk->count; i++) 
+        {
+            const order_t *order = &chunk->orders[i];
+
+            //line items without a placement time have no day to go to, they stay in memory
+            if (order->placedAt == 0 || order->placedAt >= cutoff) 
+            {
+                continue;
+            }
+
+            if (*count == *capacity) 
+            {
+                *capacity = *capacity == 0 ? 1024 : *capacity * 2;
+                sealed_item_t *grown = (sealed_item_t *)realloc(*items, *capacity * sizeof(sealed_item_t));
+
+                if (!grown) 
+                {
+                    printf("Memory allocation failure.\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                *items = grown;
+            }
+
+            sealed_item_t *item = &(*items)[*count];
+            item->order = *order;
+            item->day = day_of(order->placedAt);
+            item->position = (*count)++;
+            item->isReturnEntry = isReturnEntry;
+        }
+    }
+}
+
+//adds a record of a segment that's being added to
+static void keep_sealed_record(void *context, const order_t *order, int isReturnEntry) 
+{
+    order_list_t *day = (order_list_t *)context;
+
+    if (isReturnEntry) 
+    {
+        add_return_entry(day, order);
+    } else {
+        add_line_item(day, order);
+    }
+}
+
+//frees a loaded day's line items, the archive lock is held
+static void unload_segment(archive_t *archive, archive_segment_t *segment) 
+{
+    if (segment->items != NULL) 
+    {
+        free(segment->items);
+        free(segment->returns);
+        segment->items = NULL;
+        segment->returns = NULL;
+        segment->itemCount = 0;
+        segment->returnCount = 0;
+        archive->loaded--;
+    }
+}
+
+//a day that was rewritten is read again the next time it's needed, the archive lock is held
+static void forget_loaded_day(archive_t *archive, archive_segment_t *segment) 
+{
+    if (segment->items == NULL) 
+    {
+        return;
+    }
+
+    if (segment->readers == 0) 
+    {
+        unload_segment(archive, segment);
+    } else {
+        segment->stale = 1;
+    }
+}
+
+//writes one day's line items and returns (items[0] to items[count - 1]) as the next generation of its segment, on
+//top of what the segment already holds, and points the day at it. Nothing counts until the index is written
+//returns 0 on success and -1 if it couldn't be written. The archive lock is held
+static int seal_day(archive_t *archive, const order_list_t *orders, const sealed_item_t *items, size_t count) 
+{
+    char filename[FILENAME_MAX];
+    size_t index = archive_find_day(archive, items[0].day);
+    int exists = index < archive->count && archive->segments[index].day == items[0].day;
+    order_list_t *day = create_orders();
+
+    //a crash after sealing but before the journal was compacted seals the same orders again
+    if (exists) 
+    {
+        segment_filename(archive, items[0].day, archive->segments[index].generation, filename);
+
+        if (read_snapshot(filename, &day->customers, keep_sealed_record, day, NULL) < 0) 
+        {
+            free_orders(day);
+            return -1;
+        }
+    }
+
+    //decide what's already there before adding anything, so the day's own line items aren't mistaken for repeats
+    unsigned char *repeated = (unsigned char *)calloc(count, 1);
+
+    if (!repeated) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; exists && i < count; i++) 
+    {
+        repeated[i] = shard_find_order(order_shard(day, items[i].order.orderId), items[i].order.orderId) != NULL;
+    }
+
+    for (size_t i = 0; i < count; i++) 
+    {
+        if (repeated[i]) 
+        {
+            continue;
+        }
+
+        //the segment has its own customer IDs
+        order_t order = items[i].order;
+        order.customerId = intern_customer(&day->customers, customer_name(&orders->customers, order.customerId));
+
+        keep_sealed_record(day, &order, items[i].isReturnEntry);
+    }
+
+    //a new day starts at generation 1, 0 is left to the files of builds before the index
+    unsigned long generation = exists ? archive->segments[index].generation + 1 : 1;
+
+    segment_filename(archive, items[0].day, generation, filename);
+
+    int result = save_snapshot(day, filename);
+
+    if (result == 0) 
+    {
+        if (!exists) 
+        {
+            add_segment(archive, items[0].day);
+            index = archive_find_day(archive, items[0].day);
+        }
+
+        archive->segments[index].generation = generation;
+        index_segment(&archive->segments[index], day);
+
+        //the line items that are new to the day add what they kept
+        for (size_t i = 0; i < count; i++) 
+        {
+            if (!repeated[i] && !items[i].isReturnEntry) 
+            {
+                add_kept_units(archive, items[i].order.productNumber, items[i].order.quantity - items[i].order.returnedQuantity);
+            }
+        }
+    }
+
+    free(repeated);
+    free_orders(day);
+
+    return result;
+}
+
+//finds the day of a segment in a copy of the list of days, NULL if it isn't there
+static const archive_segment_t *find_copied_day(const archive_segment_t *segments, size_t count, long day) 
+{
+    for (size_t i = 0; i < count; i++) 
+    {
+        if (segments[i].day == day) 
+        {
+            return &segments[i];
+        }
+    }
+
+    return NULL;
+}
+
+long long seal_archive(archive_t *archive, order_list_t *orders, long cutoffDay) 
+{
+    if (cutoffDay <= 0) 
+    {
+        return 0;
+    }
+
+    unsigned int cutoff = cutoffDay * SECONDS_PER_DAY > UINT_MAX ? UINT_MAX : (unsigned int)(cutoffDay * SECONDS_PER_DAY);
+    sealed_item_t *items = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    long long sealed = 0;
+
+    //in index order like the journal writer, which may start compacting the replayed journal meanwhile
+    for (size_t s = 0; s < ORDER_SHARDS; s++) 
+    {
+        pthread_mutex_lock(&orders->shards[s].lock);
+    }
+
+    pthread_mutex_lock(&archive->lock);
+
+    for (size_t s = 0; s < ORDER_SHARDS; s++) 
+    {
+        collect_sealed(&orders->shards[s].current, cutoff, 0, &items, &count, &capacity);
+        collect_sealed(&orders->shards[s].returns.entries, cutoff, 1, &items, &count, &capacity);
+    }
+
+    if (count > 1) 
+    {
+        qsort(items, count, sizeof(sealed_item_t), compare_sealed);
+    }
+
+    //the days as they were, to go back to if anything fails
+    size_t previousCount = archive->count;
+    archive_segment_t *previous = (archive_segment_t *)malloc((previousCount > 0 ? previousCount : 1) * sizeof(archive_segment_t));
+
+    if (!previous) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (previousCount > 0) 
+    {
+        memcpy(previous, archive->segments, previousCount * sizeof(archive_segment_t));
+    }
+
+    //and the kept units as they were
+    size_t previousKeptCapacity = archive->keptCapacity;
+    size_t previousKeptCount = archive->keptCount;
+    archive_kept_t *previousKept = (archive_kept_t *)malloc((previousKeptCapacity > 0 ? previousKeptCapacity : 1) * sizeof(archive_kept_t));
+
+    if (!previousKept) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (previousKeptCapacity > 0) 
+    {
+        memcpy(previousKept, archive->kept, previousKeptCapacity * sizeof(archive_kept_t));
+    }
+
+    //every day is written and synced (file and directory, see save_snapshot) as a new generation, then the index
+    //is, and only then does anything leave memory; a failed write or sync leaves the orders as they were
+    for (size_t first = 0; first < count && sealed >= 0; ) 
+    {
+        size_t last = first;
+
+        while (last < count && items[last].day == items[first].day) 
+        {
+            last++;
+        }
+
+        if (seal_day(archive, orders, &items[first], last - first) != 0) 
+        {
+            sealed = -1;
+        }
+
+        first = last;
+    }
+
+    if (count > 0 && sealed == 0 && write_index(archive) != 0) 
+    {
+        sealed = -1;
+    }
+
+    //whichever generations lost, the files of the days that moved on go
+    for (size_t i = 0; i < archive->count; i++) 
+    {
+        const archive_segment_t *before = find_copied_day(previous, previousCount, archive->segments[i].day);
+        char filename[FILENAME_MAX];
+
+        if (before != NULL && before->generation == archive->segments[i].generation) 
+        {
+            continue;
+        }
+
+        if (sealed < 0) 
+        {
+            segment_filename(archive, archive->segments[i].day, archive->segments[i].generation, filename);
+            remove(filename);
+        } else if (before != NULL) 
+        {
+            segment_filename(archive, before->day, before->generation, filename);
+            remove(filename);
+            forget_loaded_day(archive, &archive->segments[i]);
+        }
+    }
+
+    if (sealed < 0 && previousCount > 0) 
+    {
+        memcpy(archive->segments, previous, previousCount * sizeof(archive_segment_t));
+    }
+
+    if (sealed < 0) 
+    {
+        archive->count = previousCount;
+        free(archive->kept);
+        archive->kept = previousKept;
+        archive->keptCapacity = previousKeptCapacity;
+        archive->keptCount = previousKeptCount;
+    } else {
+        free(previousKept);
+    }
+
+    free(previous);
+
+    if (count > 0 && sealed == 0) 
+    {
+        sealed = (long long)drop_orders_placed_before(orders, cutoff);
+    }
+
+    pthread_mutex_unlock(&archive->lock);
+
+    for (size_t s = ORDER_SHARDS; s-- > 0; ) 
+    {
+        pthread_mutex_unlock(&orders->shards[s].lock);
+    }
+
+    free(items);
+
+    return sealed;
+}
+
+//orders a day's line items by when they were placed, then by order number, then as they were stored
+static int compare_placed(const void *a, const void *b) 
+{
+    const order_t *orderA = (const order_t *)a;
+    const order_t *orderB = (const order_t *)b;
+
+    if (orderA->placedAt != orderB->placedAt) 
+    {
+        return orderA->placedAt < orderB->placedAt ? -1 : 1;
+    }
+
+    if (orderA->orderId != orderB->orderId) 
+    {
+        return orderA->orderId < orderB->orderId ? -1 : 1;
+    }
+
+    return (orderA->column > orderB->column) - (orderA->column < orderB->column);
+}
+
+//appends a record to a growable array of the day being read back
+static void append_segment_record(order_t **records, size_t *count, size_t *capacity, const order_t *order) 
+{
+    if (*count == *capacity) 
+    {
+        *capacity = *capacity == 0 ? 256 : *capacity * 2;
+        order_t *grown = (order_t *)realloc(*records, *capacity * sizeof(order_t));
+
+        if (!grown) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        *records = grown;
+    }
+
+    //column has no shard to point into here, it holds the stored position for sorting instead
+    (*records)[*count] = *order;
+    (*records)[*count].column = (unsigned int)*count;
+    (*count)++;
+}
+
+static void read_segment_record(void *context, const order_t *order, int isReturnEntry) 
+{
+    segment_reader_t *reader = (segment_reader_t *)context;
+
+    if (isReturnEntry) 
+    {
+        append_segment_record(&reader->segment->returns, &reader->segment->returnCount, &reader->returnCapacity, order);
+    } else {
+        append_segment_record(&reader->segment->items, &reader->segment->itemCount, &reader->itemCapacity, order);
+    }
+}
+
+const archive_segment_t *archive_acquire(archive_t *archive, order_list_t *orders, size_t index) 
+{
+    if (index >= archive->count) 
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&archive->lock);
+
+    archive_segment_t *segment = &archive->segments[index];
+
+    //a day rewritten while someone was reading it is read again once they're done
+    if (segment->stale && segment->readers == 0) 
+    {
+        unload_segment(archive, segment);
+        segment->stale = 0;
+    }
+
+    if (segment->items == NULL) 
+    {
+        //make room by unloading the day used longest ago that nobody is reading
+        while (archive->loaded >= ARCHIVE_CACHE_SEGMENTS) 
+        {
+            archive_segment_t *oldest = NULL;
+
+            for (size_t i = 0; i < archive->count; i++) 
+            {
+                archive_segment_t *candidate = &archive->segments[i];
+
+                if (candidate->items != NULL && candidate->readers == 0 && (oldest == NULL || candidate->lastUsed < oldest->lastUsed)) 
+                {
+                    oldest = candidate;
+                }
+            }
+
+            //every loaded day is being read, go over the limit until one is released
+            if (oldest == NULL) 
+            {
+                break;
+            }
+
+            unload_segment(archive, oldest);
+        }
+
+        char filename[FILENAME_MAX];
+        segment_reader_t reader = { segment, 0, 0 };
+
+        segment_filename(archive, segment->day, segment->generation, filename);
+
+        if (read_snapshot(filename, &orders->customers, read_segment_record, &reader, NULL) < 0) 
+        {
+            free(segment->items);
+            free(segment->returns);
+            segment->items = NULL;
+            segment->returns = NULL;
+            segment->itemCount = 0;
+            segment->returnCount = 0;
+            pthread_mutex_unlock(&archive->lock);
+            return NULL;
+        }
+
+        //a day without line items still counts as loaded
+        if (segment->items == NULL) 
+        {
+            segment->items = (order_t *)malloc(sizeof(order_t));
+
+            if (!segment->items) 
+            {
+                printf("Memory allocation failure.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        if (segment->itemCount > 1) 
+        {
+            qsort(segment->items, segment->itemCount, sizeof(order_t), compare_placed);
+        }
+
+        if (segment->returnCount > 1) 
+        {
+            qsort(segment->returns, segment->returnCount, sizeof(order_t), compare_placed);
+        }
+
+        archive->loaded++;
+    }
+
+    segment->readers++;
+    segment->lastUsed = ++archive->clock;
+
+    pthread_mutex_unlock(&archive->lock);
+
+    return segment;
+}
+
+void archive_release(archive_t *archive, size_t index) 
+{
+    pthread_mutex_lock(&archive->lock);
+    archive->segments[index].readers--;
+    pthread_mutex_unlock(&archive->lock);
+}
+
+void scan_archive(archive_t *archive, order_list_t *orders, snapshot_visit_t visit, void *context) 
+{
+    char filename[FILENAME_MAX];
+
+    //each day is read under the lock, so a return can't replace its file halfway through
+    for (size_t i = 0; ; i++) 
+    {
+        pthread_mutex_lock(&archive->lock);
+
+        if (i >= archive->count) 
+        {
+            pthread_mutex_unlock(&archive->lock);
+            break;
+        }
+
+        segment_filename(archive, archive->segments[i].day, archive->segments[i].generation, filename);
+
+        if (read_snapshot(filename, &orders->customers, visit, context, NULL) < 0) 
+        {
+            printf("Error opening file: %s\n", filename);
+        }
+
+        pthread_mutex_unlock(&archive->lock);
+    }
+}
+
+//whether an order number lies in one of a day's ranges
+static int day_may_hold(const archive_segment_t *segment, order_id_t orderId) 
+{
+    for (size_t r = 0; r < segment->rangeCount; r++) 
+    {
+        if (orderId >= segment->ranges[r].first && orderId <= segment->ranges[r].last) 
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+size_t archive_find_order(archive_t *archive, order_id_t orderId, size_t index) 
+{
+    pthread_mutex_lock(&archive->lock);
+
+    while (index < archive->count && !day_may_hold(&archive->segments[index], orderId)) 
+    {
+        index++;
+    }
+
+    pthread_mutex_unlock(&archive->lock);
+
+    return index;
+}
+
+size_t archive_copy_order(archive_t *archive, order_list_t *orders, order_id_t orderId, order_t *items, size_t maxItems) 
+{
+    size_t count = 0;
+
+    //an order is sealed into one day, the first day that has it is the one
+    for (size_t index = archive_find_order(archive, orderId, 0); index < archive->count && count == 0;
+         index = archive_find_order(archive, orderId, index + 1)) {
+        const archive_segment_t *segment = archive_acquire(archive, orders, index);
+
+        if (segment == NULL) 
+        {
+            continue;
+        }
+
+        for (size_t i = 0; i < segment->itemCount; i++) 
+        {
+            if (segment->items[i].orderId == orderId) 
+            {
+                if (count < maxItems) 
+                {
+                    items[count] = segment->items[i];
+                }
+                count++;
+            }
+        }
+
+        archive_release(archive, index);
+    }
+
+    return count;
+}
+
+size_t archive_return(archive_t *archive, const char *orderNumber, int productNumber, int quantity,
+                      snapshot_visit_t visit, void *context) 
+{
+    order_id_t orderId;
+    size_t returned = 0;
+
+    if (!parse_order_number(orderNumber, &orderId)) 
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&archive->lock);
+
+    for (size_t index = 0; index < archive->count; index++) 
+    {
+        archive_segment_t *segment = &archive->segments[index];
+        char filename[FILENAME_MAX];
+
+        if (!day_may_hold(segment, orderId)) 
+        {
+            continue;
+        }
+
+        order_list_t *day = create_orders();
+        segment_filename(archive, segment->day, segment->generation, filename);
+
+        if (read_snapshot(filename, &day->customers, keep_sealed_record, day, NULL) < 0) 
+        {
+            printf("Error opening file: %s\n", filename);
+            free_orders(day);
+            continue;
+        }
+
+        //another order of the range, placed on some other day
+        if (shard_find_order(order_shard(day, orderId), orderId) == NULL) 
+        {
+            free_orders(day);
+            continue;
+        }
+
+        //the day's own list has no journal and no stock, the return is applied to it as to any other
+        const order_entry_t *ledger = shard_find_order_returns(order_shard(day, orderId), orderId);
+        size_t ledgerBefore = ledger != NULL ? ledger->count : 0;
+
+        returned = productNumber == 0 ? return_order(day, orderNumber) : (size_t)return_line_item(day, orderNumber, productNumber, quantity);
+
+        if (returned > 0) 
+        {
+            //the next generation only counts once the index points at it, with the units no longer kept
+            unsigned long previous = segment->generation;
+
+            ledger = shard_find_order_returns(order_shard(day, orderId), orderId);
+
+            for (size_t i = ledgerBefore; i < ledger->count; i++) 
+            {
+                add_kept_units(archive, ledger->items[i]->productNumber, -ledger->items[i]->quantity);
+            }
+
+            segment->generation++;
+            segment_filename(archive, segment->day, segment->generation, filename);
+
+            if (save_snapshot(day, filename) != 0 || write_index(archive) != 0) 
+            {
+                printf("Error writing file: %s\n", filename);
+                remove(filename);
+                segment->generation = previous;
+                returned = 0;
+
+                for (size_t i = ledgerBefore; i < ledger->count; i++) 
+                {
+                    add_kept_units(archive, ledger->items[i]->productNumber, ledger->items[i]->quantity);
+                }
+            } else {
+                segment_filename(archive, segment->day, previous, filename);
+                remove(filename);
+                forget_loaded_day(archive, segment);
+
+                for (size_t i = ledgerBefore; visit != NULL && i < ledger->count; i++) 
+                {
+                    visit(context, ledger->items[i], 1);
+                }
+            }
+        }
+
+        free_orders(day);
+        break;
+    }
+
+    pthread_mutex_unlock(&archive->lock);
+
+    return returned;
+}
+
+void close_archive(archive_t *archive) 
+{
+    for (size_t i = 0; i < archive->count; i++) 
+    {
+        free(archive->segments[i].items);
+        free(archive->segments[i].returns);
+    }
+
+    free(archive->segments);
+    free(archive->kept);
+    archive->segments = NULL;
+    archive->kept = NULL;
+    archive->keptCapacity = 0;
+    archive->keptCount = 0;
+    archive->count = 0;
+    archive->capacity = 0;
+    archive->loaded = 0;
+    pthread_mutex_destroy(&archive->lock);
+}
@@ -0,0 +1,125 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <pthread.h>
+#include "catalog_system.h"
+#include "snapshot.h"
+
+#define ARCHIVE_DIRECTORY "segments"   //where sealed days are kept, next to the data files
+#define ARCHIVE_INDEX_FILE "index"     //in the directory: every sealed day, which file holds it and its order numbers,
+                                       //and the units sealed line items kept of each product
+#ifndef ARCHIVE_HOT_DAYS
+#define ARCHIVE_HOT_DAYS 30            //days of orders kept in memory, older ones are sealed into segments
+#endif
+#define ARCHIVE_CACHE_SEGMENTS 4       //sealed days kept loaded at once, the least recently used one goes first
+#define ARCHIVE_DAY_RANGES 4           //order number ranges kept per day, one per node, more nodes widen the last
+#define SECONDS_PER_DAY 86400
+#define MAX_DATE 11                    //"YYYY-MM-DD" plus the terminator
+#define MAX_TIMESTAMP 20               //"YYYY-MM-DD HH:MM:SS" plus the terminator
+
+//the order numbers of one node sealed into a day run from first to last (others in between may be elsewhere)
+typedef struct {
+    order_id_t first;
+    order_id_t last;
+} archive_range_t;
+
+//units the sealed line items of one product kept (weren't returned), so stock is settled without reading any day
+typedef struct {
+    int productNumber;
+    int used;             //0 marks an empty slot
+    long long units;
+} archive_kept_t;
+
+//one sealed day, its line items and returns are read from its file the first time they're needed
+typedef struct {
+    long day;             //days since 1970-01-01 (UTC)
+    unsigned long generation; //file holding the day: 'YYYY-MM-DD.seg' for 0, 'YYYY-MM-DD.N.seg' after N rewrites
+    archive_range_t ranges[ARCHIVE_DAY_RANGES]; //where the day's order numbers lie, to find an order's day
+    size_t rangeCount;
+    order_t *items;       //line items in the order they were placed, NULL while the day isn't loaded
+    size_t itemCount;
+    order_t *returns;     //returns ledger entries of the day's orders, in the same order
+    size_t returnCount;
+    unsigned long lastUsed; //archive clock when the day was last read, picks the one to unload
+    int readers;            //acquires not yet released, a day is only unloaded at 0
+    int stale;              //1 once the day was rewritten while loaded, it's read again when nobody holds it
+} archive_segment_t;
+
+/*the days of orders that left memory: each day is a snapshot file in the directory. A day is never changed in
+place: sealing more orders into it or returning one of its orders writes the next generation of its file, and
+only rewriting the index makes it count, so a crash leaves either the old day or the new one. Customer IDs of
+loaded days are in the order list's customer pool*/
+typedef struct archive {
+    char directory[FILENAME_MAX - MAX_DATE - 26]; //leaves room for '/YYYY-MM-DD.N.seg'
+    archive_segment_t *segments; //every sealed day, oldest first
+    size_t count;
+    size_t capacity;
+    size_t loaded;               //days with their line items in memory
+    unsigned long clock;         //moves forward once per acquire
+    archive_kept_t *kept;        //open addressing by product number, written to the index with the days
+    size_t keptCapacity;         //always a power of two (0 until the first product is sealed)
+    size_t keptCount;
+    pthread_mutex_t lock;        //guards everything above
+} archive_t;
+
+//function declarations
+
+//reads the sealed days from the directory's index (created if it's missing), none are loaded yet
+//a directory sealed by an older build without an index (or without kept units in it) has its days read once to write one
+void open_archive(archive_t *archive, const char *directory);
+
+/*moves every line item placed before cutoffDay, with its returns, out of the orders into the segment of its
+day, returns how many line items were sealed or -1 if a segment couldn't be written (nothing is removed then).
+Every shard stays locked while it works. The caller compacts the journal afterwards, since it still holds the
+sealed line items; sealing them again after a crash adds nothing to their segments*/
+long long seal_archive(archive_t *archive, order_list_t *orders, long cutoffDay);
+
+//index of the first sealed day on or after day (count if there is none)
+size_t archive_find_day(archive_t *archive, long day);
+
+//index of the first sealed day from index on whose order numbers could include orderId (count if there is none)
+size_t archive_find_order(archive_t *archive, order_id_t orderId, size_t index);
+
+//copies up to maxItems line items of a sealed order into items, in the order they were placed, returns how many
+//line items the order has (0 if no sealed day holds it). Customer IDs are the orders' pool's, like archive_acquire's
+size_t archive_copy_order(archive_t *archive, order_list_t *orders, order_id_t orderId, order_t *items, size_t maxItems);
+
+/*returns a sealed order the way return_order (productNumber 0) or return_line_item would, by writing the
+next generation of its day with the return in it. visit is handed every returns ledger entry added, so the
+caller can put the units back in stock. Returns what those functions would*/
+size_t archive_return(archive_t *archive, const char *orderNumber, int productNumber, int quantity,
+                      snapshot_visit_t visit, void *context);
+
+//units of a product that the sealed line items kept, taken from the index rather than the days
+long long archive_kept_units(archive_t *archive, int productNumber);
+
+//loads a sealed day if it isn't in memory and keeps it there until the matching release, NULL if it can't be read
+//customer names are interned into the orders' pool so its line items can be rendered like the rest
+const archive_segment_t *archive_acquire(archive_t *archive, order_list_t *orders, size_t index);
+
+//gives back a day taken with archive_acquire
+void archive_release(archive_t *archive, size_t index);
+
+//hands every line item and return of every sealed day to visit, oldest day first, their customer names are
+//interned into the orders' pool. The days are read straight from their files, loaded or not, and none is kept
+void scan_archive(archive_t *archive, order_list_t *orders, snapshot_visit_t visit, void *context);
+
+//frees every loaded day and the list of days
+void close_archive(archive_t *archive);
+
+//day of a timestamp (seconds since 1970-01-01 UTC)
+long day_of(unsigned int timestamp);
+
+//writes a day as "YYYY-MM-DD", text holds MAX_DATE bytes
+void format_day(long day, char *text);
+
+//reads a "YYYY-MM-DD" date, returns 0 if it isn't one
+int parse_day(const char *text, long *day);
+
+//writes a timestamp as "YYYY-MM-DD HH:MM:SS" (UTC), text holds MAX_TIMESTAMP bytes
+void format_timestamp(unsigned int timestamp, char *text);
+
+//reads a "YYYY-MM-DD HH:MM:SS" timestamp, returns 0 if it isn't one
+int parse_timestamp(const char *text, unsigned int *timestamp);
+
+#endif /* ARCHIVE_H */
@@ -0,0 +1,65 @@
+/*
+Arena allocator for the catalog system. Line item chunks are carved out of a few large blocks instead of
+one malloc each, and the whole arena is released at once when the orders are freed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdalign.h>
+#include "arena.h"
+#include "stats.h"
+
+void arena_init(arena_t *arena, size_t blockSize) 
+{
+    arena->head = NULL;
+    arena->blockSize = blockSize;
+}
+
+void *arena_alloc(arena_t *arena, size_t size) 
+{
+    //round up so every allocation stays aligned for any type
+    size_t alignment = alignof(max_align_t);
+    size = (size + alignment - 1) & ~(alignment - 1);
+
+    arena_block_t *block = arena->head;
+
+    if (block == NULL || block->size - block->used < size) 
+    {
+        //oversized requests get a block of their own
+        size_t blockSize = size > arena->blockSize ? size : arena->blockSize;
+        block = (arena_block_t *)malloc(sizeof(arena_block_t) + blockSize);
+
+        if (!block) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        STATS_ADD(STATS_ALLOCATIONS, 1);
+        STATS_ADD(STATS_BYTES_ALLOCATED, sizeof(arena_block_t) + blockSize);
+
+        block->size = blockSize;
+        block->used = 0;
+        block->next = arena->head;
+        arena->head = block;
+    }
+
+    void *memory = block->data + block->used;
+    block->used += size;
+
+    return memory;
+}
+
+void arena_free_all(arena_t *arena) 
+{
+    arena_block_t *current = arena->head;
+
+    while (current != NULL) 
+    {
+        arena_block_t *next = current->next;
+        free(current);
+        current = next;
+    }
+
+    arena->head = NULL;
+}
@@ -0,0 +1,33 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (1024 * 1024) //default bytes per arena block
+
+//one large allocation that arena_alloc carves smaller pieces out of
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t size; //usable bytes in data
+    size_t used; //bytes handed out so far
+    _Alignas(max_align_t) unsigned char data[];
+} arena_block_t;
+
+//bump allocator: allocations are never freed one by one, only all at once
+typedef struct {
+    arena_block_t *head; //block currently being carved, older blocks follow
+    size_t blockSize;
+} arena_t;
+
+//function declarations
+
+//prepares an empty arena, blocks are allocated lazily
+void arena_init(arena_t *arena, size_t blockSize);
+
+//returns size bytes of uninitialized memory aligned for any type
+void *arena_alloc(arena_t *arena, size_t size);
+
+//releases every block of the arena in one pass
+void arena_free_all(arena_t *arena);
+
+#endif /* ARENA_H */
@@ -0,0 +1,262 @@
+/*
+Batch mode for the catalog system. Reads order and return records from a file or stdin and applies them
+without any prompts, validating every product against the catalog. A record is applied completely or not
+at all, and every rejected record is reported with its line number.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include "batch.h"
+
+//strips leading and trailing whitespace in place
+static char *trim(char *text) 
+{
+    while (isspace((unsigned char)*text)) 
+    {
+        text++;
+    }
+
+    char *end = text + strlen(text);
+
+    while (end > text && isspace((unsigned char)end[-1])) 
+    {
+        end--;
+    }
+    *end = '\0';
+
+    return text;
+}
+
+//splits the next comma separated field off a record, returns NULL once the record is used up
+static char *next_field(char **cursor) 
+{
+    if (*cursor == NULL) 
+    {
+        return NULL;
+    }
+
+    char *field = *cursor;
+    char *comma = strchr(field, ',');
+
+    if (comma != NULL) 
+    {
+        *comma = '\0';
+        *cursor = comma + 1;
+    } else {
+        *cursor = NULL;
+    }
+
+    return trim(field);
+}
+
+//parses a whole field as an int, returns 0 if it isn't one
+static int parse_int(const char *field, int *value) 
+{
+    char *end;
+    errno = 0;
+    long parsed = strtol(field, &end, 10);
+
+    if (field[0] == '\0' || *end != '\0' || errno != 0 || parsed < -2147483647L || parsed > 2147483647L) 
+    {
+        return 0;
+    }
+
+    *value = (int)parsed;
+    return 1;
+}
+
+//validates an order record completely before any of it is stored, returns 0 and reports if it's rejected
+static int apply_order(char *cursor, order_list_t *orders, const catalog_t *catalog, size_t lineNumber, FILE *output, FILE *errors, batch_result_t *result) 
+{
+    char *customerName = next_field(&cursor);
+
+    if (customerName == NULL || !is_valid_customer_name(customerName)) 
+    {
+        fprintf(errors, "line %zu: customer name missing, longer than %d characters or holding control characters\n", lineNumber, MAX_NAME - 1);
+        return 0;
+    }
+
+    //duplicates of a product within the record merge in the draft, which is only stored once it all checks out
+    order_draft_t draft;
+    init_order_draft(&draft, customerName);
+
+    char *productField;
+
+    while ((productField = next_field(&cursor)) != NULL) 
+    {
+        char *quantityField = next_field(&cursor);
+        int productNumber;
+        int quantity;
+
+        if (!parse_int(productField, &productNumber) || quantityField == NULL || !parse_int(quantityField, &quantity)) 
+        {
+            fprintf(errors, "line %zu: expected product number and quantity pairs\n", lineNumber);
+            free_order_draft(&draft);
+            return 0;
+        }
+
+        if (!isProductNumberValid(catalog, productNumber)) 
+        {
+            fprintf(errors, "line %zu: product number %d does not exist\n", lineNumber, productNumber);
+            free_order_draft(&draft);
+            return 0;
+        }
+
+        if (quantity <= 0) 
+        {
+            fprintf(errors, "line %zu: invalid quantity %d for product %d\n", lineNumber, quantity, productNumber);
+            free_order_draft(&draft);
+            return 0;
+        }
+
+        if (add_to_order_draft(&draft, productNumber, quantity) < 0) 
+        {
+            fprintf(errors, "line %zu: quantity of product %d too large\n", lineNumber, productNumber);
+            free_order_draft(&draft);
+            return 0;
+        }
+    }
+
+    if (draft.count == 0) 
+    {
+        fprintf(errors, "line %zu: order has no line items\n", lineNumber);
+        free_order_draft(&draft);
+        return 0;
+    }
+
+    //the whole record is valid, so it gets an order number and is stored
+    char orderNumber[MAX_ORDER_NUMBER];
+    size_t itemCount = commit_order_draft(orders, &draft, orderNumber);
+
+    if (itemCount == 0) 
+    {
+        if (draft.failure == ORDER_DRAFT_BAD_QUANTITY) 
+        {
+            fprintf(errors, "line %zu: invalid quantity for product %d\n", lineNumber, draft.failedProduct);
+        } else if (draft.failure == ORDER_DRAFT_NO_NUMBER) 
+        {
+            fprintf(errors, "line %zu: no order number could be reserved\n", lineNumber);
+        } else {
+            fprintf(errors, "line %zu: not enough of product %d in stock\n", lineNumber, draft.failedProduct);
+        }
+        free_order_draft(&draft);
+        return 0;
+    }
+
+    free_order_draft(&draft);
+
+    fprintf(output, "line %zu: order %s placed with %zu line items\n", lineNumber, orderNumber, itemCount);
+    result->ordersPlaced++;
+    result->lineItems += itemCount;
+
+    return 1;
+}
+
+//returns every remaining unit of an order, or some units of one of its products, returns 0 and reports if it's rejected
+static int apply_return(char *cursor, order_list_t *orders, size_t lineNumber, FILE *output, FILE *errors, batch_result_t *result) 
+{
+    char *orderNumber = next_field(&cursor);
+
+    if (orderNumber == NULL || orderNumber[0] == '\0') 
+    {
+        fprintf(errors, "line %zu: expected return,<order number>[,<product number>,<quantity>]\n", lineNumber);
+        return 0;
+    }
+
+    if (cursor == NULL) 
+    {
+        if (return_order(orders, orderNumber) == 0) 
+        {
+            fprintf(errors, "line %zu: order number %s not found or already returned\n", lineNumber, orderNumber);
+            return 0;
+        }
+
+        fprintf(output, "line %zu: order %s returned\n", lineNumber, orderNumber);
+        result->returns++;
+
+        return 1;
+    }
+
+    char *productField = next_field(&cursor);
+    char *quantityField = next_field(&cursor);
+    int productNumber;
+    int quantity;
+
+    if (!parse_int(productField, &productNumber) || quantityField == NULL || !parse_int(quantityField, &quantity) || cursor != NULL) 
+    {
+        fprintf(errors, "line %zu: expected return,<order number>[,<product number>,<quantity>]\n", lineNumber);
+        return 0;
+    }
+
+    if (quantity <= 0) 
+    {
+        fprintf(errors, "line %zu: quantity must be positive\n", lineNumber);
+        return 0;
+    }
+
+    if (!return_line_item(orders, orderNumber, productNumber, quantity)) 
+    {
+        fprintf(errors, "line %zu: order %s has no product %d with %d left to return\n", lineNumber, orderNumber, productNumber, quantity);
+        return 0;
+    }
+
+    fprintf(output, "line %zu: %d of product %d returned from order %s\n", lineNumber, quantity, productNumber, orderNumber);
+    result->returns++;
+
+    return 1;
+}
+
+batch_result_t run_batch(FILE *input, order_list_t *orders, live_catalog_t *catalog, FILE *output, FILE *errors) 
+{
+    batch_result_t result;
+    memset(&result, 0, sizeof(result));
+
+    char *line = NULL;
+    size_t lineCapacity = 0;
+    size_t lineNumber = 0;
+
+    //getline handles records of any length
+    while (getline(&line, &lineCapacity, input) != -1) 
+    {
+        lineNumber++;
+
+        char *cursor = trim(line);
+
+        if (cursor[0] == '\0' || cursor[0] == '#') 
+        {
+            continue;
+        }
+
+        result.records++;
+
+        char *command = next_field(&cursor);
+        int applied;
+
+        if (strcmp(command, "order") == 0) 
+        {
+            //a reload between records is picked up by the next one
+            applied = apply_order(cursor, orders, live_catalog_acquire(catalog), lineNumber, output, errors, &result);
+            live_catalog_release(catalog);
+        } else if (strcmp(command, "return") == 0) 
+        {
+            applied = apply_return(cursor, orders, lineNumber, output, errors, &result);
+        } else {
+            fprintf(errors, "line %zu: unknown record type '%s'\n", lineNumber, command);
+            applied = 0;
+        }
+
+        if (!applied) 
+        {
+            result.errors++;
+        }
+    }
+
+    free(line);
+
+    return result;
+}
@@ -0,0 +1,26 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include "catalog_system.h"
+#include "live_catalog.h"
+
+/*counts from one batch run. Input records, one per line:
+order,<customer name>,<product number>,<quantity>[,<product number>,<quantity>...]
+return,<order number>[,<product number>,<quantity>]
+blank lines and lines starting with '#' are skipped*/
+typedef struct {
+    size_t records;       //records read, skipped lines excluded
+    size_t ordersPlaced;
+    size_t lineItems;
+    size_t returns;
+    size_t errors;        //records rejected, each one reported with its line number
+} batch_result_t;
+
+//function declarations
+
+//applies every record of the input without prompting, writes placed order numbers to output and rejections to errors
+//each order record is validated against the newest version of the catalog when it's read
+batch_result_t run_batch(FILE *input, order_list_t *orders, live_catalog_t *catalog, FILE *output, FILE *errors);
+
+#endif /* BATCH_H */
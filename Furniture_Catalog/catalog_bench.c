@@ -0,0 +1,694 @@
+/*
+Benchmark for the furniture catalog system. Generates a synthetic catalog and order history of the requested
+size, times the catalog and order operations against them, and prints one JSON object per operation with its
+throughput and p50/p99 latency so runs can be compared by scripts.
+
+usage: catalog_bench [-p products] [-o orders] [-i items per order] [-l lookups] [-s seed] [-d work dir] [-t threads]
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "catalog_system.h"
+#include "snapshot.h"
+#include "render.h"
+#include "report.h"
+#include "live_catalog.h"
+#include "search.h"
+#include "journal.h"
+#include "inventory.h"
+
+#define BENCH_MAX_SAMPLES (1 << 20) //latency samples kept per operation
+
+//latency samples of one operation
+typedef struct {
+    const char *name;
+    size_t operations;     //operations timed in total
+    double seconds;        //wall time for all of them
+    long long *samples;    //nanoseconds per sampled operation
+    size_t sampleCount;
+    size_t sampleEvery;    //only every n-th operation is sampled so large runs fit in BENCH_MAX_SAMPLES
+} bench_op_t;
+
+//one order intake thread of the placement benchmark
+typedef struct {
+    const catalog_t *catalog;
+    live_catalog_t *live;      //validates against the newest version of this instead of catalog when set
+    _Atomic size_t *finished;  //counts the workers that are done (may be NULL)
+    order_list_t *orders;
+    size_t orderCount;
+    size_t itemsPerOrder;
+    size_t productCount;
+    unsigned long long random;
+    int hotProduct;            //when set every order is one unit of this product
+    size_t placed;             //orders (or reservations) that got their stock
+    bench_op_t op;
+} placement_worker_t;
+
+//xorshift64*, deterministic for a given seed
+static unsigned long long next_random(unsigned long long *state) 
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+static long long now_ns(void) 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+static void begin_op(bench_op_t *op, const char *name, size_t expectedOperations) 
+{
+    op->name = name;
+    op->operations = 0;
+    op->seconds = 0.0;
+    op->sampleCount = 0;
+    op->sampleEvery = expectedOperations / BENCH_MAX_SAMPLES + 1;
+    op->samples = (long long *)malloc(BENCH_MAX_SAMPLES * sizeof(long long));
+
+    if (!op->samples) 
+    {
+        fprintf(stderr, "Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+//adds one timed operation
+static void record_op(bench_op_t *op, long long elapsedNs) 
+{
+    if (op->operations % op->sampleEvery == 0 && op->sampleCount < BENCH_MAX_SAMPLES) 
+    {
+        op->samples[op->sampleCount++] = elapsedNs;
+    }
+
+    op->operations++;
+    op->seconds += elapsedNs / 1e9;
+}
+
+//places a worker's share of the orders against the shared catalog and order store
+static void *place_orders_worker(void *argument) 
+{
+    placement_worker_t *worker = (placement_worker_t *)argument;
+
+    char orderNumber[MAX_ORDER_NUMBER];
+    order_draft_t draft;
+    init_order_draft(&draft, "");
+
+    for (size_t i = 0; i < worker->orderCount; i++) 
+    {
+        //the draft's buffers are reused from one order to the next
+        snprintf(draft.customerName, MAX_NAME, "Customer %llu", next_random(&worker->random) % 100000);
+
+        long long start = now_ns();
+        const catalog_t *catalog = worker->live != NULL ? live_catalog_acquire(worker->live) : worker->catalog;
+
+        for (size_t item = 0; item < worker->itemsPerOrder && worker->hotProduct == 0; item++) 
+        {
+            int productNumber = 100000 + (int)(next_random(&worker->random) % worker->productCount);
+            int quantity = 1 + (int)(next_random(&worker->random) % 5);
+
+            if (isProductNumberValid(catalog, productNumber)) 
+            {
+                add_to_order_draft(&draft, productNumber, quantity);
+            }
+        }
+
+        if (worker->hotProduct != 0) 
+        {
+            add_to_order_draft(&draft, worker->hotProduct, 1);
+        }
+
+        if (worker->live != NULL) 
+        {
+            live_catalog_release(worker->live);
+        }
+
+        worker->placed += commit_order_draft(worker->orders, &draft, orderNumber) > 0;
+
+        record_op(&worker->op, now_ns() - start);
+    }
+
+    free_order_draft(&draft);
+
+    if (worker->finished != NULL) 
+    {
+        atomic_fetch_add(worker->finished, 1);
+    }
+
+    return NULL;
+}
+
+//reserves single units of the worker's hot product straight from the inventory, without placing orders
+static void *reserve_stock_worker(void *argument) 
+{
+    placement_worker_t *worker = (placement_worker_t *)argument;
+
+    for (size_t i = 0; i < worker->orderCount; i++) 
+    {
+        long long start = now_ns();
+        worker->placed += (size_t)reserve_stock(worker->orders->inventory, worker->hotProduct, 1);
+        record_op(&worker->op, now_ns() - start);
+    }
+
+    return NULL;
+}
+
+static int compare_samples(const void *a, const void *b) 
+{
+    long long left = *(const long long *)a;
+    long long right = *(const long long *)b;
+    return (left > right) - (left < right);
+}
+
+//prints one JSON line for the operation and releases its samples
+static void report_op(FILE *report, bench_op_t *op, size_t items) 
+{
+    qsort(op->samples, op->sampleCount, sizeof(long long), compare_samples);
+
+    long long p50 = op->sampleCount > 0 ? op->samples[op->sampleCount / 2] : 0;
+    long long p99 = op->sampleCount > 0 ? op->samples[(op->sampleCount * 99) / 100] : 0;
+
+    fprintf(report, "{\"op\":\"%s\",\"operations\":%zu,\"items\":%zu,\"seconds\":%.6f,"
+            "\"ops_per_sec\":%.1f,\"items_per_sec\":%.1f,\"p50_ns\":%lld,\"p99_ns\":%lld}\n",
+            op->name, op->operations, items, op->seconds,
+            op->seconds > 0 ? op->operations / op->seconds : 0.0,
+            op->seconds > 0 ? items / op->seconds : 0.0, p50, p99);
+    fflush(report);
+
+    free(op->samples);
+}
+
+//writes a catalog file in the furniture_catalog.txt layout, one category per thousand products
+static void generate_catalog(const char *filename, size_t productCount) 
+{
+    FILE *file = fopen(filename, "w");
+
+    if (!file) 
+    {
+        fprintf(stderr, "Error opening file: %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < productCount; i++) 
+    {
+        if (i % 1000 == 0) 
+        {
+            fprintf(file, "---------------------------\nCategory %zu:\n---------------------------\n", i / 1000);
+        }
+
+        fprintf(file, "Product %zu, product no. %zu\n\n", i, 100000 + i);
+    }
+
+    fclose(file);
+}
+
+int main(int argc, char *argv[]) 
+{
+    size_t productCount = 1000;
+    size_t orderCount = 10000;
+    size_t itemsPerOrder = 3;
+    size_t lookupCount = 1000000;
+    size_t threadCount = 1;
+    unsigned long long seed = 88172645463325252ull;
+    const char *workDir = ".";
+
+    int option;
+
+    while ((option = getopt(argc, argv, "p:o:i:l:s:d:t:")) != -1) 
+    {
+        switch (option) 
+        {
+            case 'p': productCount = strtoull(optarg, NULL, 10); break;
+            case 'o': orderCount = strtoull(optarg, NULL, 10); break;
+            case 'i': itemsPerOrder = strtoull(optarg, NULL, 10); break;
+            case 'l': lookupCount = strtoull(optarg, NULL, 10); break;
+            case 's': seed = strtoull(optarg, NULL, 10) | 1; break;
+            case 'd': workDir = optarg; break;
+            case 't': threadCount = strtoull(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "usage: %s [-p products] [-o orders] [-i items per order] [-l lookups] [-s seed] [-d work dir] [-t threads]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (productCount == 0 || itemsPerOrder == 0 || threadCount == 0) 
+    {
+        fprintf(stderr, "products, items per order and threads must be at least 1\n");
+        return EXIT_FAILURE;
+    }
+
+    char catalogFile[FILENAME_MAX];
+    char customerFile[FILENAME_MAX];
+    char snapshotFile[FILENAME_MAX];
+    char journalFile[FILENAME_MAX];
+    char journalSnapshotFile[FILENAME_MAX];
+    snprintf(catalogFile, sizeof(catalogFile), "%s/bench_catalog.txt", workDir);
+    snprintf(customerFile, sizeof(customerFile), "%s/bench_customer_information.txt", workDir);
+    snprintf(snapshotFile, sizeof(snapshotFile), "%s/bench_customer_information.bin", workDir);
+    snprintf(journalFile, sizeof(journalFile), "%s/bench_customer_information.journal", workDir);
+    snprintf(journalSnapshotFile, sizeof(journalSnapshotFile), "%s/bench_journal_snapshot.bin", workDir);
+
+    //results go to the real stdout, the library's own messages are silenced
+    FILE *report = fdopen(dup(STDOUT_FILENO), "w");
+    if (!report || !freopen("/dev/null", "w", stdout)) 
+    {
+        fprintf(stderr, "Error redirecting output\n");
+        return EXIT_FAILURE;
+    }
+
+    fprintf(report, "{\"config\":{\"products\":%zu,\"orders\":%zu,\"items_per_order\":%zu,\"lookups\":%zu,\"threads\":%zu,\"seed\":%llu}}\n",
+            productCount, orderCount, itemsPerOrder, lookupCount, threadCount, seed);
+
+    generate_catalog(catalogFile, productCount);
+
+    bench_op_t op;
+    long long start;
+
+    //catalog load, one operation over the whole file
+    catalog_t *catalog = create_catalog();
+    begin_op(&op, "load_catalog_from_file", 1);
+    start = now_ns();
+    load_catalog_from_file(catalog, catalogFile);
+    record_op(&op, now_ns() - start);
+    report_op(report, &op, catalog->count);
+
+    //lookups, half of them for product numbers that don't exist
+    unsigned long long random = seed;
+    size_t hits = 0;
+    begin_op(&op, "isProductNumberValid", lookupCount);
+
+    for (size_t i = 0; i < lookupCount; i++) 
+    {
+        int productNumber = 100000 + (int)(next_random(&random) % (productCount * 2));
+
+        start = now_ns();
+        hits += isProductNumberValid(catalog, productNumber);
+        record_op(&op, now_ns() - start);
+    }
+    report_op(report, &op, lookupCount);
+
+    //one category listing per request, by name the way a storefront asks for it
+    char categoryName[MAX_PRODUCT_NAME];
+    size_t listed = 0;
+    begin_op(&op, "products_in_category", lookupCount);
+
+    for (size_t i = 0; i < lookupCount; i++) 
+    {
+        snprintf(categoryName, sizeof(categoryName), "Category %zu", (size_t)(next_random(&random) % (productCount / 1000 + 1)));
+
+        start = now_ns();
+        size_t count;
+        const product_t *products = products_in_category(catalog, find_category(catalog, categoryName), &count);
+        for (size_t p = 0; p < count; p++) 
+        {
+            listed += (size_t)(products[p].productNumber != 0);
+        }
+        record_op(&op, now_ns() - start);
+    }
+    report_op(report, &op, listed);
+
+    //name searches the way place_order runs them: a prefix, a number anywhere in the name, and a misspelling
+    static const char *const searchKinds[] = { "search_products_by_prefix", "search_products_by_substring", "search_products_fuzzy" };
+    const product_t *matches[SEARCH_MAX_RESULTS];
+    char query[MAX_NAME];
+    size_t searches = lookupCount / 10 + 1;
+
+    for (size_t kind = 0; kind < 3; kind++) 
+    {
+        size_t found = 0;
+        begin_op(&op, searchKinds[kind], searches);
+
+        for (size_t i = 0; i < searches; i++) 
+        {
+            size_t product = (size_t)(next_random(&random) % productCount);
+
+            if (kind == 0) 
+            {
+                snprintf(query, sizeof(query), "product %zu", product / 10);
+            } else if (kind == 1) 
+            {
+                snprintf(query, sizeof(query), "%zu", product);
+            } else {
+                snprintf(query, sizeof(query), "Prodict %zu", product);
+            }
+
+            start = now_ns();
+            if (kind == 0) 
+            {
+                found += search_products_by_prefix(catalog, query, matches, SEARCH_MAX_RESULTS);
+            } else if (kind == 1) 
+            {
+                found += search_products_by_substring(catalog, query, matches, SEARCH_MAX_RESULTS);
+            } else {
+                found += search_products_fuzzy(catalog, query, matches, SEARCH_MAX_RESULTS);
+            }
+            record_op(&op, now_ns() - start);
+        }
+        report_op(report, &op, found);
+    }
+
+    //order placement: number, validation and line items for each order, split over the intake threads
+    order_list_t *orders = create_orders();
+    orders->catalog = catalog;
+    placement_worker_t *workers = (placement_worker_t *)calloc(threadCount, sizeof(placement_worker_t));
+    pthread_t *threads = (pthread_t *)calloc(threadCount, sizeof(pthread_t));
+
+    if (!workers || !threads) 
+    {
+        fprintf(stderr, "Memory allocation failure.\n");
+        return EXIT_FAILURE;
+    }
+
+    begin_op(&op, "place_order", orderCount);
+    start = now_ns();
+
+    for (size_t t = 0; t < threadCount; t++) 
+    {
+        workers[t].catalog = catalog;
+        workers[t].orders = orders;
+        workers[t].orderCount = orderCount / threadCount + (t < orderCount % threadCount ? 1 : 0);
+        workers[t].itemsPerOrder = itemsPerOrder;
+        workers[t].productCount = productCount;
+        workers[t].random = seed + 2 * t + 1;
+        begin_op(&workers[t].op, "place_order", workers[t].orderCount);
+
+        pthread_create(&threads[t], NULL, place_orders_worker, &workers[t]);
+    }
+
+    for (size_t t = 0; t < threadCount; t++) 
+    {
+        pthread_join(threads[t], NULL);
+
+        //merge the thread's samples into the combined report
+        for (size_t i = 0; i < workers[t].op.sampleCount && op.sampleCount < BENCH_MAX_SAMPLES; i++) 
+        {
+            op.samples[op.sampleCount++] = workers[t].op.samples[i];
+        }
+        op.operations += workers[t].op.operations;
+        free(workers[t].op.samples);
+    }
+
+    //throughput over wall time, so it reflects every thread working at once
+    op.seconds = (now_ns() - start) / 1e9;
+    report_op(report, &op, count_line_items(orders));
+
+    //a tenth as many orders again while the catalog is reloaded from its file over and over on this thread
+    live_catalog_t live;
+    catalog_t *liveVersion = create_catalog();
+    load_catalog_from_file(liveVersion, catalogFile);
+    live_catalog_init(&live, liveVersion);
+
+    order_list_t *liveOrders = create_orders();
+    liveOrders->liveCatalog = &live;
+    _Atomic size_t finished = 0;
+    size_t liveOrderCount = orderCount / 10 + 1;
+    bench_op_t reloadOp;
+    size_t reloadedProducts = 0;
+
+    begin_op(&op, "place_order_during_reload", liveOrderCount);
+    begin_op(&reloadOp, "live_catalog_reload", liveOrderCount);
+    start = now_ns();
+
+    for (size_t t = 0; t < threadCount; t++) 
+    {
+        memset(&workers[t], 0, sizeof(placement_worker_t));
+        workers[t].live = &live;
+        workers[t].finished = &finished;
+        workers[t].orders = liveOrders;
+        workers[t].orderCount = liveOrderCount / threadCount + (t < liveOrderCount % threadCount ? 1 : 0);
+        workers[t].itemsPerOrder = itemsPerOrder;
+        workers[t].productCount = productCount;
+        workers[t].random = seed + 2 * t + 1;
+        begin_op(&workers[t].op, "place_order_during_reload", workers[t].orderCount);
+
+        pthread_create(&threads[t], NULL, place_orders_worker, &workers[t]);
+    }
+
+    while (atomic_load(&finished) < threadCount) 
+    {
+        long long reloadStart = now_ns();
+        long long count = live_catalog_reload(&live, catalogFile);
+        record_op(&reloadOp, now_ns() - reloadStart);
+        reloadedProducts += count > 0 ? (size_t)count : 0;
+    }
+
+    for (size_t t = 0; t < threadCount; t++) 
+    {
+        pthread_join(threads[t], NULL);
+
+        for (size_t i = 0; i < workers[t].op.sampleCount && op.sampleCount < BENCH_MAX_SAMPLES; i++) 
+        {
+            op.samples[op.sampleCount++] = workers[t].op.samples[i];
+        }
+        op.operations += workers[t].op.operations;
+        free(workers[t].op.samples);
+    }
+
+    op.seconds = (now_ns() - start) / 1e9;
+    report_op(report, &op, count_line_items(liveOrders));
+    report_op(report, &reloadOp, reloadedProducts);
+
+    free_orders(liveOrders);
+    live_catalog_free(&live);
+
+    //the same orders again with every line item journaled, the writer thread commits them in the background
+    order_list_t *journaledOrders = create_orders();
+    journaledOrders->catalog = catalog;
+    journal_t journal;
+    remove(journalFile);
+    open_journal(&journal, journaledOrders, journalFile, journalSnapshotFile);
+
+    begin_op(&op, "place_order_journaled", orderCount);
+    start = now_ns();
+
+    for (size_t t = 0; t < threadCount; t++) 
+    {
+        memset(&workers[t], 0, sizeof(placement_worker_t));
+        workers[t].catalog = catalog;
+        workers[t].orders = journaledOrders;
+        workers[t].orderCount = orderCount / threadCount + (t < orderCount % threadCount ? 1 : 0);
+        workers[t].itemsPerOrder = itemsPerOrder;
+        workers[t].productCount = productCount;
+        workers[t].random = seed + 2 * t + 1;
+        begin_op(&workers[t].op, "place_order_journaled", workers[t].orderCount);
+
+        pthread_create(&threads[t], NULL, place_orders_worker, &workers[t]);
+    }
+
+    for (size_t t = 0; t < threadCount; t++) 
+    {
+        pthread_join(threads[t], NULL);
+
+        for (size_t i = 0; i < workers[t].op.sampleCount && op.sampleCount < BENCH_MAX_SAMPLES; i++) 
+        {
+            op.samples[op.sampleCount++] = workers[t].op.samples[i];
+        }
+        op.operations += workers[t].op.operations;
+        free(workers[t].op.samples);
+    }
+
+    op.seconds = (now_ns() - start) / 1e9;
+    report_op(report, &op, count_line_items(journaledOrders));
+
+    //the flush barrier then waits for whatever the writer hasn't committed yet
+    begin_op(&op, "flush_journal", 1);
+    start = now_ns();
+    flush_journal(&journal);
+    record_op(&op, now_ns() - start);
+    report_op(report, &op, (size_t)journaledOrders->journalSequence);
+
+    close_journal(&journal);
+    free_orders(journaledOrders);
+    remove(journalFile);
+    remove(journalSnapshotFile);
+
+    //every intake thread on one hot product: reservations, then whole orders, are compare-and-swaps on its one counter
+    //the stock covers half of the attempts each time, so the rest must be turned away without a unit oversold
+    order_list_t *hotOrders = create_orders();
+    hotOrders->catalog = catalog;
+    hotOrders->inventory = create_inventory();
+    int hotProduct = 100000;
+    size_t hotPlaced[2] = { 0, 0 };
+    long long hotStockLeft[2];
+
+    for (int pass = 0; pass < 2; pass++) 
+    {
+        const char *name = pass == 0 ? "reserve_stock_hot_sku" : "place_order_hot_sku";
+
+        set_stock(hotOrders->inventory, hotProduct, (long long)(orderCount / 2));
+        begin_op(&op, name, orderCount);
+        start = now_ns();
+
+        for (size_t t = 0; t < threadCount; t++) 
+        {
+            memset(&workers[t], 0, sizeof(placement_worker_t));
+            workers[t].catalog = catalog;
+            workers[t].orders = hotOrders;
+            workers[t].orderCount = orderCount / threadCount + (t < orderCount % threadCount ? 1 : 0);
+            workers[t].productCount = productCount;
+            workers[t].random = seed + 2 * t + 1;
+            workers[t].hotProduct = hotProduct;
+            begin_op(&workers[t].op, name, workers[t].orderCount);
+
+            pthread_create(&threads[t], NULL, pass == 0 ? reserve_stock_worker : place_orders_worker, &workers[t]);
+        }
+
+        for (size_t t = 0; t < threadCount; t++) 
+        {
+            pthread_join(threads[t], NULL);
+
+            for (size_t i = 0; i < workers[t].op.sampleCount && op.sampleCount < BENCH_MAX_SAMPLES; i++) 
+            {
+                op.samples[op.sampleCount++] = workers[t].op.samples[i];
+            }
+            op.operations += workers[t].op.operations;
+            hotPlaced[pass] += workers[t].placed;
+            free(workers[t].op.samples);
+        }
+
+        op.seconds = (now_ns() - start) / 1e9;
+        report_op(report, &op, hotPlaced[pass]);
+        hotStockLeft[pass] = stock_level(hotOrders->inventory, hotProduct);
+    }
+
+    free_orders(hotOrders);
+
+    free(workers);
+    free(threads);
+
+    //one page of a customer's orders, the way option 3 shows it
+    render_buffer_t buffer;
+    render_filter_t filter;
+    size_t rendered = 0;
+    size_t pages = lookupCount / 100 + 1;
+    render_init(&buffer);
+    memset(&filter, 0, sizeof(filter));
+    filter.kind = FILTER_CUSTOMER;
+    begin_op(&op, "render_orders", pages);
+
+    for (size_t i = 0; i < pages; i++) 
+    {
+        render_cursor_t cursor;
+        memset(&cursor, 0, sizeof(cursor));
+        snprintf(filter.text, sizeof(filter.text), "Customer %llu", next_random(&random) % 100000);
+
+        start = now_ns();
+        rendered += render_orders(&buffer, orders, catalog, &filter, &cursor, RENDER_PAGE_SIZE);
+        buffer.size = 0;
+        record_op(&op, now_ns() - start);
+    }
+    report_op(report, &op, rendered);
+    render_free(&buffer);
+
+    //sales totals over every line item, all kernels in one report
+    sales_report_t sales;
+    begin_op(&op, "build_sales_report", 1);
+    start = now_ns();
+    build_sales_report(&sales, orders, catalog);
+    record_op(&op, now_ns() - start);
+    report_op(report, &op, sales.lineItems);
+    free_sales_report(&sales);
+
+    //save and reload in both formats before any returns, so every line item is written
+    begin_op(&op, "save_customer_information", 1);
+    start = now_ns();
+    save_customer_information(orders, customerFile);
+    record_op(&op, now_ns() - start);
+    report_op(report, &op, count_line_items(orders));
+
+    order_list_t *reloaded = create_orders();
+    reloaded->catalog = catalog;
+    begin_op(&op, "load_customer_information", 1);
+    start = now_ns();
+    load_customer_information(reloaded, customerFile);
+    record_op(&op, now_ns() - start);
+    report_op(report, &op, count_line_items(reloaded));
+    free_orders(reloaded);
+
+    begin_op(&op, "save_snapshot", 1);
+    start = now_ns();
+    save_snapshot(orders, snapshotFile);
+    record_op(&op, now_ns() - start);
+    report_op(report, &op, count_line_items(orders));
+
+    reloaded = create_orders();
+    reloaded->catalog = catalog;
+    begin_op(&op, "load_snapshot", 1);
+    start = now_ns();
+    load_snapshot(reloaded, snapshotFile);
+    record_op(&op, now_ns() - start);
+    report_op(report, &op, count_line_items(reloaded));
+    free_orders(reloaded);
+
+    //returns of a tenth of the orders, picked at random (some twice, which finds nothing left to return)
+    size_t returnCount = orderCount / 10;
+    size_t returned = 0;
+    char orderNumber[MAX_ORDER_NUMBER];
+    begin_op(&op, "process_return", returnCount);
+
+    for (size_t i = 0; i < returnCount; i++) 
+    {
+        format_order_number(((order_id_t)orders->sequence.node << ORDER_ID_NODE_SHIFT) | (next_random(&random) % orderCount),
+                            orderNumber);
+
+        start = now_ns();
+        returned += return_order(orders, orderNumber);
+        record_op(&op, now_ns() - start);
+    }
+    report_op(report, &op, returned);
+
+    //single units of the first product of random orders, most of which are still there to return
+    size_t partialReturns = 0;
+    begin_op(&op, "return_line_item", returnCount);
+
+    for (size_t i = 0; i < returnCount; i++) 
+    {
+        format_order_number(((order_id_t)orders->sequence.node << ORDER_ID_NODE_SHIFT) | (next_random(&random) % orderCount),
+                            orderNumber);
+
+        order_t item;
+        int productNumber = find_order(orders, orderNumber, &item, 1) > 0 ? item.productNumber : 0;
+
+        start = now_ns();
+        partialReturns += (size_t)return_line_item(orders, orderNumber, productNumber, 1);
+        record_op(&op, now_ns() - start);
+    }
+    report_op(report, &op, partialReturns);
+
+    //reconciliation: units returned per product, from the ledger of every shard
+    long long ledgerUnits = 0;
+    begin_op(&op, "returned_units_of_product", lookupCount / 10 + 1);
+
+    for (size_t i = 0; i < lookupCount / 10 + 1; i++) 
+    {
+        int productNumber = 100000 + (int)(next_random(&random) % productCount);
+
+        start = now_ns();
+        ledgerUnits += returned_units_of_product(orders, productNumber);
+        record_op(&op, now_ns() - start);
+    }
+    report_op(report, &op, lookupCount / 10 + 1);
+
+    fprintf(report, "{\"checks\":{\"lookup_hits\":%zu,\"line_items\":%zu,\"returned_items\":%zu,\"partial_returns\":%zu,\"ledger_units\":%lld,"
+            "\"hot_sku_reserved\":%zu,\"hot_sku_placed\":%zu,\"hot_sku_stock_left\":%lld}}\n",
+            hits, count_line_items(orders), returned, partialReturns, ledgerUnits,
+            hotPlaced[0], hotPlaced[1], hotStockLeft[0] + hotStockLeft[1]);
+
+    free_orders(orders);
+    free_catalog(catalog);
+    remove(catalogFile);
+    remove(customerFile);
+    remove(snapshotFile);
+    fclose(report);
+
+    return EXIT_SUCCESS;
+}
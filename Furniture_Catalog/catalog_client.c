@@ -0,0 +1,595 @@
+/*
+Thin client for the catalog server (main --serve). Sends one request per run and prints the reply, or with
+flood keeps many connections busy placing orders and reports the throughput the server sustained.
+
+usage: catalog_client [-s socket] place <customer name> <product number> <quantity> [<product number> <quantity>...]
+                                  return <order number> [<product number> <quantity>]
+                                  product <product number>
+                                  order <order number>
+                                  list orders|returns|catalog [customer|order|product|category <value>]
+                                  flood <clients> <orders per client> <customer name> <product number> <quantity> [pipeline depth]
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "protocol.h"
+#include "render.h"
+
+#define CLIENT_LIST_ROWS 100   //rows asked for per list request
+#define CLIENT_PIPELINE 32     //flood requests in flight per connection unless told otherwise
+
+//one connection of a flood
+typedef struct {
+    const char *socketPath;
+    const char *customerName;
+    int productNumber;
+    int quantity;
+    size_t orders;      //orders to place
+    size_t pipeline;    //requests sent ahead of their replies
+    size_t placed;
+    size_t rejected;
+    int failed;         //1 if the connection broke
+} flood_worker_t;
+
+static long long now_ns(void) 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+//connects to the server, returns the socket or -1
+static int connect_to(const char *socketPath) 
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (strlen(socketPath) >= sizeof(address.sun_path)) 
+    {
+        fprintf(stderr, "Socket path too long: %s\n", socketPath);
+        return -1;
+    }
+
+    strcpy(address.sun_path, socketPath);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) 
+    {
+        fprintf(stderr, "Could not connect to %s, is the server running (--serve)?\n", socketPath);
+
+        if (fd >= 0) 
+        {
+            close(fd);
+        }
+        return -1;
+    }
+
+    return fd;
+}
+
+//sends the whole buffer, returns 0 if the server went away
+static int send_all(int fd, const unsigned char *data, size_t size) 
+{
+    while (size > 0) 
+    {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+
+        if (sent < 0 && errno == EINTR) 
+        {
+            continue;
+        }
+
+        if (sent <= 0) 
+        {
+            return 0;
+        }
+
+        data += sent;
+        size -= (size_t)sent;
+    }
+
+    return 1;
+}
+
+//reads exactly size bytes, returns 0 if the server went away
+static int receive_all(int fd, unsigned char *data, size_t size) 
+{
+    while (size > 0) 
+    {
+        ssize_t received = recv(fd, data, size, 0);
+
+        if (received < 0 && errno == EINTR) 
+        {
+            continue;
+        }
+
+        if (received <= 0) 
+        {
+            return 0;
+        }
+
+        data += received;
+        size -= (size_t)received;
+    }
+
+    return 1;
+}
+
+//reads one reply frame into frame (PROTOCOL_MAX_FRAME bytes) and starts the reader on it, returns its status or -1
+static int receive_reply(int fd, unsigned char *frame, protocol_reader_t *reply) 
+{
+    if (!receive_all(fd, frame, sizeof(uint32_t))) 
+    {
+        return -1;
+    }
+
+    uint32_t length;
+    memcpy(&length, frame, sizeof(length));
+
+    if (length <= sizeof(length) || length > PROTOCOL_MAX_FRAME || !receive_all(fd, frame + sizeof(length), length - sizeof(length))) 
+    {
+        return -1;
+    }
+
+    protocol_reader_init(reply, frame, length);
+    return protocol_get_u8(reply);
+}
+
+//sends a request and waits for its reply, prints the message of a rejected one, returns the status or -1
+static int request(int fd, const protocol_buffer_t *message, unsigned char *frame, protocol_reader_t *reply) 
+{
+    if (!send_all(fd, message->data, message->size)) 
+    {
+        fprintf(stderr, "The server closed the connection.\n");
+        return -1;
+    }
+
+    int status = receive_reply(fd, frame, reply);
+
+    if (status < 0) 
+    {
+        fprintf(stderr, "The server closed the connection.\n");
+    } else if (status != PROTOCOL_OK) 
+    {
+        char text[256];
+        protocol_get_string(reply, text, sizeof(text));
+        fprintf(stderr, "Rejected: %s\n", text);
+    }
+
+    return status;
+}
+
+//parses a whole argument as an int, returns 0 if it isn't one
+static int parse_int(const char *text, int *value) 
+{
+    char *end;
+    errno = 0;
+    long parsed = strtol(text, &end, 10);
+
+    if (text[0] == '\0' || *end != '\0' || errno != 0 || parsed < -2147483647L || parsed > 2147483647L) 
+    {
+        return 0;
+    }
+
+    *value = (int)parsed;
+    return 1;
+}
+
+//builds a place request for one customer from product number and quantity pairs, returns 0 if they don't parse
+static int build_place(protocol_buffer_t *message, const char *customerName, char **pairs, int pairCount) 
+{
+    if (pairCount == 0 || pairCount % 2 != 0 || pairCount / 2 > PROTOCOL_MAX_ITEMS) 
+    {
+        return 0;
+    }
+
+    size_t start = protocol_begin_frame(message, PROTOCOL_PLACE);
+    protocol_put_string(message, customerName);
+    protocol_put_u16(message, (uint16_t)(pairCount / 2));
+
+    for (int i = 0; i < pairCount; i++) 
+    {
+        int value;
+
+        if (!parse_int(pairs[i], &value)) 
+        {
+            return 0;
+        }
+
+        protocol_put_i32(message, value);
+    }
+
+    protocol_end_frame(message, start);
+    return 1;
+}
+
+//places orders over one connection, keeping up to pipeline requests in flight
+static void *flood_worker(void *argument) 
+{
+    flood_worker_t *worker = (flood_worker_t *)argument;
+    int fd = connect_to(worker->socketPath);
+
+    if (fd < 0) 
+    {
+        worker->failed = 1;
+        return NULL;
+    }
+
+    unsigned char *frame = (unsigned char *)malloc(PROTOCOL_MAX_FRAME);
+    protocol_buffer_t message;
+    protocol_buffer_init(&message);
+
+    if (!frame) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t sent = 0;
+    size_t answered = 0;
+
+    while (answered < worker->orders) 
+    {
+        //top the pipeline up with one write, then take the replies as they come
+        message.size = 0;
+
+        while (sent < worker->orders && sent - answered < worker->pipeline) 
+        {
+            size_t start = protocol_begin_frame(&message, PROTOCOL_PLACE);
+            protocol_put_string(&message, worker->customerName);
+            protocol_put_u16(&message, 1);
+            protocol_put_i32(&message, worker->productNumber);
+            protocol_put_i32(&message, worker->quantity);
+            protocol_end_frame(&message, start);
+            sent++;
+        }
+
+        if (message.size > 0 && !send_all(fd, message.data, message.size)) 
+        {
+            worker->failed = 1;
+            break;
+        }
+
+        protocol_reader_t reply;
+        int status = receive_reply(fd, frame, &reply);
+
+        if (status < 0) 
+        {
+            worker->failed = 1;
+            break;
+        }
+
+        if (status == PROTOCOL_OK) 
+        {
+            worker->placed++;
+        } else {
+            worker->rejected++;
+        }
+        answered++;
+    }
+
+    protocol_buffer_free(&message);
+    free(frame);
+    close(fd);
+
+    return NULL;
+}
+
+static int run_flood(const char *socketPath, int argc, char *argv[]) 
+{
+    int clients;
+    int ordersPerClient;
+    int productNumber;
+    int quantity;
+    int pipeline = CLIENT_PIPELINE;
+
+    if (argc < 5 || !parse_int(argv[0], &clients) || !parse_int(argv[1], &ordersPerClient) ||
+        !parse_int(argv[3], &productNumber) || !parse_int(argv[4], &quantity) ||
+        (argc > 5 && !parse_int(argv[5], &pipeline)) || clients <= 0 || ordersPerClient <= 0 || pipeline <= 0) 
+    {
+        fprintf(stderr, "usage: flood <clients> <orders per client> <customer name> <product number> <quantity> [pipeline depth]\n");
+        return EXIT_FAILURE;
+    }
+
+    flood_worker_t *workers = (flood_worker_t *)calloc((size_t)clients, sizeof(flood_worker_t));
+    pthread_t *threads = (pthread_t *)malloc((size_t)clients * sizeof(pthread_t));
+
+    if (!workers || !threads) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    long long start = now_ns();
+
+    for (int i = 0; i < clients; i++) 
+    {
+        workers[i].socketPath = socketPath;
+        workers[i].customerName = argv[2];
+        workers[i].productNumber = productNumber;
+        workers[i].quantity = quantity;
+        workers[i].orders = (size_t)ordersPerClient;
+        workers[i].pipeline = (size_t)pipeline;
+        pthread_create(&threads[i], NULL, flood_worker, &workers[i]);
+    }
+
+    size_t placed = 0;
+    size_t rejected = 0;
+    int failed = 0;
+
+    for (int i = 0; i < clients; i++) 
+    {
+        pthread_join(threads[i], NULL);
+        placed += workers[i].placed;
+        rejected += workers[i].rejected;
+        failed += workers[i].failed;
+    }
+
+    double seconds = (double)(now_ns() - start) / 1e9;
+
+    printf("%zu orders placed, %zu rejected by %d clients in %.3f s: %.0f requests/s\n",
+           placed, rejected, clients, seconds, (double)(placed + rejected) / seconds);
+
+    if (failed > 0) 
+    {
+        fprintf(stderr, "%d clients lost their connection\n", failed);
+    }
+
+    free(workers);
+    free(threads);
+
+    return failed == 0 && rejected == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//fills in the list request fields after the listing type, returns 0 if the filter isn't understood
+static int build_list(protocol_buffer_t *message, int listing, int argc, char *argv[], uint32_t skip) 
+{
+    uint8_t kind = FILTER_NONE;
+    int number = 0;
+    const char *text = "";
+    char range[MAX_NAME];
+
+    if (argc == 2 && strcmp(argv[0], "customer") == 0) 
+    {
+        kind = FILTER_CUSTOMER;
+        text = argv[1];
+    } else if (argc == 2 && strcmp(argv[0], "order") == 0) 
+    {
+        kind = FILTER_ORDER_NUMBER;
+        text = argv[1];
+    } else if (argc == 2 && strcmp(argv[0], "product") == 0 && parse_int(argv[1], &number)) 
+    {
+        kind = FILTER_PRODUCT;
+    } else if (argc == 2 && strcmp(argv[0], "category") == 0) 
+    {
+        kind = FILTER_CATEGORY;
+        text = argv[1];
+    } else if ((argc == 2 || argc == 3) && strcmp(argv[0], "date") == 0) 
+    {
+        //the server checks the dates, a range goes as both days in one string
+        kind = FILTER_DATE;
+        snprintf(range, sizeof(range), "%s %s", argv[1], argc == 3 ? argv[2] : "");
+        text = range;
+    } else if (argc != 0) 
+    {
+        return 0;
+    }
+
+    size_t start = protocol_begin_frame(message, PROTOCOL_LIST);
+    protocol_put_u8(message, (uint8_t)listing);
+    protocol_put_u8(message, kind);
+    protocol_put_i32(message, number);
+    protocol_put_string(message, text);
+    protocol_put_u32(message, skip);
+    protocol_put_u16(message, CLIENT_LIST_ROWS);
+    protocol_end_frame(message, start);
+
+    return 1;
+}
+
+static void usage(const char *program) 
+{
+    fprintf(stderr, "usage: %s [-s socket] place <customer name> <product number> <quantity> [<product number> <quantity>...]\n", program);
+    fprintf(stderr, "       %s [-s socket] return <order number> [<product number> <quantity>]\n", program);
+    fprintf(stderr, "       %s [-s socket] product <product number>\n", program);
+    fprintf(stderr, "       %s [-s socket] order <order number>\n", program);
+    fprintf(stderr, "       %s [-s socket] list orders|returns|catalog [customer|order|product|category <value>|date <first day> [<last day>]]\n", program);
+    fprintf(stderr, "       %s [-s socket] flood <clients> <orders per client> <customer name> <product number> <quantity> [pipeline depth]\n", program);
+}
+
+int main(int argc, char *argv[]) 
+{
+    const char *socketPath = PROTOCOL_SOCKET;
+    int first = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-s") == 0) 
+    {
+        socketPath = argv[2];
+        first = 3;
+    }
+
+    if (argc <= first) 
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *command = argv[first];
+    char **arguments = argv + first + 1;
+    int argumentCount = argc - first - 1;
+
+    if (strcmp(command, "flood") == 0) 
+    {
+        return run_flood(socketPath, argumentCount, arguments);
+    }
+
+    protocol_buffer_t message;
+    protocol_buffer_init(&message);
+    int listing = -1;
+    int valid = 1;
+
+    if (strcmp(command, "place") == 0) 
+    {
+        valid = argumentCount >= 3 && build_place(&message, arguments[0], arguments + 1, argumentCount - 1);
+    } else if (strcmp(command, "return") == 0 && (argumentCount == 1 || argumentCount == 3)) 
+    {
+        int productNumber = 0;
+        int quantity = 0;
+
+        valid = argumentCount == 1 || (parse_int(arguments[1], &productNumber) && parse_int(arguments[2], &quantity));
+
+        size_t start = protocol_begin_frame(&message, PROTOCOL_RETURN);
+        protocol_put_string(&message, arguments[0]);
+        protocol_put_i32(&message, productNumber);
+        protocol_put_i32(&message, quantity);
+        protocol_end_frame(&message, start);
+    } else if (strcmp(command, "product") == 0 && argumentCount == 1) 
+    {
+        int productNumber = 0;
+        valid = parse_int(arguments[0], &productNumber);
+
+        size_t start = protocol_begin_frame(&message, PROTOCOL_PRODUCT);
+        protocol_put_i32(&message, productNumber);
+        protocol_end_frame(&message, start);
+    } else if (strcmp(command, "order") == 0 && argumentCount == 1) 
+    {
+        size_t start = protocol_begin_frame(&message, PROTOCOL_ORDER);
+        protocol_put_string(&message, arguments[0]);
+        protocol_end_frame(&message, start);
+    } else if (strcmp(command, "list") == 0 && argumentCount >= 1) 
+    {
+        if (strcmp(arguments[0], "orders") == 0) 
+        {
+            listing = PROTOCOL_LIST_ORDERS;
+        } else if (strcmp(arguments[0], "returns") == 0) 
+        {
+            listing = PROTOCOL_LIST_RETURNS;
+        } else if (strcmp(arguments[0], "catalog") == 0) 
+        {
+            listing = PROTOCOL_LIST_CATALOG;
+        }
+
+        valid = listing >= 0 && build_list(&message, listing, argumentCount - 1, arguments + 1, 0);
+    } else {
+        valid = 0;
+    }
+
+    if (!valid) 
+    {
+        usage(argv[0]);
+        protocol_buffer_free(&message);
+        return EXIT_FAILURE;
+    }
+
+    int fd = connect_to(socketPath);
+
+    if (fd < 0) 
+    {
+        protocol_buffer_free(&message);
+        return EXIT_FAILURE;
+    }
+
+    unsigned char *frame = (unsigned char *)malloc(PROTOCOL_MAX_FRAME);
+
+    if (!frame) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    protocol_reader_t reply;
+    int status = request(fd, &message, frame, &reply);
+
+    if (status == PROTOCOL_OK) 
+    {
+        char text[256];
+        char category[256];
+
+        switch (message.data[sizeof(uint32_t)]) 
+        {
+            case PROTOCOL_PLACE: 
+            {
+                protocol_get_string(&reply, text, sizeof(text));
+                uint16_t items = protocol_get_u16(&reply);
+                printf("Order %s placed with %u line items\n", text, (unsigned int)items);
+                break;
+            }
+            case PROTOCOL_RETURN:
+                if (argumentCount == 1) 
+                {
+                    printf("%u line items of order %s returned\n", (unsigned int)protocol_get_u32(&reply), arguments[0]);
+                } else {
+                    printf("%u of product %s returned from order %s\n", (unsigned int)protocol_get_u32(&reply), arguments[1], arguments[0]);
+                }
+                break;
+            case PROTOCOL_PRODUCT:
+                protocol_get_string(&reply, text, sizeof(text));
+                protocol_get_string(&reply, category, sizeof(category));
+                printf("%s, product no. %s (%s)\n", text, arguments[0], category[0] != '\0' ? category : "no category");
+                break;
+            case PROTOCOL_ORDER: 
+            {
+                protocol_get_string(&reply, text, sizeof(text));
+                uint16_t count = protocol_get_u16(&reply);
+                printf("Customer: %s (Order No. %s)\n", text, arguments[0]);
+
+                for (uint16_t i = 0; i < count; i++) 
+                {
+                    int productNumber = protocol_get_i32(&reply);
+                    int quantity = protocol_get_i32(&reply);
+                    int returned = protocol_get_i32(&reply);
+
+                    printf(" | Product Number: %d | Quantity: %d | Returned: %d |\n", productNumber, quantity, returned);
+                }
+                break;
+            }
+            default: 
+            {
+                //page through the listing until the server says there is no more
+                uint32_t rows = 0;
+
+                while (status == PROTOCOL_OK) 
+                {
+                    int more = protocol_get_u8(&reply);
+                    size_t length;
+                    const char *listingText = protocol_get_text(&reply, &length);
+
+                    if (rows == 0 && length == 0) 
+                    {
+                        printf("Nothing to list.\n");
+                    }
+
+                    fwrite(listingText, 1, length, stdout);
+
+                    if (!more) 
+                    {
+                        break;
+                    }
+
+                    rows += CLIENT_LIST_ROWS;
+                    message.size = 0;
+                    build_list(&message, listing, argumentCount - 1, arguments + 1, rows);
+                    status = request(fd, &message, frame, &reply);
+                }
+                break;
+            }
+        }
+    }
+
+    free(frame);
+    protocol_buffer_free(&message);
+    close(fd);
+
+    return status == PROTOCOL_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
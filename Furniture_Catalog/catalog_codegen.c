@@ -0,0 +1,329 @@
+/*
+Build step for fixed deployments: compiles the catalog file into a C source file holding the whole catalog
+as static arrays, so a binary built with it starts without parsing anything or touching the heap. Product
+numbers are looked up through a minimal perfect hash (hash and displace): every product number hashes to a
+bucket, and each bucket stores the seed that sends all of its numbers to slots nobody else took.
+
+usage: catalog_codegen [catalog file] [output file]
+then build the program with -DCATALOG_GENERATED and the output file added to the gcc line ('make generated')
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "catalog_system.h"
+#include "catalog_loader.h"
+#include "catalog_generated.h"
+
+//a perfect hash bucket and the products (by position) that fall into it
+typedef struct {
+    size_t bucket;
+    size_t first; //into the bucket-ordered positions
+    size_t count;
+} hash_bucket_t;
+
+static int compare_buckets(const void *a, const void *b) 
+{
+    const hash_bucket_t *left = (const hash_bucket_t *)a;
+    const hash_bucket_t *right = (const hash_bucket_t *)b;
+
+    //largest buckets first, they are the hardest to place
+    if (left->count != right->count) 
+    {
+        return left->count < right->count ? 1 : -1;
+    }
+
+    return (left->bucket > right->bucket) - (left->bucket < right->bucket);
+}
+
+//allocates zeroed memory or exits
+static void *allocate_zeroed(size_t count, size_t size) 
+{
+    void *memory = calloc(count > 0 ? count : 1, size);
+
+    if (!memory) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return memory;
+}
+
+/*builds a minimal perfect hash over the given products: slots gets one product per slot and seeds one seed
+per bucket, so that slots[perfect_hash_product(n, seeds[perfect_hash_product(n, 0) % seedCount]) % count]
+is the product numbered n*/
+static void build_perfect_hash(const product_t **products, size_t count, const product_t **slots, unsigned int *seeds, size_t seedCount) 
+{
+    hash_bucket_t *buckets = (hash_bucket_t *)allocate_zeroed(seedCount, sizeof(hash_bucket_t));
+    size_t *positions = (size_t *)allocate_zeroed(count, sizeof(size_t));
+    size_t *bucketOf = (size_t *)allocate_zeroed(count, sizeof(size_t));
+    unsigned char *taken = (unsigned char *)allocate_zeroed(count, 1);
+    size_t *trial = (size_t *)allocate_zeroed(count, sizeof(size_t));
+
+    //group the products by bucket with a counting sort
+    for (size_t i = 0; i < seedCount; i++) 
+    {
+        buckets[i].bucket = i;
+    }
+
+    for (size_t i = 0; i < count; i++) 
+    {
+        bucketOf[i] = perfect_hash_product(products[i]->productNumber, 0) % seedCount;
+        buckets[bucketOf[i]].count++;
+    }
+
+    size_t first = 0;
+
+    for (size_t b = 0; b < seedCount; b++) 
+    {
+        buckets[b].first = first;
+        first += buckets[b].count;
+        buckets[b].count = 0;
+    }
+
+    for (size_t i = 0; i < count; i++) 
+    {
+        hash_bucket_t *bucket = &buckets[bucketOf[i]];
+        positions[bucket->first + bucket->count++] = i;
+    }
+
+    qsort(buckets, seedCount, sizeof(hash_bucket_t), compare_buckets);
+
+    //try seeds for each bucket until all of its products land in free slots, distinct from each other
+    for (size_t b = 0; b < seedCount && buckets[b].count > 0; b++) 
+    {
+        const hash_bucket_t *bucket = &buckets[b];
+
+        for (unsigned int seed = 1; ; seed++) 
+        {
+            size_t placed = 0;
+
+            for (; placed < bucket->count; placed++) 
+            {
+                const product_t *product = products[positions[bucket->first + placed]];
+                size_t slot = perfect_hash_product(product->productNumber, seed) % count;
+
+                if (taken[slot]) 
+                {
+                    break;
+                }
+
+                taken[slot] = 1;
+                trial[placed] = slot;
+            }
+
+            if (placed == bucket->count) 
+            {
+                for (size_t i = 0; i < bucket->count; i++) 
+                {
+                    slots[trial[i]] = products[positions[bucket->first + i]];
+                }
+
+                seeds[bucket->bucket] = seed;
+                break;
+            }
+
+            //undo the partial placement before the next seed
+            for (size_t i = 0; i < placed; i++) 
+            {
+                taken[trial[i]] = 0;
+            }
+        }
+    }
+
+    free(buckets);
+    free(positions);
+    free(bucketOf);
+    free(taken);
+    free(trial);
+}
+
+//writes text as a C string literal
+static void write_string(FILE *file, const char *text) 
+{
+    fputc('"', file);
+
+    for (const unsigned char *c = (const unsigned char *)text; *c != '\0'; c++) 
+    {
+        if (*c == '"' || *c == '\\') 
+        {
+            fprintf(file, "\\%c", *c);
+        } else if (*c < 0x20 || *c >= 0x7f) 
+        {
+            fprintf(file, "\\%03o", *c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+
+    fputc('"', file);
+}
+
+//writes a static array of unsigned numbers, C has no empty arrays so an empty one gets a single 0
+static void write_numbers(FILE *file, const char *type, const char *name, const unsigned long long *values, size_t count) 
+{
+    fprintf(file, "static const %s %s[] = {", type, name);
+
+    for (size_t i = 0; i < count || (count == 0 && i == 0); i++) 
+    {
+        fprintf(file, "%s%llu%s", i % 12 == 0 ? "\n    " : " ", count == 0 ? 0ULL : values[i], i + 1 < count ? "," : "");
+    }
+
+    fprintf(file, "\n};\n\n");
+}
+
+//copies an array of any unsigned type into the widest one for write_numbers
+#define WIDEN(values, count, widened) \
+    do { \
+        for (size_t w = 0; w < (count); w++) \
+        { \
+            (widened)[w] = (unsigned long long)(values)[w]; \
+        } \
+    } while (0)
+
+int main(int argc, char *argv[]) 
+{
+    const char *catalogFilename = argc > 1 ? argv[1] : CATALOG_FILE;
+    const char *outputFilename = argc > 2 ? argv[2] : CATALOG_GENERATED_FILE;
+    unsigned long long catalogHash;
+
+    //the hash is taken before parsing, so a file that changes meanwhile is loaded again at startup
+    if (hash_catalog_file(catalogFilename, &catalogHash) != 0) 
+    {
+        printf("Error opening file: %s\n", catalogFilename);
+        return EXIT_FAILURE;
+    }
+
+    //the runtime loader builds every index, they are written out exactly as it left them
+    catalog_t *catalog = create_catalog();
+    load_catalog_from_file(catalog, catalogFilename);
+
+    //the first product listed with a number is the one lookups find, same as the runtime index
+    const product_t **distinct = (const product_t **)allocate_zeroed(catalog->count, sizeof(const product_t *));
+    size_t distinctCount = 0;
+
+    for (size_t i = 0; i < catalog->count; i++) 
+    {
+        if (find_product(catalog, catalog->products[i].productNumber) == &catalog->products[i]) 
+        {
+            distinct[distinctCount++] = &catalog->products[i];
+        }
+    }
+
+    size_t seedCount = distinctCount / PERFECT_HASH_BUCKET_SIZE + 1;
+    const product_t **slots = (const product_t **)allocate_zeroed(distinctCount, sizeof(const product_t *));
+    unsigned int *seeds = (unsigned int *)allocate_zeroed(seedCount, sizeof(unsigned int));
+    build_perfect_hash(distinct, distinctCount, slots, seeds, seedCount);
+
+    FILE *file = fopen(outputFilename, "w");
+
+    if (!file) 
+    {
+        printf("Error opening file: %s\n", outputFilename);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(file, "/*\nGenerated by catalog_codegen from %s, do not edit. Run catalog_codegen again whenever the\n"
+                  "catalog file changes; until then the program loads the changed file at startup instead.\n*/\n\n", catalogFilename);
+    fprintf(file, "#include \"catalog_generated.h\"\n\n");
+    fprintf(file, "const unsigned long long generatedCatalogHash = %lluULL;\n\n", catalogHash);
+
+    fprintf(file, "static const product_t products[] = {\n");
+
+    for (size_t i = 0; i < catalog->count || (catalog->count == 0 && i == 0); i++) 
+    {
+        const product_t *product = catalog->count > 0 ? &catalog->products[i] : NULL;
+
+        fprintf(file, "    { ");
+        write_string(file, product != NULL ? product->name : "");
+        fprintf(file, ", %d, %d }%s\n", product != NULL ? product->productNumber : 0,
+                product != NULL ? product->categoryId : 0, i + 1 < catalog->count ? "," : "");
+    }
+
+    fprintf(file, "};\n\n");
+    fprintf(file, "static const category_t categories[] = {\n");
+
+    for (size_t c = 0; c < catalog->categoryCount || (catalog->categoryCount == 0 && c == 0); c++) 
+    {
+        const category_t *category = catalog->categoryCount > 0 ? &catalog->categories[c] : NULL;
+
+        fprintf(file, "    { ");
+        write_string(file, category != NULL ? category->name : "");
+        fprintf(file, ", %zu, %zu }%s\n", category != NULL ? category->first : 0, category != NULL ? category->count : 0,
+                c + 1 < catalog->categoryCount ? "," : "");
+    }
+
+    fprintf(file, "};\n\n");
+
+    //the perfect hash slots point straight at the products, address constants are fine in a static initializer
+    fprintf(file, "static const product_t *const productSlots[] = {");
+
+    for (size_t i = 0; i < distinctCount || (distinctCount == 0 && i == 0); i++) 
+    {
+        if (distinctCount == 0) 
+        {
+            fprintf(file, "\n    &products[0]");
+            break;
+        }
+
+        fprintf(file, "%s&products[%zu]%s", i % 8 == 0 ? "\n    " : " ", (size_t)(slots[i] - catalog->products),
+                i + 1 < distinctCount ? "," : "");
+    }
+
+    fprintf(file, "\n};\n\n");
+
+    //every other array is a list of numbers
+    size_t widest = catalog->count;
+    widest = catalog->categorySlotCapacity > widest ? catalog->categorySlotCapacity : widest;
+    widest = seedCount > widest ? seedCount : widest;
+    widest = catalog->names.gramCount + 1 > widest ? catalog->names.gramCount + 1 : widest;
+    widest = catalog->names.gramStarts != NULL && catalog->names.gramStarts[catalog->names.gramCount] > widest ?
+             catalog->names.gramStarts[catalog->names.gramCount] : widest;
+    unsigned long long *widened = (unsigned long long *)allocate_zeroed(widest, sizeof(unsigned long long));
+    size_t postingCount = catalog->names.gramStarts != NULL ? catalog->names.gramStarts[catalog->names.gramCount] : 0;
+
+    WIDEN(seeds, seedCount, widened);
+    write_numbers(file, "unsigned int", "productSeeds", widened, seedCount);
+    WIDEN(catalog->categorySlots, catalog->categorySlotCapacity, widened);
+    write_numbers(file, "int", "categorySlots", widened, catalog->categorySlotCapacity);
+    WIDEN(catalog->names.byName, catalog->count, widened);
+    write_numbers(file, "unsigned int", "byName", widened, catalog->count);
+    WIDEN(catalog->names.gramKeys, catalog->names.gramCount, widened);
+    write_numbers(file, "unsigned int", "gramKeys", widened, catalog->names.gramCount);
+    WIDEN(catalog->names.gramStarts, catalog->names.gramStarts != NULL ? catalog->names.gramCount + 1 : 0, widened);
+    write_numbers(file, "size_t", "gramStarts", widened, catalog->names.gramStarts != NULL ? catalog->names.gramCount + 1 : 0);
+    WIDEN(catalog->names.postings, postingCount, widened);
+    write_numbers(file, "unsigned int", "postings", widened, postingCount);
+
+    //the catalog type isn't const, but nothing writes to a catalog once it's loaded, so the arrays stay read-only
+    fprintf(file, "catalog_t generatedCatalog = {\n");
+    fprintf(file, "    .products = (product_t *)products,\n");
+    fprintf(file, "    .count = %zu,\n", catalog->count);
+    fprintf(file, "    .capacity = %zu,\n", catalog->count);
+    fprintf(file, "    .index = { (const product_t **)productSlots, %zu, productSeeds, %zu },\n", distinctCount, seedCount);
+    fprintf(file, "    .categories = (category_t *)categories,\n");
+    fprintf(file, "    .categoryCount = %zu,\n", catalog->categoryCount);
+    fprintf(file, "    .categoryCapacity = %zu,\n", catalog->categoryCount);
+    fprintf(file, "    .categorySlots = (int *)categorySlots,\n");
+    fprintf(file, "    .categorySlotCapacity = %zu,\n", catalog->categorySlotCapacity);
+    fprintf(file, "    .names = { (unsigned int *)byName, (unsigned int *)gramKeys, (size_t *)gramStarts, (unsigned int *)postings, %zu },\n",
+            catalog->names.gramCount);
+    fprintf(file, "    .generated = 1\n");
+    fprintf(file, "};\n");
+
+    fclose(file);
+
+    printf("Generated %s: %zu products, %zu categories, %zu perfect hash buckets\n", outputFilename, catalog->count,
+           catalog->categoryCount, seedCount);
+
+    free(widened);
+    free(distinct);
+    free(slots);
+    free(seeds);
+    free_catalog(catalog);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,16 @@
+#ifndef CATALOG_GENERATED_H
+#define CATALOG_GENERATED_H
+
+#include "catalog_system.h"
+
+#define CATALOG_GENERATED_FILE "catalog_generated.c" //what catalog_codegen writes by default
+#define PERFECT_HASH_BUCKET_SIZE 4                   //products per perfect hash bucket on average
+
+/*the catalog compiled into the binary by catalog_codegen, linked in when built with -DCATALOG_GENERATED
+every array it points at is static, so using it costs no parsing and no heap*/
+extern catalog_t generatedCatalog;
+
+//FNV-1a of the catalog file it was generated from, see hash_catalog_file
+extern const unsigned long long generatedCatalogHash;
+
+#endif /* CATALOG_GENERATED_H */
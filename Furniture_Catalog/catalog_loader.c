@@ -0,0 +1,447 @@
+/*
+Parallel catalog loader. The catalog file is mapped into memory and cut into chunks that each start at a
+category separator, so every chunk knows its own categories. The chunks are parsed on separate threads
+into their own product arrays, which are then copied into the catalog in file order. Category names are
+collected per chunk and interned into the catalog while merging, so the workers never share a table.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "catalog_loader.h"
+#include "stats.h"
+#include "search.h"
+
+//one slice of the mapped file and the products parsed from it
+typedef struct {
+    const char *start;
+    const char *end;
+    product_t *products;
+    size_t count;
+    size_t capacity;
+    char (*categories)[MAX_PRODUCT_NAME]; //headings in the order they appear, products hold an index into it
+    size_t categoryCount;                 //entry 0 stands for the category carried over from the previous chunk
+    size_t categoryCapacity;
+} catalog_chunk_t;
+
+//copies at most size - 1 bytes of text into a terminated buffer
+static void copy_field(char *destination, size_t size, const char *text, size_t length) 
+{
+    if (length >= size) 
+    {
+        length = size - 1;
+    }
+
+    memcpy(destination, text, length);
+    destination[length] = '\0';
+}
+
+//matches a literal word after optional whitespace, advancing the cursor past it
+static int match_word(const char **cursor, const char *end, const char *word) 
+{
+    const char *text = *cursor;
+    size_t length = strlen(word);
+
+    while (text < end && isspace((unsigned char)*text)) 
+    {
+        text++;
+    }
+
+    if ((size_t)(end - text) < length || memcmp(text, word, length) != 0) 
+    {
+        return 0;
+    }
+
+    *cursor = text + length;
+    return 1;
+}
+
+//parses "<name>, product no. <number>", the same layout the sscanf loader accepted
+static int parse_product(const char *line, const char *end, product_t *product) 
+{
+    const char *comma = (const char *)memchr(line, ',', (size_t)(end - line));
+
+    if (comma == NULL || comma == line) 
+    {
+        return 0;
+    }
+
+    const char *cursor = comma + 1;
+
+    if (!match_word(&cursor, end, "product") || !match_word(&cursor, end, "no.")) 
+    {
+        return 0;
+    }
+
+    while (cursor < end && isspace((unsigned char)*cursor)) 
+    {
+        cursor++;
+    }
+
+    int negative = 0;
+
+    if (cursor < end && (*cursor == '-' || *cursor == '+')) 
+    {
+        negative = *cursor == '-';
+        cursor++;
+    }
+
+    if (cursor == end || !isdigit((unsigned char)*cursor)) 
+    {
+        return 0;
+    }
+
+    int number = 0;
+
+    while (cursor < end && isdigit((unsigned char)*cursor)) 
+    {
+        int digit = *cursor - '0';
+
+        //a number that doesn't fit an int makes the line malformed rather than wrapping or being cut short
+        if (number > (INT_MAX - digit) / 10) 
+        {
+            return 0;
+        }
+
+        number = number * 10 + digit;
+        cursor++;
+    }
+
+    //names longer than the field are cut short rather than splitting the line
+    copy_field(product->name, MAX_NAME, line, (size_t)(comma - line));
+    product->productNumber = negative ? -number : number;
+
+    return 1;
+}
+
+//appends a product to a chunk, doubling its array when it's full
+static void add_chunk_product(catalog_chunk_t *chunk, const product_t *product) 
+{
+    if (chunk->count == chunk->capacity) 
+    {
+        size_t capacity = chunk->capacity == 0 ? 256 : chunk->capacity * 2;
+        product_t *products = (product_t *)realloc(chunk->products, capacity * sizeof(product_t));
+
+        if (!products) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        chunk->products = products;
+        chunk->capacity = capacity;
+    }
+
+    chunk->products[chunk->count++] = *product;
+}
+
+//adds a heading to a chunk's category list and returns its chunk-local index
+static int add_chunk_category(catalog_chunk_t *chunk, const char *text, size_t length) 
+{
+    if (chunk->categoryCount == chunk->categoryCapacity) 
+    {
+        size_t capacity = chunk->categoryCapacity == 0 ? 16 : chunk->categoryCapacity * 2;
+        char (*categories)[MAX_PRODUCT_NAME] = realloc(chunk->categories, capacity * sizeof(*categories));
+
+        if (!categories) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        chunk->categories = categories;
+        chunk->categoryCapacity = capacity;
+    }
+
+    copy_field(chunk->categories[chunk->categoryCount], MAX_PRODUCT_NAME, text, length);
+
+    return (int)chunk->categoryCount++;
+}
+
+//parses every line of one chunk, run on its own thread
+static void *parse_chunk(void *argument) 
+{
+    catalog_chunk_t *chunk = (catalog_chunk_t *)argument;
+
+    //products before the chunk's first heading belong to whatever category the previous chunk ended in
+    int category = add_chunk_category(chunk, "", 0);
+    const char *line = chunk->start;
+
+    while (line < chunk->end) 
+    {
+        const char *newline = (const char *)memchr(line, '\n', (size_t)(chunk->end - line));
+        const char *lineEnd = newline != NULL ? newline : chunk->end;
+        const char *next = newline != NULL ? newline + 1 : chunk->end;
+
+        //drop the carriage return of CRLF files
+        if (lineEnd > line && lineEnd[-1] == '\r') 
+        {
+            lineEnd--;
+        }
+
+        if (lineEnd == line || line[0] == '-') 
+        {
+            //blank line or separator line between categories
+        } else if (lineEnd[-1] == ':') 
+        {
+            //new category from its heading, without the colon
+            category = add_chunk_category(chunk, line, (size_t)(lineEnd - line - 1));
+        } else {
+            product_t product;
+
+            //lines that aren't products are skipped
+            if (parse_product(line, lineEnd, &product)) 
+            {
+                product.categoryId = category;
+                add_chunk_product(chunk, &product);
+            }
+        }
+
+        line = next;
+    }
+
+    return NULL;
+}
+
+//moves a chunk boundary forward to the start of the next category separator line (or the end of the file)
+static const char *align_to_category(const char *position, const char *start, const char *end) 
+{
+    //start from the beginning of the next line
+    if (position > start && position[-1] != '\n') 
+    {
+        const char *newline = (const char *)memchr(position, '\n', (size_t)(end - position));
+        position = newline != NULL ? newline + 1 : end;
+    }
+
+    while (position < end && *position != '-') 
+    {
+        const char *newline = (const char *)memchr(position, '\n', (size_t)(end - position));
+        position = newline != NULL ? newline + 1 : end;
+    }
+
+    return position;
+}
+
+long long load_catalog_parallel(catalog_t *catalog, const char *filename, size_t threads) 
+{
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0) 
+    {
+        printf("Error opening file: %s\n", filename); //catching file opening errors
+        return -1;
+    }
+
+    struct stat info;
+
+    if (fstat(fd, &info) != 0) 
+    {
+        printf("Error opening file: %s\n", filename);
+        close(fd);
+        return -1;
+    }
+
+    size_t fileSize = (size_t)info.st_size;
+
+    if (fileSize == 0) 
+    {
+        close(fd);
+        build_category_index(catalog);
+        build_product_index(catalog);
+        build_name_index(catalog);
+        return 0;
+    }
+
+    const char *mapped = (const char *)mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapped == MAP_FAILED) 
+    {
+        printf("Error reading file: %s\n", filename);
+        return -1;
+    }
+
+    //one chunk per core, but not so many that chunks get tiny
+    if (threads == 0) 
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (size_t)cores : 1;
+    }
+    if (threads > fileSize / CATALOG_LOADER_MIN_CHUNK + 1) 
+    {
+        threads = fileSize / CATALOG_LOADER_MIN_CHUNK + 1;
+    }
+    if (threads > CATALOG_LOADER_MAX_THREADS) 
+    {
+        threads = CATALOG_LOADER_MAX_THREADS;
+    }
+
+    catalog_chunk_t chunks[CATALOG_LOADER_MAX_THREADS];
+    pthread_t workers[CATALOG_LOADER_MAX_THREADS];
+    int started[CATALOG_LOADER_MAX_THREADS] = {0};
+    const char *end = mapped + fileSize;
+    const char *position = mapped;
+    size_t chunkCount = 0;
+
+    //cut the file into roughly equal chunks that each begin at a category separator
+    for (size_t i = 0; i < threads && position < end; i++) 
+    {
+        const char *chunkEnd = i + 1 == threads ? end : align_to_category(mapped + fileSize * (i + 1) / threads, mapped, end);
+
+        if (chunkEnd <= position) 
+        {
+            continue;
+        }
+
+        memset(&chunks[chunkCount], 0, sizeof(catalog_chunk_t));
+        chunks[chunkCount].start = position;
+        chunks[chunkCount].end = chunkEnd;
+        chunkCount++;
+        position = chunkEnd;
+    }
+
+    //the first chunk is parsed on this thread, and so is any chunk whose worker couldn't be started
+    for (size_t i = 1; i < chunkCount; i++) 
+    {
+        started[i] = pthread_create(&workers[i], NULL, parse_chunk, &chunks[i]) == 0;
+    }
+    parse_chunk(&chunks[0]);
+
+    size_t added = chunks[0].count;
+
+    for (size_t i = 1; i < chunkCount; i++) 
+    {
+        if (started[i]) 
+        {
+            pthread_join(workers[i], NULL);
+        } else {
+            parse_chunk(&chunks[i]);
+        }
+        added += chunks[i].count;
+    }
+
+    munmap((void *)mapped, fileSize);
+
+    //merge the chunks into the catalog in file order with one allocation
+    if (catalog->count + added > catalog->capacity) 
+    {
+        product_t *products = (product_t *)realloc(catalog->products, (catalog->count + added) * sizeof(product_t));
+
+        if (!products) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        catalog->products = products;
+        catalog->capacity = catalog->count + added;
+
+        STATS_ADD(STATS_ALLOCATIONS, 1);
+        STATS_ADD(STATS_BYTES_ALLOCATED, catalog->capacity * sizeof(product_t));
+    }
+
+    //-1 stands for the unnamed category of products listed before any heading, interned only if it's used
+    int carried = -1;
+
+    for (size_t i = 0; i < chunkCount; i++) 
+    {
+        catalog_chunk_t *chunk = &chunks[i];
+        int *categoryIds = (int *)malloc(chunk->categoryCount * sizeof(int));
+
+        if (!categoryIds) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        //turn the chunk's headings into catalog-wide category IDs as they are reached, so IDs follow file order
+        size_t reached = 1;
+        categoryIds[0] = carried;
+
+        for (size_t p = 0; p < chunk->count; p++) 
+        {
+            product_t *product = &catalog->products[catalog->count++];
+
+            *product = chunk->products[p];
+
+            while (reached <= (size_t)product->categoryId) 
+            {
+                categoryIds[reached] = intern_category(catalog, chunk->categories[reached]);
+                reached++;
+            }
+            if (categoryIds[product->categoryId] < 0) 
+            {
+                categoryIds[product->categoryId] = intern_category(catalog, "");
+            }
+            product->categoryId = categoryIds[product->categoryId];
+        }
+
+        //headings with no products after them are still categories
+        for (; reached < chunk->categoryCount; reached++) 
+        {
+            categoryIds[reached] = intern_category(catalog, chunk->categories[reached]);
+        }
+
+        carried = categoryIds[chunk->categoryCount - 1];
+
+        free(categoryIds);
+        free(chunk->categories);
+        free(chunk->products);
+    }
+
+    //group the products by category, then index every product so validations and searches don't walk the list
+    build_category_index(catalog);
+    build_product_index(catalog);
+    build_name_index(catalog);
+
+    return (long long)added;
+}
+
+int hash_catalog_file(const char *filename, unsigned long long *hash) 
+{
+    FILE *file = fopen(filename, "rb");
+
+    if (!file) 
+    {
+        return -1;
+    }
+
+    unsigned char buffer[65536];
+    unsigned long long value = 14695981039346656037ULL;
+    size_t length;
+
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) 
+    {
+        for (size_t i = 0; i < length; i++) 
+        {
+            value = (value ^ buffer[i]) * 1099511628211ULL;
+        }
+    }
+
+    int failed = ferror(file);
+    fclose(file);
+
+    if (failed) 
+    {
+        return -1;
+    }
+
+    *hash = value;
+    return 0;
+}
+
+int catalog_file_changed(const char *filename, unsigned long long hash) 
+{
+    unsigned long long current;
+
+    return hash_catalog_file(filename, &current) == 0 && current != hash;
+}
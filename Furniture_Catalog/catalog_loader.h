@@ -0,0 +1,21 @@
+#ifndef CATALOG_LOADER_H
+#define CATALOG_LOADER_H
+
+#include "catalog_system.h"
+
+#define CATALOG_LOADER_MAX_THREADS 64
+#define CATALOG_LOADER_MIN_CHUNK (1024 * 1024) //bytes below which a chunk isn't worth its own thread
+
+//function declarations
+
+//maps a catalog file, parses category-aligned chunks of it on up to threads threads (0 picks one per core)
+//and appends the products to the catalog in file order, returns the number of products added or -1
+long long load_catalog_parallel(catalog_t *catalog, const char *filename, size_t threads);
+
+//FNV-1a over the bytes of the catalog file, returns 0 or -1 when it can't be read
+int hash_catalog_file(const char *filename, unsigned long long *hash);
+
+//1 if the catalog file exists and its contents no longer hash to the given value
+int catalog_file_changed(const char *filename, unsigned long long hash);
+
+#endif /* CATALOG_LOADER_H */
@@ -1,576 +1,2266 @@
-/*
-T. Annmarie Geiger (x00468652)
-
-12/5/2023
-
-This program features a catalog that takes customer's orders, returns, and reads from the custom catalog. After orders
-are made, all orders minus returns are stored in the 'customer_information.txt' file.
-*/
-
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <time.h>
-#include <ctype.h>
-#include <stdbool.h> 
-#include "catalog_system.h" //header file
-
-int main() 
-{
-    //initialize the catalog and orders
-    catalog_t *furnitureCatalog = (catalog_t *)malloc(sizeof(catalog_t));
-    furnitureCatalog->head = NULL;
-
-    order_list_t *orders = (order_list_t *)malloc(sizeof(order_list_t));
-    orders->head = NULL;
-
-    //load existing records from the file (if any)
-    load_catalog_from_file(furnitureCatalog, "furniture_catalog.txt");
-
-    //load customer information from the file
-    load_customer_information(orders, "customer_information.txt");
-
-    //display the main menu
-    int choice = 0;
-
-    do 
-    {
-        printf("\n-----Furniture Catalog System-----\n");
-        printf(" +   1. Display Catalog          +\n");
-        printf(" +   2. Place Order              +\n");
-        printf(" +   3. Display Current Orders   +\n");
-        printf(" +   4. Process Return           +\n");
-        printf(" +   5. Display Returns          +\n");
-        printf(" +   6. Quit                     +\n");
-        printf("----------------------------------\n");
-
-        printf("Enter your choice: ");
-        scanf("%d", &choice);
-
-        // Clear the input buffer
-        while (getchar() != '\n');
-
-        switch (choice) 
-        {
-            case 1:
-                display_catalog(furnitureCatalog);
-                break;
-            case 2:
-                place_order(orders, furnitureCatalog);
-                break;
-            case 3:
-                display_orders(orders);
-                break;
-            case 4:
-                process_return(orders);
-                break;
-            case 5:
-                display_returns(orders);
-                break;
-            case 6:
-                //save orders before quitting
-                save_customer_information(orders, "customer_information.txt");
-                free_catalog(furnitureCatalog);
-                free_orders(orders);
-                quit_program();
-                break;
-            default:
-                printf("Invalid choice. Please enter a number between 1 and 6.\n");
-        }
-
-    } while (choice != 6);
-
-    return 0;
-}
-
-
-void place_order(order_list_t *orders, const catalog_t *catalog) 
-{
-    char customerName[MAX_NAME];
-    int productNumber;
-    int quantity;
-    char orderNumber[MAX_ORDER_NUMBER];
-
-    //customer name with buffer size
-    printf("Enter your name: ");
-    fgets(customerName, MAX_NAME, stdin);
-
-    //generate a single order number for the entire order
-    generate_order_number(orderNumber);
-
-    do 
-    {
-        //gets product number from the user
-        printf("Enter the product number you want to order (0 to finish): ");
-
-        //input validation
-        if (scanf("%d", &productNumber) != 1) 
-        {
-            printf("Invalid input. Please enter a valid product number.\n");
-            while (getchar() != '\n');
-            continue;  // Ask for product number again
-        }
-
-        //checks if the user wants to finish adding products
-        if (productNumber == 0) 
-        {
-            break;
-        }
-
-        //input validation
-        if (!isProductNumberValid(catalog, productNumber)) 
-        {
-            printf("Product number invalid. Product does not exist.\n");
-            continue;
-        }
-
-        //get quantity and input validation
-        printf("Enter the quantity you want to order: ");
-        if (scanf("%d", &quantity) != 1 || quantity < 0) 
-        {
-            printf("Invalid input. Please enter a valid quantity.\n");
-            while (getchar() != '\n');
-            continue;
-        }
-
-        //checks if the product number already exists in the order
-        order_node_t *existingOrder = orders->head;
-
-        while (existingOrder != NULL) 
-        {
-            if (strcmp(existingOrder->order.customerName, customerName) == 0 &&
-                strcmp(existingOrder->order.orderNumber, orderNumber) == 0 &&
-                existingOrder->order.productNumber == productNumber) {
-                //updates the quantity for the existing product number
-                existingOrder->order.quantity += quantity;
-                printf("Quantity updated for existing product.\n");
-                break;
-            }
-
-            existingOrder = existingOrder->next;
-        }
-
-        //if the product number does not exist in the order, create a new order
-        if (existingOrder == NULL) 
-        {
-            // Create a new order node for each product
-            order_node_t *newOrderNode = (order_node_t *)malloc(sizeof(order_node_t));
-
-            //checks if memory allocation is successful
-            if (!newOrderNode) 
-            {
-                printf("Memory allocation failure.\n");
-                exit(EXIT_FAILURE);
-            }
-
-            //set order details for the new order node
-            strcpy(newOrderNode->order.customerName, customerName);
-            newOrderNode->order.productNumber = productNumber;
-            newOrderNode->order.quantity = quantity;
-            strcpy(newOrderNode->order.orderNumber, orderNumber);
-
-            //initialize isReturn to 0 for each new order
-            newOrderNode->order.isReturn = 0;
-
-            newOrderNode->next = NULL;
-
-            //adds the new order node to the orders list
-            if (orders->head == NULL) 
-            {
-                orders->head = newOrderNode;
-            } else {
-                order_node_t *temp = orders->head;
-                while (temp->next != NULL) 
-                {
-                    temp = temp->next;
-                }
-                temp->next = newOrderNode;
-            }
-
-            printf("Product added to order successfully.\n");
-        }
-
-    } while (productNumber != 0);
-
-    printf("Order completed. Your order number is: %s\n", orderNumber);
-}
-
-
-
-void generate_order_number(char *orderNumber) 
-{
-    srand(time(NULL));
-    snprintf(orderNumber, MAX_ORDER_NUMBER, "%04d", rand() % 10000);
-}
-
-void display_orders(const order_list_t *orders) 
-{
-    if (orders->head == NULL) 
-    {
-        printf("\nNo orders placed yet.\n");
-    } else {
-        printf("\nCurrent Orders:\n");
-
-        order_node_t *current = orders->head;
-
-        while (current != NULL) 
-        {
-            printf("Customer: %s (Order No. %s)\n", current->order.customerName, current->order.orderNumber);
-
-            order_node_t *orderGroup = current;
-
-            //print all orders for the current customer and order number
-            while (orderGroup != NULL && strcmp(orderGroup->order.customerName, current->order.customerName) == 0 &&
-                   strcmp(orderGroup->order.orderNumber, current->order.orderNumber) == 0) {
-                printf(" | Product Number: %d | Quantity: %d |\n",
-                       orderGroup->order.productNumber, orderGroup->order.quantity);
-
-                orderGroup = orderGroup->next;
-            }
-
-            current = orderGroup;  //move to the next customer and order number
-        }
-
-        printf("\n");
-    }
-}
-
-int isProductNumberValid(const catalog_t *catalog, int productNumber) 
-{
-    product_node_t *current = catalog->head;
-
-    while (current != NULL) 
-    {
-        if (current->product.productNumber == productNumber) 
-        {
-            return 1;
-        }
-        current = current->next;
-    }
-
-    return 0;
-}
-
-void process_return(order_list_t *orders) 
-{
-    char orderNumber[MAX_ORDER_NUMBER];
-
-    printf("Enter the order number for the return: ");
-    scanf("%s", orderNumber);
-
-    order_node_t *current = orders->head;
-    order_node_t *prev = NULL;
-
-    while (current != NULL) 
-    {
-        if (strcmp(current->order.orderNumber, orderNumber) == 0) 
-        {
-            //remove the entire order from the current orders list
-            if (prev == NULL) 
-            {
-                orders->head = current->next;
-            } else {
-                prev->next = current->next;
-            }
-
-            //move the entire order to the returns list
-            if (orders->returns == NULL) 
-            {
-                orders->returns = current;
-            } else {
-                order_node_t *temp = orders->returns;
-                while (temp->next != NULL) 
-                {
-                    temp = temp->next;
-                }
-                temp->next = current;
-            }
-
-            //update current to the next order in the og list
-            order_node_t *temp = current;
-            current = current->next;
-
-            //set next to NULL for the moved node
-            temp->next = NULL;
-
-            printf("Return processed successfully.\n");
-        } else {
-            prev = current;
-            current = current->next;
-        }
-    }
-
-    //if no matching order is found
-    if (orders->returns == NULL) 
-    {
-        printf("Order number not found. Return cannot be processed.\n");
-    }
-}
-
-
-
-void display_returns(order_list_t *orders) 
-{
-    int hasReturns = 0;  //flag to track if there are any returns
-
-    order_node_t *current = orders->returns;  //go through the returns list
-
-    while (current != NULL) 
-    {
-        printf("Customer: %s | Product Number: %d | Quantity: %d | Order Number: %s\n",
-               current->order.customerName, current->order.productNumber,
-               current->order.quantity, current->order.orderNumber);
-
-        hasReturns = 1;  //set the flag to indicate there are returns
-        current = current->next;
-    }
-
-    if (!hasReturns) 
-    {
-        printf("\nNo returns processed yet.\n");
-    }
-
-    printf("\n");
-}
-
-
-void quit_program() 
-{
-    printf("\nThank you for using our Furniture Catalog System!\n");
-}
-
-void display_catalog(const catalog_t *catalog) 
-{
-    if (catalog->head == NULL) 
-    {
-        printf("\nNo products in the catalog.\n");
-    } else 
-    {
-        printf("\nFurniture Catalog:\n");
-
-        //initialize currentCategory to an empty string
-        char currentCategory[MAX_PRODUCT_NAME] = "";
-        char previousProduct[MAX_PRODUCT_NAME] = "";
-
-        product_node_t *current = catalog->head;
-
-        while (current != NULL) 
-        {
-            //if conditionals to check category and product 
-            //only print the category when it changes
-            if (strcmp(currentCategory, current->product.category) != 0) {
-                if (current != catalog->head) {
-                    printf("\n");  //add a newline before printing a new category
-                }
-                strcpy(currentCategory, current->product.category);
-                printf("  %s:\n", currentCategory);
-
-                //reset the previous product for the new category
-                previousProduct[0] = '\0';
-            }
-
-            //only prints the product name if it's different from the previous one
-            if (strstr(current->product.name, ":") == NULL &&
-                strcmp(current->product.name, previousProduct) != 0) {
-                printf("    %s, product no. %d\n", current->product.name, current->product.productNumber);
-
-                //update the previous product
-                strcpy(previousProduct, current->product.name);
-            }
-
-            current = current->next;
-        }
-
-        printf("\n");
-    }
-}
-
-void free_catalog(catalog_t *catalog) 
-{
-    //free allocated memory for the catalog
-    product_node_t *current = catalog->head;
-    product_node_t *next;
-
-    while (current != NULL) 
-    {
-        next = current->next;
-        free(current);
-        current = next;
-    }
-
-    free(catalog);
-}
-
-void free_orders(order_list_t *orders) 
-{
-    //free allocated memory for the orders
-    order_node_t *current = orders->head;
-    order_node_t *next;
-
-    while (current != NULL) 
-    {
-        next = current->next;
-        free(current);
-        current = next;
-    }
-
-    free(orders);
-}
-
-void load_catalog_from_file(catalog_t *catalog, const char *filename) 
-{
-    FILE *file = fopen(filename, "r");
-
-    if (!file) 
-    {
-        printf("Error opening file: %s\n", filename); //catching file opening errors
-        return;
-    }
-
-    char line[MAX_PRODUCT_NAME];
-    char category[MAX_PRODUCT_NAME] = "";
-
-    while (fgets(line, sizeof(line), file) != NULL) 
-    {
-        //remove newline character from the end of the line
-        line[strcspn(line, "\n")] = '\0';
-
-        if (line[0] == '-') 
-        {
-            //create new category
-            strcpy(category, line + 1);
-        } else {
-            //parsing product info
-            product_t product;
-            sscanf(line, "%[^,], product no. %d", product.name, &product.productNumber);
-            strcpy(product.category, category);
-
-            //add the product to the catalog
-            product_node_t *newNode = (product_node_t *)malloc(sizeof(product_node_t));
-
-            if (!newNode) 
-            {
-                printf("Memory allocation failure.\n");
-                exit(EXIT_FAILURE);
-            }
-
-            newNode->product = product;
-            newNode->next = NULL;
-
-            if (catalog->head == NULL) 
-            {
-                catalog->head = newNode;
-            } else 
-            {
-                product_node_t *temp = catalog->head;
-                while (temp->next != NULL) 
-                {
-                    temp = temp->next;
-                }
-                temp->next = newNode;
-            }
-        }
-    }
-
-    fclose(file);
-}
-
-void save_customer_information(const order_list_t *orders, const char *filename) 
-{
-    FILE *file = fopen(filename, "w");
-
-    if (!file) //if file isn't opening or hasn't opened yet
-    {
-        printf("Error opening file: %s\n", filename);
-        return;
-    }
-
-    order_node_t *currentOrder = orders->head;
-
-    while (currentOrder != NULL) {
-        //print customer information and order number without newline
-        fprintf(file, "%s order no. %s", currentOrder->order.customerName, currentOrder->order.orderNumber);
-
-        //print product details for the current order
-        fprintf(file, " | Product No. %d | Quantity: %d |\n", currentOrder->order.productNumber, currentOrder->order.quantity);
-
-        currentOrder = currentOrder->next;
-    }
-
-    fclose(file);
-}
-
-void load_customer_information(order_list_t *orders, const char *filename) 
-{
-    //open the file for reading
-    FILE *file = fopen(filename, "r");
-
-    //check if the file is opened successfully
-    if (!file) {
-        printf("Error opening file: %s\n", filename);
-        return;
-    }
-
-    char line[MAX_NAME];
-    char orderNumber[MAX_ORDER_NUMBER];
-
-    //reads customer information and order number from the file
-    while (fscanf(file, " %[^\n] order no. %s", line, orderNumber) == 2) 
-    {
-        //display information about the loaded customer and order number
-        printf("Loaded customer: %s, order number: %s\n", line, orderNumber);
-
-        //create a new order node for each customer and order number
-        order_node_t *newOrderNode = (order_node_t *)malloc(sizeof(order_node_t));
-
-        //check if memory allocation is successful
-        if (!newOrderNode) 
-        {
-            printf("Memory allocation failure.\n");
-            exit(EXIT_FAILURE);
-        }
-
-        //copy customer name and order number, ensuring null-terminated strings
-        strncpy(newOrderNode->order.customerName, line, MAX_NAME - 1);
-        newOrderNode->order.customerName[MAX_NAME - 1] = '\0';
-
-        strncpy(newOrderNode->order.orderNumber, orderNumber, MAX_ORDER_NUMBER - 1);
-        newOrderNode->order.orderNumber[MAX_ORDER_NUMBER - 1] = '\0';
-
-        //initialize isReturn to 0 for each new order
-        newOrderNode->order.isReturn = 0;
-
-        newOrderNode->next = NULL;
-
-        //consume the newline character after reading customer information
-        fgetc(file);
-
-        //read product numbers and quantities for the current order
-        while (fscanf(file, "| Product No. %d | Quantity: %d |",
-                      &newOrderNode->order.productNumber, &newOrderNode->order.quantity) == 2) {
-            //display information about the loaded product details
-            printf("   Product number: %d, Quantity: %d\n",
-                   newOrderNode->order.productNumber, newOrderNode->order.quantity);
-
-            //adds the new order node to the orders list
-            if (orders->head == NULL) 
-            {
-                orders->head = newOrderNode;
-            } else 
-            {
-                order_node_t *temp = orders->head;
-                while (temp->next != NULL) {
-                    temp = temp->next;
-                }
-                temp->next = newOrderNode;
-            }
-
-            //consume the newline character after reading product details
-            fgetc(file);
-        }
-    }
-
-    //close the file
-    fclose(file);
+/*
+T. Annmarie Geiger (x00468652)
+
+12/5/2023
+
+This program features a catalog that takes customer's orders, returns, and reads from the custom catalog. After orders
+are made, all orders minus returns are stored in the 'customer_information.txt' file.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <ctype.h>
+#include <stdbool.h> 
+#include "catalog_system.h" //header file
+#include "arena.h"
+#include "journal.h"
+#include "catalog_loader.h"
+#include "render.h"
+#include "stats.h"
+#include "live_catalog.h"
+#include "search.h"
+#include "inventory.h"
+#include "archive.h"
+#include "snapshot.h"
+
+catalog_t *create_catalog(void) 
+{
+    catalog_t *catalog = (catalog_t *)calloc(1, sizeof(catalog_t));
+
+    if (!catalog) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return catalog;
+}
+
+order_list_t *create_orders(void) 
+{
+    order_list_t *orders = (order_list_t *)calloc(1, sizeof(order_list_t));
+
+    if (!orders) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    //each shard's stores share the shard's arena so they can be released together
+    for (size_t i = 0; i < ORDER_SHARDS; i++) 
+    {
+        order_shard_t *shard = &orders->shards[i];
+
+        pthread_mutex_init(&shard->lock, NULL);
+        arena_init(&shard->arena, ARENA_BLOCK_SIZE);
+        shard->current.arena = &shard->arena;
+        shard->returns.entries.arena = &shard->arena;
+    }
+
+    pthread_mutex_init(&orders->sequence.lock, NULL);
+    pthread_mutex_init(&orders->customers.lock, NULL);
+    arena_init(&orders->customers.arena, ARENA_BLOCK_SIZE);
+
+    return orders;
+}
+
+order_t *append_order(order_store_t *store, const order_t *order) 
+{
+    //start a new chunk once the tail is full
+    if (store->tail == NULL || store->tail->count == ORDER_CHUNK_SIZE) 
+    {
+        order_chunk_t *chunk = (order_chunk_t *)arena_alloc(store->arena, sizeof(order_chunk_t));
+
+        chunk->count = 0;
+        chunk->next = NULL;
+
+        if (store->tail == NULL) 
+        {
+            store->head = chunk;
+        } else {
+            store->tail->next = chunk;
+        }
+        store->tail = chunk;
+    }
+
+    order_t *stored = &store->tail->orders[store->tail->count++];
+    *stored = *order;
+    store->count++;
+
+    return stored;
+}
+
+//FNV-1a hash of a customer name, mask picks the slot
+static size_t hash_name(const char *name, size_t mask) 
+{
+    unsigned int hash = 2166136261u;
+
+    for (const unsigned char *c = (const unsigned char *)name; *c != '\0'; c++) 
+    {
+        hash = (hash ^ *c) * 16777619u;
+    }
+
+    return (size_t)hash & mask;
+}
+
+//spreads order and customer IDs over the table (Fibonacci hashing), mask picks the slot
+static size_t hash_key(unsigned long long key, size_t mask) 
+{
+    return (size_t)((key * 11400714819323198485ull) >> 32) & mask;
+}
+
+//finds the slot of a key, or the empty slot where it belongs
+static order_entry_t *order_index_slot(const order_index_t *index, unsigned long long key) 
+{
+    size_t mask = index->capacity - 1;
+    size_t slot = hash_key(key, mask);
+
+    while (index->slots[slot].count != 0 && index->slots[slot].key != key) 
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return &index->slots[slot];
+}
+
+//doubles an order index and re-inserts every entry
+static void grow_order_index(order_index_t *index) 
+{
+    order_index_t grown;
+    grown.capacity = index->capacity == 0 ? 64 : index->capacity * 2;
+    grown.count = index->count;
+    grown.slots = (order_entry_t *)calloc(grown.capacity, sizeof(order_entry_t));
+
+    if (!grown.slots) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < index->capacity; i++) 
+    {
+        if (index->slots[i].count != 0) 
+        {
+            *order_index_slot(&grown, index->slots[i].key) = index->slots[i];
+        }
+    }
+
+    free(index->slots);
+    *index = grown;
+}
+
+order_shard_t *order_shard(const order_list_t *orders, order_id_t orderId) 
+{
+    return (order_shard_t *)&orders->shards[hash_key(orderId, (size_t)-1) % ORDER_SHARDS];
+}
+
+size_t hash_product_number(int productNumber, size_t mask) 
+{
+    return (size_t)(((unsigned int)productNumber * 2654435769u) >> 7) & mask;
+}
+
+//finds the slot of a product, or the empty slot where it belongs
+static product_orders_t *product_orders_slot(const product_orders_index_t *index, int productNumber) 
+{
+    size_t mask = index->capacity - 1;
+    size_t slot = hash_product_number(productNumber, mask);
+
+    while (index->slots[slot].count != 0 && index->slots[slot].productNumber != productNumber) 
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return &index->slots[slot];
+}
+
+//doubles a product index and re-inserts every entry
+static void grow_product_orders_index(product_orders_index_t *index) 
+{
+    product_orders_index_t grown;
+    grown.capacity = index->capacity == 0 ? 64 : index->capacity * 2;
+    grown.count = index->count;
+    grown.slots = (product_orders_t *)calloc(grown.capacity, sizeof(product_orders_t));
+
+    if (!grown.slots) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < index->capacity; i++) 
+    {
+        if (index->slots[i].count != 0) 
+        {
+            *product_orders_slot(&grown, index->slots[i].productNumber) = index->slots[i];
+        }
+    }
+
+    free(index->slots);
+    *index = grown;
+}
+
+//appends a line item to an index entry's list
+static void add_entry_item(arena_t *arena, order_t ***items, size_t *count, size_t *capacity, order_t *order) 
+{
+    if (*count == *capacity) 
+    {
+        //grow into fresh arena memory, the old list is reclaimed with the arena
+        size_t grown = *capacity == 0 ? 4 : *capacity * 2;
+        order_t **list = (order_t **)arena_alloc(arena, grown * sizeof(order_t *));
+
+        if (*count > 0) 
+        {
+            memcpy(list, *items, *count * sizeof(order_t *));
+        }
+
+        *items = list;
+        *capacity = grown;
+    }
+
+    (*items)[(*count)++] = order;
+}
+
+//adds a line item to an order or customer index under its key
+static void index_line_item(order_shard_t *shard, order_index_t *index, unsigned long long key, order_t *order) 
+{
+    //keep the index at most half full
+    if ((index->count + 1) * 2 > index->capacity) 
+    {
+        grow_order_index(index);
+    }
+
+    order_entry_t *entry = order_index_slot(index, key);
+
+    if (entry->count == 0) 
+    {
+        entry->key = key;
+        index->count++;
+    }
+
+    add_entry_item(&shard->arena, &entry->items, &entry->count, &entry->capacity, order);
+}
+
+//appends a line item to the shard's columns and returns its position
+static unsigned int append_column(order_shard_t *shard, const order_t *order, int categoryId) 
+{
+    order_columns_t *columns = &shard->columns;
+    size_t offset = columns->count % ORDER_COLUMN_BLOCK;
+
+    //start a new block once the last one is full
+    if (offset == 0) 
+    {
+        if (columns->blockCount == columns->blockCapacity) 
+        {
+            size_t capacity = columns->blockCapacity == 0 ? 16 : columns->blockCapacity * 2;
+            order_column_block_t **blocks = (order_column_block_t **)realloc(columns->blocks, capacity * sizeof(order_column_block_t *));
+
+            if (!blocks) 
+            {
+                printf("Memory allocation failure.\n");
+                exit(EXIT_FAILURE);
+            }
+
+            columns->blocks = blocks;
+            columns->blockCapacity = capacity;
+        }
+
+        columns->blocks[columns->blockCount++] = (order_column_block_t *)arena_alloc(&shard->arena, sizeof(order_column_block_t));
+    }
+
+    order_column_block_t *block = columns->blocks[columns->blockCount - 1];
+
+    block->productNumber[offset] = order->productNumber;
+    block->quantity[offset] = order->quantity;
+    block->categoryId[offset] = categoryId;
+    block->customerId[offset] = order->customerId;
+    block->returnedQuantity[offset] = order->returnedQuantity;
+
+    return (unsigned int)columns->count++;
+}
+
+//adds a line item to a product index under its product number
+static void index_by_product(order_shard_t *shard, product_orders_index_t *index, order_t *order) 
+{
+    //keep the index at most half full
+    if ((index->count + 1) * 2 > index->capacity) 
+    {
+        grow_product_orders_index(index);
+    }
+
+    product_orders_t *productOrders = product_orders_slot(index, order->productNumber);
+
+    if (productOrders->count == 0) 
+    {
+        productOrders->productNumber = order->productNumber;
+        index->count++;
+    }
+
+    add_entry_item(&shard->arena, &productOrders->items, &productOrders->count, &productOrders->capacity, order);
+}
+
+//the column block holding a line item, offset by column % ORDER_COLUMN_BLOCK
+static order_column_block_t *column_block(order_shard_t *shard, const order_t *order) 
+{
+    return shard->columns.blocks[order->column / ORDER_COLUMN_BLOCK];
+}
+
+//the catalog new line items take their category IDs from, the newest version when the catalog is live
+static const catalog_t *acquire_orders_catalog(const order_list_t *orders) 
+{
+    return orders->liveCatalog != NULL ? live_catalog_acquire(orders->liveCatalog) : orders->catalog;
+}
+
+static void release_orders_catalog(const order_list_t *orders) 
+{
+    if (orders->liveCatalog != NULL) 
+    {
+        live_catalog_release(orders->liveCatalog);
+    }
+}
+
+//appends a line item whose category is already known to a shard and indexes it, the caller holds the shard lock
+static order_t *store_categorized_line_item(order_shard_t *shard, const order_t *order, int categoryId) 
+{
+    order_t *stored = append_order(&shard->current, order);
+
+    index_line_item(shard, &shard->byNumber, stored->orderId, stored);
+    index_line_item(shard, &shard->byCustomer, stored->customerId, stored);
+    stored->column = append_column(shard, stored, categoryId);
+    index_by_product(shard, &shard->byProduct, stored);
+
+    return stored;
+}
+
+//appends a line item to a shard and indexes it by order number, customer and product, the caller holds the shard lock
+static order_t *store_line_item(order_shard_t *shard, const order_t *order, const catalog_t *catalog) 
+{
+    //the category is looked up once here so reports never need the catalog per line item
+    const product_t *product = catalog != NULL ? find_product(catalog, order->productNumber) : NULL;
+
+    return store_categorized_line_item(shard, order, product != NULL ? product->categoryId : -1);
+}
+
+//appends a return to the shard's ledger and indexes it by order number, customer and product, the caller holds the shard lock
+//entry is a copy of the line item with the units returned as its quantity
+static void store_return_entry(order_shard_t *shard, const order_t *entry) 
+{
+    order_t *stored = append_order(&shard->returns.entries, entry);
+
+    index_line_item(shard, &shard->returns.byNumber, stored->orderId, stored);
+    index_line_item(shard, &shard->returns.byCustomer, stored->customerId, stored);
+    index_by_product(shard, &shard->returns.byProduct, stored);
+}
+
+//returns units of a line item: counts them on the line item and its column and records them in the ledger
+//the caller holds the shard lock and has checked that the line item has that many units left
+static void return_units(order_shard_t *shard, order_t *order, int units) 
+{
+    order->returnedQuantity += units;
+    order->isReturn = order->returnedQuantity >= order->quantity;
+    column_block(shard, order)->returnedQuantity[order->column % ORDER_COLUMN_BLOCK] = order->returnedQuantity;
+
+    order_t entry = *order;
+    entry.quantity = units;
+    entry.returnedQuantity = 0;
+    entry.isReturn = 1;
+
+    store_return_entry(shard, &entry);
+}
+
+const order_entry_t *shard_find_order(const order_shard_t *shard, order_id_t orderId) 
+{
+    if (shard->byNumber.capacity == 0) 
+    {
+        return NULL;
+    }
+
+    order_entry_t *entry = order_index_slot(&shard->byNumber, orderId);
+
+    return entry->count == 0 ? NULL : entry;
+}
+
+const order_entry_t *shard_find_customer(const order_shard_t *shard, unsigned int customerId) 
+{
+    if (shard->byCustomer.capacity == 0) 
+    {
+        return NULL;
+    }
+
+    order_entry_t *entry = order_index_slot(&shard->byCustomer, customerId);
+
+    return entry->count == 0 ? NULL : entry;
+}
+
+const product_orders_t *shard_find_product(const order_shard_t *shard, int productNumber) 
+{
+    if (shard->byProduct.capacity == 0) 
+    {
+        return NULL;
+    }
+
+    product_orders_t *entry = product_orders_slot(&shard->byProduct, productNumber);
+
+    return entry->count == 0 ? NULL : entry;
+}
+
+const order_entry_t *shard_find_order_returns(const order_shard_t *shard, order_id_t orderId) 
+{
+    if (shard->returns.byNumber.capacity == 0) 
+    {
+        return NULL;
+    }
+
+    order_entry_t *entry = order_index_slot(&shard->returns.byNumber, orderId);
+
+    return entry->count == 0 ? NULL : entry;
+}
+
+const order_entry_t *shard_find_customer_returns(const order_shard_t *shard, unsigned int customerId) 
+{
+    if (shard->returns.byCustomer.capacity == 0) 
+    {
+        return NULL;
+    }
+
+    order_entry_t *entry = order_index_slot(&shard->returns.byCustomer, customerId);
+
+    return entry->count == 0 ? NULL : entry;
+}
+
+const product_orders_t *shard_find_product_returns(const order_shard_t *shard, int productNumber) 
+{
+    if (shard->returns.byProduct.capacity == 0) 
+    {
+        return NULL;
+    }
+
+    product_orders_t *entry = product_orders_slot(&shard->returns.byProduct, productNumber);
+
+    return entry->count == 0 ? NULL : entry;
+}
+
+//finds the slot of a customer name, or the empty slot where it belongs, the caller holds the pool lock
+static unsigned int *customer_slot(const customer_pool_t *pool, const char *customerName) 
+{
+    size_t mask = pool->slotCapacity - 1;
+    size_t slot = hash_name(customerName, mask);
+
+    while (pool->slots[slot] != 0 && strcmp(customer_name(pool, pool->slots[slot] - 1), customerName) != 0) 
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return &pool->slots[slot];
+}
+
+unsigned int intern_customer(customer_pool_t *pool, const char *customerName) 
+{
+    pthread_mutex_lock(&pool->lock);
+
+    unsigned int count = atomic_load_explicit(&pool->count, memory_order_relaxed);
+
+    //keep the table at most half full, rehashing every name when it doubles
+    if ((count + 1) * 2 > pool->slotCapacity) 
+    {
+        size_t capacity = pool->slotCapacity == 0 ? 64 : pool->slotCapacity * 2;
+        unsigned int *slots = (unsigned int *)calloc(capacity, sizeof(unsigned int));
+
+        if (!slots) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        free(pool->slots);
+        pool->slots = slots;
+        pool->slotCapacity = capacity;
+
+        for (unsigned int id = 0; id < count; id++) 
+        {
+            *customer_slot(pool, customer_name(pool, id)) = id + 1;
+        }
+    }
+
+    unsigned int *slot = customer_slot(pool, customerName);
+
+    if (*slot == 0) 
+    {
+        if (count == CUSTOMER_POOL_BLOCK * CUSTOMER_POOL_BLOCKS) 
+        {
+            printf("Too many customers.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        //blocks are filled in order and never move, so readers can index them without the lock
+        if (count % CUSTOMER_POOL_BLOCK == 0) 
+        {
+            pool->blocks[count / CUSTOMER_POOL_BLOCK] = (const char **)arena_alloc(&pool->arena, CUSTOMER_POOL_BLOCK * sizeof(const char *));
+        }
+
+        size_t length = strlen(customerName) + 1;
+        char *name = (char *)arena_alloc(&pool->arena, length);
+        memcpy(name, customerName, length);
+
+        pool->blocks[count / CUSTOMER_POOL_BLOCK][count % CUSTOMER_POOL_BLOCK] = name;
+        *slot = count + 1;
+        atomic_store_explicit(&pool->count, count + 1, memory_order_release);
+    }
+
+    unsigned int customerId = *slot - 1;
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return customerId;
+}
+
+int find_customer(const customer_pool_t *pool, const char *customerName) 
+{
+    customer_pool_t *lockedPool = (customer_pool_t *)pool;
+    int customerId = -1;
+
+    pthread_mutex_lock(&lockedPool->lock);
+
+    if (pool->slotCapacity != 0) 
+    {
+        customerId = (int)*customer_slot(pool, customerName) - 1;
+    }
+
+    pthread_mutex_unlock(&lockedPool->lock);
+
+    return customerId;
+}
+
+const char *customer_name(const customer_pool_t *pool, unsigned int customerId) 
+{
+    if (customerId >= atomic_load_explicit(&((customer_pool_t *)pool)->count, memory_order_acquire)) 
+    {
+        return "";
+    }
+
+    return pool->blocks[customerId / CUSTOMER_POOL_BLOCK][customerId % CUSTOMER_POOL_BLOCK];
+}
+
+void add_line_item(order_list_t *orders, const order_t *order) 
+{
+    order_shard_t *shard = order_shard(orders, order->orderId);
+    const catalog_t *catalog = acquire_orders_catalog(orders);
+
+    pthread_mutex_lock(&shard->lock);
+
+    store_line_item(shard, order, catalog);
+
+    pthread_mutex_unlock(&shard->lock);
+    release_orders_catalog(orders);
+}
+
+int add_order_quantity(order_list_t *orders, const order_t *order) 
+{
+    order_shard_t *shard = order_shard(orders, order->orderId);
+    const catalog_t *catalog = acquire_orders_catalog(orders);
+    int created = 0;
+
+    pthread_mutex_lock(&shard->lock);
+
+    //quantity for a product already on the order is added to its line item
+    const order_entry_t *entry = shard_find_order(shard, order->orderId);
+    order_t *existingOrder = NULL;
+
+    for (size_t i = 0; entry != NULL && i < entry->count; i++) 
+    {
+        if (entry->items[i]->productNumber == order->productNumber && !entry->items[i]->isReturn) 
+        {
+            existingOrder = entry->items[i];
+            break;
+        }
+    }
+
+    if (existingOrder != NULL) 
+    {
+        existingOrder->quantity += order->quantity;
+        column_block(shard, existingOrder)->quantity[existingOrder->column % ORDER_COLUMN_BLOCK] = existingOrder->quantity;
+    } else {
+        store_line_item(shard, order, catalog);
+        created = 1;
+    }
+
+    //journaled while the shard is still locked, so the journal sees changes to one order in the order they happened
+    journal_order(orders, order, order->quantity);
+
+    pthread_mutex_unlock(&shard->lock);
+    release_orders_catalog(orders);
+
+    return created;
+}
+
+int is_valid_customer_name(const char *name) 
+{
+    size_t length = strlen(name);
+
+    if (length == 0 || length >= MAX_NAME) 
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < length; i++) 
+    {
+        if (iscntrl((unsigned char)name[i])) 
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+void init_order_draft(order_draft_t *draft, const char *customerName) 
+{
+    memset(draft, 0, sizeof(order_draft_t));
+    snprintf(draft->customerName, MAX_NAME, "%s", customerName);
+}
+
+//finds the slot of a product in a draft, or the empty slot where it belongs
+static int *order_draft_slot(const order_draft_t *draft, int productNumber) 
+{
+    size_t mask = draft->slotCapacity - 1;
+    size_t slot = hash_product_number(productNumber, mask);
+
+    while (draft->slots[slot] != 0 && draft->items[draft->slots[slot] - 1].productNumber != productNumber) 
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return &draft->slots[slot];
+}
+
+int add_to_order_draft(order_draft_t *draft, int productNumber, int quantity) 
+{
+    if (draft->slotCapacity != 0) 
+    {
+        int *slot = order_draft_slot(draft, productNumber);
+
+        if (*slot != 0) 
+        {
+            order_t *item = &draft->items[*slot - 1];
+
+            if (quantity > 0 && item->quantity > INT_MAX - quantity) 
+            {
+                return -1;
+            }
+
+            item->quantity += quantity;
+            return 0;
+        }
+    }
+
+    if (draft->count == draft->capacity) 
+    {
+        size_t capacity = draft->capacity == 0 ? 16 : draft->capacity * 2;
+        order_t *items = (order_t *)realloc(draft->items, capacity * sizeof(order_t));
+
+        if (!items) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        draft->items = items;
+        draft->capacity = capacity;
+    }
+
+    //keep the map at most half full, rehashing every item when it doubles
+    if ((draft->count + 1) * 2 > draft->slotCapacity) 
+    {
+        size_t capacity = draft->slotCapacity == 0 ? 32 : draft->slotCapacity * 2;
+        int *slots = (int *)calloc(capacity, sizeof(int));
+
+        if (!slots) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        free(draft->slots);
+        draft->slots = slots;
+        draft->slotCapacity = capacity;
+
+        for (size_t i = 0; i < draft->count; i++) 
+        {
+            *order_draft_slot(draft, draft->items[i].productNumber) = (int)i + 1;
+        }
+    }
+
+    order_t *item = &draft->items[draft->count++];
+
+    //the order and customer IDs are filled in when the draft is committed
+    item->orderId = 0;
+    item->customerId = 0;
+    item->productNumber = productNumber;
+    item->quantity = quantity;
+    item->isReturn = 0;
+    item->returnedQuantity = 0;
+    item->placedAt = 0;
+    *order_draft_slot(draft, productNumber) = (int)draft->count;
+
+    return 1;
+}
+
+size_t commit_order_draft(order_list_t *orders, order_draft_t *draft, char *orderNumber) 
+{
+    STATS_START(timer);
+
+    draft->failure = ORDER_DRAFT_PLACED;
+    draft->failedProduct = 0;
+
+    //a quantity that isn't positive would add stock instead of taking it
+    for (size_t i = 0; i < draft->count; i++) 
+    {
+        if (draft->items[i].quantity <= 0) 
+        {
+            draft->failure = ORDER_DRAFT_BAD_QUANTITY;
+            draft->failedProduct = draft->items[i].productNumber;
+            orderNumber[0] = '\0';
+            STATS_STOP(STATS_PLACE_ORDER, timer);
+            return 0;
+        }
+    }
+
+    //all of the stock or none of it, so an order never goes out partly filled
+    for (size_t i = 0; i < draft->count; i++) 
+    {
+        if (!reserve_stock(orders->inventory, draft->items[i].productNumber, draft->items[i].quantity)) 
+        {
+            draft->failure = ORDER_DRAFT_OUT_OF_STOCK;
+            draft->failedProduct = draft->items[i].productNumber;
+
+            while (i-- > 0) 
+            {
+                restock(orders->inventory, draft->items[i].productNumber, draft->items[i].quantity);
+            }
+
+            orderNumber[0] = '\0';
+            STATS_STOP(STATS_PLACE_ORDER, timer);
+            return 0;
+        }
+    }
+
+    order_id_t orderId;
+
+    if (!generate_order_number(&orders->sequence, &orderId)) 
+    {
+        draft->failure = ORDER_DRAFT_NO_NUMBER;
+
+        for (size_t i = 0; i < draft->count; i++) 
+        {
+            restock(orders->inventory, draft->items[i].productNumber, draft->items[i].quantity);
+        }
+
+        orderNumber[0] = '\0';
+        STATS_STOP(STATS_PLACE_ORDER, timer);
+        return 0;
+    }
+
+    format_order_number(orderId, orderNumber);
+
+    size_t stored = draft->count;
+
+    if (stored > 0) 
+    {
+        //the customer is looked up once for the whole order
+        unsigned int customerId = intern_customer(&orders->customers, draft->customerName);
+        unsigned int placedAt = (unsigned int)time(NULL);
+        order_shard_t *shard = order_shard(orders, orderId);
+        const catalog_t *catalog = acquire_orders_catalog(orders);
+
+        pthread_mutex_lock(&shard->lock);
+
+        //the order number is new, so every item becomes its own line item without looking for one to merge with
+        for (size_t i = 0; i < draft->count; i++) 
+        {
+            draft->items[i].orderId = orderId;
+            draft->items[i].customerId = customerId;
+            draft->items[i].placedAt = placedAt;
+            store_line_item(shard, &draft->items[i], catalog);
+            journal_order(orders, &draft->items[i], draft->items[i].quantity);
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+        release_orders_catalog(orders);
+
+        //empty the draft for the next order
+        draft->count = 0;
+        memset(draft->slots, 0, draft->slotCapacity * sizeof(int));
+    }
+
+    STATS_STOP(STATS_PLACE_ORDER, timer);
+
+    return stored;
+}
+
+void free_order_draft(order_draft_t *draft) 
+{
+    free(draft->items);
+    free(draft->slots);
+    memset(draft, 0, sizeof(order_draft_t));
+}
+
+size_t find_order(order_list_t *orders, const char *orderNumber, order_t *items, size_t maxItems) 
+{
+    STATS_START(timer);
+
+    order_id_t orderId;
+    size_t count = 0;
+
+    if (parse_order_number(orderNumber, &orderId)) 
+    {
+        order_shard_t *shard = order_shard(orders, orderId);
+
+        pthread_mutex_lock(&shard->lock);
+
+        const order_entry_t *entry = shard_find_order(shard, orderId);
+
+        for (; entry != NULL && count < entry->count; count++) 
+        {
+            if (count < maxItems) 
+            {
+                items[count] = *entry->items[count];
+            }
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+
+        if (entry == NULL && orders->archive != NULL) 
+        {
+            count = archive_copy_order(orders->archive, orders, orderId, items, maxItems);
+        }
+    }
+
+    STATS_STOP(STATS_FIND_ORDER, timer);
+    STATS_ADD(STATS_LOOKUPS, 1);
+    STATS_ADD(STATS_LOOKUP_MISSES, count == 0);
+
+    return count;
+}
+
+size_t count_line_items(const order_list_t *orders) 
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < ORDER_SHARDS; i++) 
+    {
+        count += orders->shards[i].current.count;
+    }
+
+    return count;
+}
+
+//releases the order index table, the item lists live in the arena
+static void free_order_index(order_index_t *index) 
+{
+    free(index->slots);
+    index->slots = NULL;
+    index->capacity = 0;
+    index->count = 0;
+}
+
+//whether a line item or return was placed before cutoff, those without a placement time never are
+static int placed_before(const order_t *order, unsigned int cutoff) 
+{
+    return order->placedAt != 0 && order->placedAt < cutoff;
+}
+
+//copies what a store keeps into a new array, with each line item's category when categories isn't NULL
+static order_t *keep_placed_since(order_shard_t *shard, const order_store_t *store, unsigned int cutoff, int **categories, size_t *kept) 
+{
+    order_t *items = (order_t *)malloc((store->count + 1) * sizeof(order_t));
+    int *categoryIds = categories != NULL ? (int *)malloc((store->count + 1) * sizeof(int)) : NULL;
+
+    if (!items || (categories != NULL && !categoryIds)) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *kept = 0;
+
+    for (const order_chunk_t *chunk = store->head; chunk != NULL; chunk = chunk->next) 
+    {
+        for (size_t i = 0; i < chunk->count; i++) 
+        {
+            if (placed_before(&chunk->orders[i], cutoff)) 
+            {
+                continue;
+            }
+
+            if (categoryIds != NULL) 
+            {
+                categoryIds[*kept] = column_block(shard, &chunk->orders[i])->categoryId[chunk->orders[i].column % ORDER_COLUMN_BLOCK];
+            }
+
+            items[(*kept)++] = chunk->orders[i];
+        }
+    }
+
+    if (categories != NULL) 
+    {
+        *categories = categoryIds;
+    }
+
+    return items;
+}
+
+size_t drop_orders_placed_before(order_list_t *orders, unsigned int cutoff) 
+{
+    size_t dropped = 0;
+
+    for (size_t s = 0; s < ORDER_SHARDS; s++) 
+    {
+        order_shard_t *shard = &orders->shards[s];
+        int *categories;
+        size_t keptItems;
+        size_t keptReturns;
+        order_t *items = keep_placed_since(shard, &shard->current, cutoff, &categories, &keptItems);
+        order_t *returns = keep_placed_since(shard, &shard->returns.entries, cutoff, NULL, &keptReturns);
+
+        dropped += shard->current.count - keptItems;
+
+        if (keptItems == shard->current.count && keptReturns == shard->returns.entries.count) 
+        {
+            free(items);
+            free(categories);
+            free(returns);
+            continue;
+        }
+
+        //start the shard over empty, the copies are stored again in their original order
+        free_order_index(&shard->byNumber);
+        free_order_index(&shard->byCustomer);
+        free(shard->byProduct.slots);
+        memset(&shard->byProduct, 0, sizeof(shard->byProduct));
+        free_order_index(&shard->returns.byNumber);
+        free_order_index(&shard->returns.byCustomer);
+        free(shard->returns.byProduct.slots);
+        memset(&shard->returns.byProduct, 0, sizeof(shard->returns.byProduct));
+        free(shard->columns.blocks);
+        memset(&shard->columns, 0, sizeof(shard->columns));
+        arena_free_all(&shard->arena);
+        arena_init(&shard->arena, ARENA_BLOCK_SIZE);
+        shard->current.head = shard->current.tail = NULL;
+        shard->current.count = 0;
+        shard->returns.entries.head = shard->returns.entries.tail = NULL;
+        shard->returns.entries.count = 0;
+
+        for (size_t i = 0; i < keptItems; i++) 
+        {
+            store_categorized_line_item(shard, &items[i], categories[i]);
+        }
+
+        for (size_t i = 0; i < keptReturns; i++) 
+        {
+            store_return_entry(shard, &returns[i]);
+        }
+
+        free(items);
+        free(categories);
+        free(returns);
+    }
+
+    return dropped;
+}
+
+//looks a product up by part of its name, listing the choices when more than one matches
+static const product_t *find_product_by_name(const catalog_t *catalog, const char *query) 
+{
+    const product_t *matches[SEARCH_MAX_RESULTS];
+    size_t found = search_products(catalog, query, matches, SEARCH_MAX_RESULTS);
+
+    if (found == 0) 
+    {
+        printf("No product matches '%s'.\n", query);
+        return NULL;
+    }
+
+    if (found == 1) 
+    {
+        return matches[0];
+    }
+
+    printf("Products matching '%s'%s:\n", query, found == SEARCH_MAX_RESULTS ? " (first few)" : "");
+
+    for (size_t i = 0; i < found; i++) 
+    {
+        printf("  %s, product no. %d (%s)\n", matches[i]->name, matches[i]->productNumber,
+               category_name(catalog, matches[i]->categoryId));
+    }
+
+    printf("Enter the product number of the one you want.\n");
+
+    return NULL;
+}
+
+void place_order(order_list_t *orders, const catalog_t *catalog) 
+{
+    char customerName[MAX_NAME];
+    char query[MAX_NAME];
+    int productNumber = -1;
+    int quantity;
+    char orderNumber[MAX_ORDER_NUMBER];
+
+    //customer name with buffer size
+    printf("Enter your name: ");
+    fgets(customerName, MAX_NAME, stdin);
+    customerName[strcspn(customerName, "\n")] = '\0';
+
+    if (!is_valid_customer_name(customerName)) 
+    {
+        printf("Invalid name. Names can't be empty or hold control characters.\n");
+        return;
+    }
+
+    //the order is built up in a draft and stored in one step once the customer is done
+    order_draft_t draft;
+    init_order_draft(&draft, customerName);
+
+    do 
+    {
+        //gets a product number, or part of a product name, from the user
+        printf("Enter the product number or name you want to order (0 to finish): ");
+
+        if (fgets(query, sizeof(query), stdin) == NULL) 
+        {
+            break;
+        }
+
+        //the rest of an overlong line is dropped
+        if (strchr(query, '\n') == NULL) 
+        {
+            int c;
+            while ((c = getchar()) != '\n' && c != EOF);
+        }
+        query[strcspn(query, "\r\n")] = '\0';
+
+        //input validation
+        if (query[0] == '\0') 
+        {
+            printf("Invalid input. Please enter a valid product number.\n");
+            continue;  // Ask for product number again
+        }
+
+        char *end;
+        long number = strtol(query, &end, 10);
+        const product_t *product;
+
+        if (*end == '\0') 
+        {
+            productNumber = (int)number;
+
+            //checks if the user wants to finish adding products
+            if (productNumber == 0) 
+            {
+                break;
+            }
+
+            //input validation, the index hands back the product itself for the confirmation below
+            product = find_product(catalog, productNumber);
+
+            if (product == NULL) 
+            {
+                printf("Product number invalid. Product does not exist.\n");
+                continue;
+            }
+        } else {
+            //anything that isn't a number is a name query
+            product = find_product_by_name(catalog, query);
+
+            if (product == NULL) 
+            {
+                continue;
+            }
+
+            productNumber = product->productNumber;
+        }
+
+        //get quantity and input validation
+        printf("Enter the quantity you want to order: ");
+        if (scanf("%d", &quantity) != 1 || quantity <= 0) 
+        {
+            printf("Invalid input. Please enter a valid quantity.\n");
+            while (getchar() != '\n');
+            continue;
+        }
+        while (getchar() != '\n');
+
+        //only a hint, the stock is reserved when the order is placed
+        long long stock = stock_level(orders->inventory, productNumber);
+
+        if (stock != INVENTORY_UNTRACKED && stock < quantity) 
+        {
+            printf("Only %lld of product number %d left in stock.\n", stock > 0 ? stock : 0, productNumber);
+            continue;
+        }
+
+        //adds a new line item, or updates the quantity if the product number already exists in the order
+        int added = add_to_order_draft(&draft, productNumber, quantity);
+
+        if (added > 0) 
+        {
+            printf("%s (%s) added to order successfully.\n", product->name, category_name(catalog, product->categoryId));
+        } else if (added == 0) 
+        {
+            printf("Quantity updated for existing product.\n");
+        } else {
+            printf("Invalid input. That's more of product number %d than one order can hold.\n", productNumber);
+        }
+
+    } while (productNumber != 0);
+
+    //a single order number for the entire order
+    if (commit_order_draft(orders, &draft, orderNumber) == 0 && draft.failure == ORDER_DRAFT_BAD_QUANTITY) 
+    {
+        printf("Invalid quantity for product number %d, the order was not placed.\n", draft.failedProduct);
+    } else if (draft.failure == ORDER_DRAFT_OUT_OF_STOCK) 
+    {
+        //someone else took the last units after they were checked above
+        printf("Product number %d is out of stock, the order was not placed.\n", draft.failedProduct);
+    } else if (draft.failure == ORDER_DRAFT_NO_NUMBER) 
+    {
+        printf("No order number could be reserved, the order was not placed.\n");
+    } else {
+        printf("Order completed. Your order number is: %s\n", orderNumber);
+    }
+    free_order_draft(&draft);
+}
+
+
+
+//persists a new high-water mark so a restart never reissues a number handed out before it
+//returns 0 on success and -1 if the sequence file couldn't be written (the limit stays where it was)
+static int reserve_order_numbers(order_sequence_t *sequence, unsigned long long limit) 
+{
+    if (sequence->filename[0] == '\0') 
+    {
+        atomic_store(&sequence->limit, limit);
+        return 0;
+    }
+
+    //written beside the old file and renamed over it, a crash mid-write must not lose the limit
+    char text[64];
+    int length = snprintf(text, sizeof(text), "%u %llu\n", sequence->node, limit);
+
+    if (replace_file(sequence->filename, text, (size_t)length) != 0) 
+    {
+        printf("Error writing file: %s\n", sequence->filename);
+        return -1;
+    }
+
+    //only published once it's on disk, so no thread hands out a number past what a restart would skip
+    atomic_store(&sequence->limit, limit);
+    return 0;
+}
+
+int generate_order_number(order_sequence_t *sequence, order_id_t *orderId) 
+{
+    //each caller takes its own counter value, so concurrent callers never share a number
+    unsigned long long counter = atomic_fetch_add(&sequence->next, 1);
+    int reserved = 1;
+
+    //numbers are reserved on disk a block at a time, so most calls never touch the file or the lock
+    if (counter >= atomic_load(&sequence->limit)) 
+    {
+        pthread_mutex_lock(&sequence->lock);
+
+        //a counter that couldn't be reserved is skipped, never handed out
+        if (counter >= atomic_load(&sequence->limit)) 
+        {
+            reserved = reserve_order_numbers(sequence, counter + ORDER_SEQUENCE_BLOCK) == 0;
+        }
+
+        pthread_mutex_unlock(&sequence->lock);
+    }
+
+    *orderId = ((order_id_t)sequence->node << ORDER_ID_NODE_SHIFT) | counter;
+    return reserved;
+}
+
+void load_order_sequence(order_sequence_t *sequence, const char *filename) 
+{
+    snprintf(sequence->filename, sizeof(sequence->filename), "%s", filename);
+    sequence->node = 1;
+    atomic_store(&sequence->next, 1);
+    atomic_store(&sequence->limit, 1);
+
+    FILE *file = fopen(filename, "r");
+
+    if (file) 
+    {
+        //numbers below the saved limit may have been issued, so start past it
+        unsigned long long limit;
+
+        if (fscanf(file, "%u %llu", &sequence->node, &limit) == 2) 
+        {
+            atomic_store(&sequence->next, limit);
+            atomic_store(&sequence->limit, limit);
+        }
+
+        fclose(file);
+    }
+}
+
+void observe_order_number(order_sequence_t *sequence, order_id_t orderId) 
+{
+    unsigned long long counter = orderId & ((1ull << ORDER_ID_NODE_SHIFT) - 1);
+
+    //older four digit order numbers have node 0 and can't collide
+    if (orderId >> ORDER_ID_NODE_SHIFT == sequence->node && counter >= atomic_load(&sequence->next)) 
+    {
+        atomic_store(&sequence->next, counter + 1);
+    }
+}
+
+//reads the digits at text as a number below limit, returns the first character after them or NULL
+static const char *parse_digits(const char *text, unsigned long long limit, unsigned long long *value) 
+{
+    if (!isdigit((unsigned char)*text)) 
+    {
+        return NULL;
+    }
+
+    *value = 0;
+
+    for (; isdigit((unsigned char)*text); text++) 
+    {
+        *value = *value * 10 + (unsigned long long)(*text - '0');
+
+        if (*value >= limit) 
+        {
+            return NULL;
+        }
+    }
+
+    return text;
+}
+
+int parse_order_number(const char *orderNumber, order_id_t *orderId) 
+{
+    unsigned long long node = 0;
+    unsigned long long counter;
+    const char *end = parse_digits(orderNumber, 1ull << ORDER_ID_NODE_SHIFT, &counter);
+
+    //"<node>-<counter>", or just a number for the older four digit ones
+    if (end != NULL && *end == '-') 
+    {
+        node = counter;
+        end = counter < (1ull << (64 - ORDER_ID_NODE_SHIFT)) ? parse_digits(end + 1, 1ull << ORDER_ID_NODE_SHIFT, &counter) : NULL;
+    }
+
+    if (end == NULL || *end != '\0') 
+    {
+        return 0;
+    }
+
+    *orderId = (node << ORDER_ID_NODE_SHIFT) | counter;
+    return 1;
+}
+
+void format_order_number(order_id_t orderId, char *orderNumber) 
+{
+    unsigned int node = (unsigned int)(orderId >> ORDER_ID_NODE_SHIFT);
+    unsigned long long counter = orderId & ((1ull << ORDER_ID_NODE_SHIFT) - 1);
+
+    if (node == 0) 
+    {
+        snprintf(orderNumber, MAX_ORDER_NUMBER, "%04llu", counter);
+    } else {
+        snprintf(orderNumber, MAX_ORDER_NUMBER, "%u-%08llu", node, counter);
+    }
+}
+
+//reads one line of input without its newline, returns 0 at the end of input
+static int read_line(char *line, size_t size) 
+{
+    if (fgets(line, (int)size, stdin) == NULL) 
+    {
+        return 0;
+    }
+
+    size_t length = strcspn(line, "\n");
+
+    //whatever didn't fit is dropped so it isn't read as the next answer
+    if (line[length] != '\n') 
+    {
+        int c;
+        while ((c = getchar()) != '\n' && c != EOF);
+    }
+
+    line[length] = '\0';
+    return 1;
+}
+
+//asks what a listing should be narrowed down to, orders can be filtered by more than products
+//returns 0 if the filter names a product or category that doesn't exist
+static int prompt_filter(render_filter_t *filter, const catalog_t *catalog, int ordersToo) 
+{
+    char line[MAX_NAME + 2];
+    int choice = 1;
+
+    memset(filter, 0, sizeof(render_filter_t));
+
+    if (ordersToo) 
+    {
+        printf("Show (1) all, (2) one customer, (3) one order number, (4) one product number, (5) one category, (6) placed between dates: ");
+    } else {
+        printf("Show (1) all, (4) one product number, (5) one category: ");
+    }
+
+    if (!read_line(line, sizeof(line))) 
+    {
+        return 0;
+    }
+    sscanf(line, "%d", &choice);
+
+    switch (choice) 
+    {
+        case 2:
+            if (!ordersToo) 
+            {
+                break;
+            }
+            printf("Enter the customer name: ");
+            read_line(filter->text, MAX_NAME);
+            filter->kind = FILTER_CUSTOMER;
+            break;
+        case 3:
+            if (!ordersToo) 
+            {
+                break;
+            }
+            printf("Enter the order number: ");
+            read_line(filter->text, MAX_ORDER_NUMBER);
+            filter->kind = FILTER_ORDER_NUMBER;
+            break;
+        case 4:
+            printf("Enter the product number: ");
+            if (!read_line(line, sizeof(line)) || sscanf(line, "%d", &filter->number) != 1 || !isProductNumberValid(catalog, filter->number)) 
+            {
+                printf("Product number invalid. Product does not exist.\n");
+                return 0;
+            }
+            filter->kind = FILTER_PRODUCT;
+            break;
+        case 5:
+            printf("Enter the category: ");
+            read_line(line, sizeof(line));
+            filter->number = find_category(catalog, line);
+            if (filter->number < 0) 
+            {
+                printf("Category not found.\n");
+                return 0;
+            }
+            filter->kind = FILTER_CATEGORY;
+            break;
+        case 6: 
+        {
+            long firstDay;
+            long lastDay;
+
+            if (!ordersToo) 
+            {
+                break;
+            }
+            printf("Enter the day placed, or the first and last day (YYYY-MM-DD [YYYY-MM-DD]): ");
+            read_line(filter->text, MAX_NAME);
+            if (!parse_date_range(filter->text, &firstDay, &lastDay)) 
+            {
+                printf("Invalid date range.\n");
+                return 0;
+            }
+            filter->kind = FILTER_DATE;
+            break;
+        }
+    }
+
+    return 1;
+}
+
+//renders a listing page by page into one buffer per page, asking before every page after the first
+static void page_through(const order_list_t *orders, const catalog_t *catalog, const render_filter_t *filter,
+                         const char *heading, const char *emptyMessage) 
+{
+    render_buffer_t buffer;
+    render_cursor_t cursor;
+    char line[16];
+
+    render_init(&buffer);
+    memset(&cursor, 0, sizeof(cursor));
+
+    render_printf(&buffer, "\n%s\n", heading);
+
+    //without an order list the products are listed
+    size_t rows = orders == NULL ? render_catalog(&buffer, catalog, filter, &cursor, RENDER_PAGE_SIZE)
+                                 : render_orders(&buffer, orders, catalog, filter, &cursor, RENDER_PAGE_SIZE);
+
+    if (rows == 0) 
+    {
+        buffer.size = 0;
+        render_printf(&buffer, "\n%s\n", emptyMessage);
+    }
+
+    while (1) 
+    {
+        render_flush(&buffer, stdout);
+
+        if (cursor.done) 
+        {
+            break;
+        }
+
+        printf("-- Press Enter for the next page, or q to stop: ");
+
+        if (!read_line(line, sizeof(line)) || line[0] == 'q' || line[0] == 'Q') 
+        {
+            break;
+        }
+
+        if (orders == NULL) 
+        {
+            render_catalog(&buffer, catalog, filter, &cursor, RENDER_PAGE_SIZE);
+        } else {
+            render_orders(&buffer, orders, catalog, filter, &cursor, RENDER_PAGE_SIZE);
+        }
+    }
+
+    printf("\n");
+    render_free(&buffer);
+}
+
+void display_orders(const order_list_t *orders, const catalog_t *catalog) 
+{
+    render_filter_t filter;
+
+    if (prompt_filter(&filter, catalog, 1)) 
+    {
+        page_through(orders, catalog, &filter, "Current Orders:", filter.kind == FILTER_NONE ? "No orders placed yet." : "No matching orders.");
+    }
+}
+
+int isProductNumberValid(const catalog_t *catalog, int productNumber) 
+{
+    return find_product(catalog, productNumber) != NULL;
+}
+
+const product_t *find_product(const catalog_t *catalog, int productNumber) 
+{
+    const product_index_t *index = &catalog->index;
+    const product_t *product = NULL;
+
+    STATS_START(timer);
+
+    if (index->seeds != NULL && index->capacity != 0) 
+    {
+        //one slot per product, a number that isn't in the catalog lands on some other product
+        unsigned int seed = index->seeds[perfect_hash_product(productNumber, 0) % index->seedCount];
+        const product_t *candidate = index->slots[perfect_hash_product(productNumber, seed) % index->capacity];
+
+        if (candidate->productNumber == productNumber) 
+        {
+            product = candidate;
+        }
+    } else if (index->capacity != 0) 
+    {
+        size_t mask = index->capacity - 1;
+        size_t slot = hash_product_number(productNumber, mask);
+
+        //linear probing until the product or an empty slot is found
+        while (index->slots[slot] != NULL) 
+        {
+            if (index->slots[slot]->productNumber == productNumber) 
+            {
+                product = index->slots[slot];
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    STATS_STOP(STATS_FIND_PRODUCT, timer);
+    STATS_ADD(STATS_LOOKUPS, 1);
+    STATS_ADD(STATS_LOOKUP_MISSES, product == NULL);
+
+    return product;
+}
+
+unsigned int perfect_hash_product(int productNumber, unsigned int seed) 
+{
+    //murmur3 finalizer over the number mixed with the seed
+    unsigned int hash = (unsigned int)productNumber ^ (seed * 2654435769u);
+
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+void build_product_index(catalog_t *catalog) 
+{
+    //keep the table at most half full so probe sequences stay short
+    size_t capacity = 16;
+    while (capacity < catalog->count * 2) 
+    {
+        capacity *= 2;
+    }
+
+    const product_t **slots = (const product_t **)calloc(capacity, sizeof(const product_t *));
+
+    if (!slots) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t mask = capacity - 1;
+
+    for (size_t i = 0; i < catalog->count; i++) 
+    {
+        const product_t *product = &catalog->products[i];
+        size_t slot = hash_product_number(product->productNumber, mask);
+
+        //the first product listed with a number wins, same as the old front-to-back scan
+        while (slots[slot] != NULL && slots[slot]->productNumber != product->productNumber) 
+        {
+            slot = (slot + 1) & mask;
+        }
+
+        if (slots[slot] == NULL) 
+        {
+            slots[slot] = product;
+        }
+    }
+
+    free(catalog->index.slots);
+    catalog->index.slots = slots;
+    catalog->index.capacity = capacity;
+    catalog->index.seeds = NULL;
+    catalog->index.seedCount = 0;
+}
+
+//finds the slot of a category name, or the empty slot where it belongs
+static int *category_slot(const catalog_t *catalog, const char *name) 
+{
+    size_t mask = catalog->categorySlotCapacity - 1;
+    size_t slot = hash_name(name, mask);
+
+    while (catalog->categorySlots[slot] != 0 &&
+           strcmp(catalog->categories[catalog->categorySlots[slot] - 1].name, name) != 0) {
+        slot = (slot + 1) & mask;
+    }
+
+    return &catalog->categorySlots[slot];
+}
+
+int intern_category(catalog_t *catalog, const char *name) 
+{
+    if (catalog->categorySlotCapacity != 0) 
+    {
+        int *slot = category_slot(catalog, name);
+
+        if (*slot != 0) 
+        {
+            return *slot - 1;
+        }
+    }
+
+    if (catalog->categoryCount == catalog->categoryCapacity) 
+    {
+        size_t capacity = catalog->categoryCapacity == 0 ? 16 : catalog->categoryCapacity * 2;
+        category_t *categories = (category_t *)realloc(catalog->categories, capacity * sizeof(category_t));
+
+        if (!categories) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        catalog->categories = categories;
+        catalog->categoryCapacity = capacity;
+    }
+
+    //keep the name table at most half full, rehashing every name when it doubles
+    if ((catalog->categoryCount + 1) * 2 > catalog->categorySlotCapacity) 
+    {
+        size_t capacity = catalog->categorySlotCapacity == 0 ? 32 : catalog->categorySlotCapacity * 2;
+        int *slots = (int *)calloc(capacity, sizeof(int));
+
+        if (!slots) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        free(catalog->categorySlots);
+        catalog->categorySlots = slots;
+        catalog->categorySlotCapacity = capacity;
+
+        for (size_t i = 0; i < catalog->categoryCount; i++) 
+        {
+            *category_slot(catalog, catalog->categories[i].name) = (int)i + 1;
+        }
+    }
+
+    int categoryId = (int)catalog->categoryCount++;
+    category_t *category = &catalog->categories[categoryId];
+
+    snprintf(category->name, MAX_PRODUCT_NAME, "%s", name);
+    category->first = 0;
+    category->count = 0;
+    *category_slot(catalog, category->name) = categoryId + 1;
+
+    return categoryId;
+}
+
+int find_category(const catalog_t *catalog, const char *name) 
+{
+    int categoryId = -1;
+
+    STATS_START(timer);
+
+    if (catalog->categorySlotCapacity != 0) 
+    {
+        categoryId = *category_slot(catalog, name) - 1;
+    }
+
+    STATS_STOP(STATS_FIND_CATEGORY, timer);
+    STATS_ADD(STATS_LOOKUPS, 1);
+    STATS_ADD(STATS_LOOKUP_MISSES, categoryId < 0);
+
+    return categoryId;
+}
+
+const char *category_name(const catalog_t *catalog, int categoryId) 
+{
+    if (categoryId < 0 || (size_t)categoryId >= catalog->categoryCount) 
+    {
+        return "";
+    }
+
+    return catalog->categories[categoryId].name;
+}
+
+const product_t *products_in_category(const catalog_t *catalog, int categoryId, size_t *count) 
+{
+    *count = count_products_in_category(catalog, categoryId);
+
+    if (*count == 0) 
+    {
+        return NULL;
+    }
+
+    return &catalog->products[catalog->categories[categoryId].first];
+}
+
+size_t count_products_in_category(const catalog_t *catalog, int categoryId) 
+{
+    if (categoryId < 0 || (size_t)categoryId >= catalog->categoryCount) 
+    {
+        return 0;
+    }
+
+    return catalog->categories[categoryId].count;
+}
+
+void build_category_index(catalog_t *catalog) 
+{
+    for (size_t c = 0; c < catalog->categoryCount; c++) 
+    {
+        catalog->categories[c].count = 0;
+    }
+
+    //count the products of each category and check whether they already sit together in ID order
+    int grouped = 1;
+
+    for (size_t i = 0; i < catalog->count; i++) 
+    {
+        catalog->categories[catalog->products[i].categoryId].count++;
+
+        if (i > 0 && catalog->products[i].categoryId < catalog->products[i - 1].categoryId) 
+        {
+            grouped = 0;
+        }
+    }
+
+    //each category's run starts where the previous one ends
+    size_t first = 0;
+
+    for (size_t c = 0; c < catalog->categoryCount; c++) 
+    {
+        catalog->categories[c].first = first;
+        first += catalog->categories[c].count;
+    }
+
+    //a category that shows up in more than one place is pulled together with a counting sort
+    if (!grouped) 
+    {
+        product_t *sorted = (product_t *)malloc(catalog->capacity * sizeof(product_t));
+
+        if (!sorted) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        size_t *next = (size_t *)malloc(catalog->categoryCount * sizeof(size_t));
+
+        if (!next) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        for (size_t c = 0; c < catalog->categoryCount; c++) 
+        {
+            next[c] = catalog->categories[c].first;
+        }
+
+        for (size_t i = 0; i < catalog->count; i++) 
+        {
+            sorted[next[catalog->products[i].categoryId]++] = catalog->products[i];
+        }
+
+        free(next);
+        free(catalog->products);
+        catalog->products = sorted;
+    }
+}
+
+void process_return(order_list_t *orders) 
+{
+    char orderNumber[MAX_ORDER_NUMBER];
+    char line[32];
+    int productNumber = 0;
+    int quantity = 0;
+
+    printf("Enter the order number for the return: ");
+    read_line(orderNumber, sizeof(orderNumber));
+
+    //a product number returns part of the order, 0 (or nothing) returns all of it
+    printf("Enter the product number to return (0 for the whole order): ");
+
+    if (read_line(line, sizeof(line)) && sscanf(line, "%d", &productNumber) == 1 && productNumber != 0) 
+    {
+        printf("Enter the quantity to return: ");
+
+        if (!read_line(line, sizeof(line)) || sscanf(line, "%d", &quantity) != 1 || quantity <= 0) 
+        {
+            printf("Invalid quantity. Return cannot be processed.\n");
+            return;
+        }
+
+        if (return_line_item(orders, orderNumber, productNumber, quantity)) 
+        {
+            printf("Return of %d processed successfully.\n", quantity);
+        } else {
+            printf("Order number or product not found, or fewer than %d left to return. Return cannot be processed.\n", quantity);
+        }
+
+        return;
+    }
+
+    if (return_order(orders, orderNumber) > 0) 
+    {
+        printf("Return processed successfully.\n");
+    } else {
+        //if no matching order is found
+
+        printf("Order number not found. Return cannot be processed.\n");
+    }
+}
+
+//puts the units of a sealed order's return back in stock
+static void restock_sealed_return(void *context, const order_t *entry, int isReturnEntry) 
+{
+    (void)isReturnEntry;
+    restock(((order_list_t *)context)->inventory, entry->productNumber, entry->quantity);
+}
+
+size_t return_order(order_list_t *orders, const char *orderNumber) 
+{
+    size_t returned = 0;
+    order_id_t orderId;
+
+    if (!parse_order_number(orderNumber, &orderId)) 
+    {
+        return 0;
+    }
+
+    order_shard_t *shard = order_shard(orders, orderId);
+
+    STATS_START(timer);
+
+    pthread_mutex_lock(&shard->lock);
+
+    //only the line items of this order are touched
+    const order_entry_t *entry = shard_find_order(shard, orderId);
+
+    for (size_t i = 0; entry != NULL && i < entry->count; i++) 
+    {
+        order_t *order = entry->items[i];
+
+        if (!order->isReturn) 
+        {
+            //whatever is left of the line item comes back, and goes back in stock
+            restock(orders->inventory, order->productNumber, order->quantity - order->returnedQuantity);
+            return_units(shard, order, order->quantity - order->returnedQuantity);
+            returned++;
+        }
+    }
+
+    if (returned > 0) 
+    {
+        journal_return(orders, orderId, 0, 0);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    //an order that isn't in memory may have been sealed, its day is written again with the return in it
+    if (entry == NULL && orders->archive != NULL) 
+    {
+        returned = archive_return(orders->archive, orderNumber, 0, 0, restock_sealed_return, orders);
+    }
+
+    STATS_STOP(STATS_PROCESS_RETURN, timer);
+
+    return returned;
+}
+
+int return_line_item(order_list_t *orders, const char *orderNumber, int productNumber, int quantity) 
+{
+    order_id_t orderId;
+    int returned = 0;
+
+    if (!parse_order_number(orderNumber, &orderId)) 
+    {
+        return 0;
+    }
+
+    order_shard_t *shard = order_shard(orders, orderId);
+
+    STATS_START(timer);
+
+    pthread_mutex_lock(&shard->lock);
+
+    const order_entry_t *entry = shard_find_order(shard, orderId);
+
+    //the order has at most one line item per product with units left, merging sees to that
+    for (size_t i = 0; entry != NULL && i < entry->count; i++) 
+    {
+        order_t *order = entry->items[i];
+
+        if (order->productNumber == productNumber && !order->isReturn) 
+        {
+            if (quantity > 0 && quantity <= order->quantity - order->returnedQuantity) 
+            {
+                restock(orders->inventory, productNumber, quantity);
+                return_units(shard, order, quantity);
+                journal_return(orders, orderId, productNumber, quantity);
+                returned = 1;
+            }
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    if (entry == NULL && orders->archive != NULL) 
+    {
+        returned = (int)archive_return(orders->archive, orderNumber, productNumber, quantity, restock_sealed_return, orders);
+    }
+
+    STATS_STOP(STATS_PROCESS_RETURN, timer);
+
+    return returned;
+}
+
+void add_return_entry(order_list_t *orders, const order_t *entry) 
+{
+    order_shard_t *shard = order_shard(orders, entry->orderId);
+
+    pthread_mutex_lock(&shard->lock);
+    store_return_entry(shard, entry);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+long long returned_units(const order_list_t *orders, const char *orderNumber, int productNumber) 
+{
+    order_id_t orderId;
+    long long units = 0;
+
+    if (!parse_order_number(orderNumber, &orderId)) 
+    {
+        return 0;
+    }
+
+    order_shard_t *shard = order_shard(orders, orderId);
+
+    pthread_mutex_lock(&shard->lock);
+
+    const order_entry_t *entry = shard_find_order_returns(shard, orderId);
+
+    for (size_t i = 0; entry != NULL && i < entry->count; i++) 
+    {
+        if (entry->items[i]->productNumber == productNumber) 
+        {
+            units += entry->items[i]->quantity;
+        }
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return units;
+}
+
+long long returned_units_of_product(const order_list_t *orders, int productNumber) 
+{
+    long long units = 0;
+
+    for (size_t s = 0; s < ORDER_SHARDS; s++) 
+    {
+        order_shard_t *shard = (order_shard_t *)&orders->shards[s];
+
+        pthread_mutex_lock(&shard->lock);
+
+        const product_orders_t *entry = shard_find_product_returns(shard, productNumber);
+
+        for (size_t i = 0; entry != NULL && i < entry->count; i++) 
+        {
+            units += entry->items[i]->quantity;
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return units;
+}
+
+void display_returns(const order_list_t *orders, const catalog_t *catalog) 
+{
+    render_filter_t filter;
+
+    if (prompt_filter(&filter, catalog, 1)) 
+    {
+        filter.returned = 1;
+        page_through(orders, catalog, &filter, "Returns:", filter.kind == FILTER_NONE ? "No returns processed yet." : "No matching returns.");
+    }
+}
+
+
+void quit_program() 
+{
+    printf("\nThank you for using our Furniture Catalog System!\n");
+}
+
+void display_catalog(const catalog_t *catalog) 
+{
+    render_filter_t filter;
+
+    if (prompt_filter(&filter, catalog, 0)) 
+    {
+        page_through(NULL, catalog, &filter, "Furniture Catalog:", "No products in the catalog.");
+    }
+}
+
+void free_catalog(catalog_t *catalog) 
+{
+    //a generated catalog is static data, there is nothing to free
+    if (catalog->generated) 
+    {
+        return;
+    }
+
+    //free allocated memory for the catalog
+    free(catalog->products);
+    free(catalog->index.slots);
+    free(catalog->categories);
+    free(catalog->categorySlots);
+    free(catalog->names.byName);
+    free(catalog->names.gramKeys);
+    free(catalog->names.gramStarts);
+    free(catalog->names.postings);
+    free(catalog);
+}
+
+void free_orders(order_list_t *orders) 
+{
+    //free allocated memory for the orders, every chunk (current and the returns ledger) goes with its shard's arena
+    for (size_t i = 0; i < ORDER_SHARDS; i++) 
+    {
+        free_order_index(&orders->shards[i].byNumber);
+        free_order_index(&orders->shards[i].byCustomer);
+        free(orders->shards[i].byProduct.slots);
+        free_order_index(&orders->shards[i].returns.byNumber);
+        free_order_index(&orders->shards[i].returns.byCustomer);
+        free(orders->shards[i].returns.byProduct.slots);
+        free(orders->shards[i].columns.blocks);
+        arena_free_all(&orders->shards[i].arena);
+        pthread_mutex_destroy(&orders->shards[i].lock);
+    }
+
+    pthread_mutex_destroy(&orders->sequence.lock);
+
+    free_inventory(orders->inventory);
+
+    //the names and their blocks go with the pool's arena
+    free(orders->customers.slots);
+    arena_free_all(&orders->customers.arena);
+    pthread_mutex_destroy(&orders->customers.lock);
+
+    free(orders);
+}
+
+void load_catalog_from_file(catalog_t *catalog, const char *filename) 
+{
+    STATS_START(timer);
+
+    //the file is mapped and parsed in category-aligned chunks on one thread per core
+    long long added = load_catalog_parallel(catalog, filename, 0);
+
+    STATS_STOP(STATS_LOAD_CATALOG, timer);
+    STATS_ADD(STATS_RECORDS_PARSED, added > 0 ? (unsigned long long)added : 0);
+    (void)added;
+}
+
+//writes one line item in the 'customer_information.txt' layout with the given quantity
+static void write_line_item(FILE *file, const order_list_t *orders, const order_t *order, int quantity) 
+{
+    char orderNumber[MAX_ORDER_NUMBER];
+    format_order_number(order->orderId, orderNumber);
+
+    //print customer information on its own line, then the order number without newline
+    fprintf(file, "%s\n order no. %s", customer_name(&orders->customers, order->customerId), orderNumber);
+
+    //print product details for the current order, and when it was placed if that's known
+    fprintf(file, " | Product No. %d | Quantity: %d |", order->productNumber, quantity);
+
+    if (order->placedAt != 0) 
+    {
+        char placed[MAX_TIMESTAMP];
+        format_timestamp(order->placedAt, placed);
+        fprintf(file, " Placed: %s |", placed);
+    }
+
+    fprintf(file, "\n");
+}
+
+//where the records of the sealed days are written as they're read
+typedef struct {
+    FILE *file;
+    const order_list_t *orders;
+} sealed_writer_t;
+
+//writes a sealed line item the way save_customer_information writes one in memory
+static void write_sealed_line_item(void *context, const order_t *order, int isReturnEntry) 
+{
+    sealed_writer_t *writer = (sealed_writer_t *)context;
+
+    if (!isReturnEntry && !order->isReturn) 
+    {
+        write_line_item(writer->file, writer->orders, order, order->quantity - order->returnedQuantity);
+    }
+}
+
+//writes a sealed returns ledger entry the way save_customer_returns writes one in memory
+static void write_sealed_return(void *context, const order_t *order, int isReturnEntry) 
+{
+    sealed_writer_t *writer = (sealed_writer_t *)context;
+
+    if (isReturnEntry) 
+    {
+        write_line_item(writer->file, writer->orders, order, order->quantity);
+    }
+}
+
+void save_customer_information(const order_list_t *orders, const char *filename) 
+{
+    STATS_START(timer);
+
+    FILE *file = fopen(filename, "w");
+
+    if (!file) //if file isn't opening or hasn't opened yet
+    {
+        printf("Error opening file: %s\n", filename);
+        return;
+    }
+
+    //the sealed days come first, their names are interned into the pool as they're read
+    sealed_writer_t writer = { file, orders };
+
+    if (orders->archive != NULL) 
+    {
+        scan_archive(orders->archive, (order_list_t *)orders, write_sealed_line_item, &writer);
+    }
+
+    for (size_t s = 0; s < ORDER_SHARDS; s++) 
+    {
+        for (const order_chunk_t *chunk = orders->shards[s].current.head; chunk != NULL; chunk = chunk->next) 
+        {
+            for (size_t i = 0; i < chunk->count; i++) 
+            {
+                const order_t *currentOrder = &chunk->orders[i];
+
+                //returned line items are not saved, partly returned ones only with what was kept
+                if (currentOrder->isReturn) 
+                {
+                    continue;
+                }
+
+                write_line_item(file, orders, currentOrder, currentOrder->quantity - currentOrder->returnedQuantity);
+            }
+        }
+    }
+
+    fclose(file);
+
+    STATS_STOP(STATS_SAVE_CUSTOMERS, timer);
+}
+
+void save_customer_returns(const order_list_t *orders, const char *filename) 
+{
+    FILE *file = fopen(filename, "w");
+
+    if (!file) 
+    {
+        printf("Error opening file: %s\n", filename);
+        return;
+    }
+
+    sealed_writer_t writer = { file, orders };
+
+    if (orders->archive != NULL) 
+    {
+        scan_archive(orders->archive, (order_list_t *)orders, write_sealed_return, &writer);
+    }
+
+    for (size_t s = 0; s < ORDER_SHARDS; s++) 
+    {
+        for (const order_chunk_t *chunk = orders->shards[s].returns.entries.head; chunk != NULL; chunk = chunk->next) 
+        {
+            for (size_t i = 0; i < chunk->count; i++) 
+            {
+                write_line_item(file, orders, &chunk->orders[i], chunk->orders[i].quantity);
+            }
+        }
+    }
+
+    fclose(file);
+}
+
+//reads every line item of a 'customer_information.txt' style file and hands each one to add, returns how many were read
+static size_t read_line_items(FILE *file, order_list_t *orders, int isReturn, void (*add)(order_list_t *, const order_t *)) 
+{
+    char line[MAX_NAME];
+    char orderNumber[MAX_ORDER_NUMBER];
+    char placed[MAX_TIMESTAMP];
+    size_t read = 0;
+
+    //reads customer information and order number from the file
+    while (fscanf(file, " %49[^\n] order no. %23s", line, orderNumber) == 2) 
+    {
+        //build a line item for each customer and order number
+        order_t newOrder;
+
+        //a line that doesn't carry an order number still has its product lines read below, they're just not kept
+        int valid = parse_order_number(orderNumber, &newOrder.orderId);
+
+        if (valid) 
+        {
+            newOrder.customerId = intern_customer(&orders->customers, line);
+
+            //never hand out a number that's already on file
+            observe_order_number(&orders->sequence, newOrder.orderId);
+        } else {
+            printf("Invalid order number %s in file, skipped\n", orderNumber);
+        }
+
+        //initialize isReturn to 0 for each new order (1 for each return)
+        newOrder.isReturn = isReturn;
+        newOrder.returnedQuantity = 0;
+
+        //consume the newline character after reading customer information
+        fgetc(file);
+
+        //read product numbers and quantities for the current order
+        while (fscanf(file, "| Product No. %d | Quantity: %d |",
+                      &newOrder.productNumber, &newOrder.quantity) == 2) {
+            //files written before orders were timestamped end the line here
+            newOrder.placedAt = 0;
+
+            if (fgetc(file) == ' ' && fscanf(file, "Placed: %19[^|]|", placed) == 1) 
+            {
+                if (!parse_timestamp(placed, &newOrder.placedAt)) 
+                {
+                    newOrder.placedAt = 0;
+                }
+
+                //consume the newline character after the placement time
+                fgetc(file);
+            }
+
+            //adds the line item to the end of the orders list (or the returns ledger)
+            if (valid) 
+            {
+                add(orders, &newOrder);
+                read++;
+            }
+        }
+    }
+
+    return read;
+}
+
+void load_customer_information(order_list_t *orders, const char *filename) 
+{
+    STATS_START(timer);
+
+    //open the file for reading
+    FILE *file = fopen(filename, "r");
+
+    //check if the file is opened successfully
+    if (!file) {
+        printf("Error opening file: %s\n", filename);
+        return;
+    }
+
+    size_t loaded = read_line_items(file, orders, 0, add_line_item);
+
+    //close the file
+    fclose(file);
+
+    STATS_STOP(STATS_LOAD_CUSTOMERS, timer);
+    STATS_ADD(STATS_RECORDS_PARSED, loaded);
+
+    //one summary line instead of a line per record keeps startup off the console
+    printf("Loaded %zu line items from %s\n", loaded, filename);
+}
+
+void load_customer_returns(order_list_t *orders, const char *filename) 
+{
+    FILE *file = fopen(filename, "r");
+
+    //files saved before the ledger existed come without one
+    if (!file) 
+    {
+        return;
+    }
+
+    size_t loaded = read_line_items(file, orders, 1, add_return_entry);
+
+    fclose(file);
+
+    STATS_ADD(STATS_RECORDS_PARSED, loaded);
+
+    printf("Loaded %zu returns from %s\n", loaded, filename);
 }
\ No newline at end of file
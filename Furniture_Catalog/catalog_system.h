@@ -1,89 +1,413 @@
-#ifndef CATALOG_SYSTEM_H
-#define CATALOG_SYSTEM_H
-
-#define MAX_NAME 50
-#define MAX_PRODUCT_NAME 50
-#define MAX_ORDER_NUMBER 10
-
-//struct to represent a product's name and product number
-typedef struct {
-    char name[MAX_NAME];
-    int productNumber;
-    char category[MAX_PRODUCT_NAME];
-} product_t;
-
-//node structure for the linked list for all products in the catalog
-typedef struct product_node {
-    product_t product;
-    struct product_node* next; //moves to next in list
-} product_node_t;
-
-//struct to represent the catalog
-typedef struct {
-    product_node_t* head;
-} catalog_t;
-
-/*struct for creating orders: customer name, product number(s),
-quantity of product, and to check if it's a returned order*/
-typedef struct {
-    char customerName[MAX_NAME];
-    int productNumber;
-    int quantity;
-    char orderNumber[MAX_ORDER_NUMBER];
-    int isReturn;  //indicator for return
-} order_t;
-
-//node for the linked list of orders
-typedef struct order_node {
-    order_t order;
-    struct order_node* next;
-} order_node_t;
-
-//struct to represent a list of orders
-typedef struct {
-    order_node_t* head;    //linked list of current orders
-    order_node_t* returns; //linked list of returned orders
-} order_list_t;
-
-//function declarations
-
-//display the products in the catalog txt file
-void display_catalog(const catalog_t *catalog);
-
-//placing new order in the system from customer input
-void place_order(order_list_t *orders, const catalog_t *catalog);
-
-//generate a randomized, unique order number for customer after order is executed
-void generate_order_number(char *orderNumber);
-
-//displays all of the current orders in the system
-void display_orders(const order_list_t *orders);
-
-//checks if a given product number is valid from the catalog txt file
-int isProductNumberValid(const catalog_t *catalog, int productNumber);
-
-//processes a return for a given order number
-void process_return(order_list_t *orders);
-
-//displays all of the current returns processed in the system
-void display_returns(order_list_t *orders);
-
-//quit the program
-void quit_program();
-
-//frees the memory allocated for the catalog
-void free_catalog(catalog_t *catalog);
-
-//frees the memory allocated for the orders
-void free_orders(order_list_t *orders);
-
-//loads product information from a file into the catalog
-void load_catalog_from_file(catalog_t *catalog, const char *filename);
-
-//saves customer order information to a file ('customer_information.txt')
-void save_customer_information(const order_list_t *orders, const char *filename);
-
-//load customer order information from 'customer_information.txt' file
-void load_customer_information(order_list_t *orders, const char *filename);
-
+#ifndef CATALOG_SYSTEM_H
+#define CATALOG_SYSTEM_H
+
+#define MAX_NAME 50
+#define MAX_PRODUCT_NAME 50
+#define MAX_ORDER_NUMBER 24 //"<shard>-<64-bit counter>" plus the terminator
+#define ORDER_SEQUENCE_BLOCK 100000 //order numbers reserved per write of the sequence file
+#define CATALOG_FILE "furniture_catalog.txt"
+#define CUSTOMER_FILE "customer_information.txt"
+#define CUSTOMER_SNAPSHOT_FILE "customer_information.bin"
+#define CUSTOMER_JOURNAL_FILE "customer_information.journal"
+#define CUSTOMER_RETURNS_FILE "customer_returns.txt"
+#define ORDER_CHUNK_SIZE 256 //line items stored per order chunk
+#define ORDER_SHARDS 16 //independently locked partitions of the order store
+#define ORDER_COLUMN_BLOCK 4096 //line items per block of the order columns
+#define ORDER_ID_NODE_SHIFT 48 //an order ID is the node above this bit and the counter below it
+#define CUSTOMER_POOL_BLOCK 4096  //customer names per block of the customer pool
+#define CUSTOMER_POOL_BLOCKS 4096 //blocks the customer pool can hold, CUSTOMER_POOL_BLOCK names each
+
+//why commit_order_draft stored nothing
+#define ORDER_DRAFT_PLACED 0       //it didn't fail
+#define ORDER_DRAFT_OUT_OF_STOCK 1 //failedProduct is short of stock
+#define ORDER_DRAFT_BAD_QUANTITY 2 //failedProduct's quantity isn't positive
+#define ORDER_DRAFT_NO_NUMBER 3    //no order number could be reserved on disk
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "arena.h"
+
+//struct to represent a product's name and product number
+typedef struct {
+    char name[MAX_NAME];
+    int productNumber;
+    int categoryId; //index into the catalog's categories
+} product_t;
+
+//a category interned at load time, its products sit at products[first .. first + count)
+typedef struct {
+    char name[MAX_PRODUCT_NAME];
+    size_t first;
+    size_t count;
+} category_t;
+
+//open-addressing hash table from product number to its product in the catalog
+//a generated catalog uses a minimal perfect hash instead: one slot per product and no probing
+typedef struct {
+    const product_t **slots;    //NULL marks an empty slot
+    size_t capacity;            //always a power of two (0 until the index is built), the product count with seeds
+    const unsigned int *seeds;  //per-bucket seeds of the perfect hash (NULL for open addressing)
+    size_t seedCount;
+} product_index_t;
+
+//name search over the products, see search.h
+typedef struct {
+    unsigned int *byName;    //product positions sorted by name, ignoring case
+    unsigned int *gramKeys;  //every distinct trigram of the lowercased names, ascending
+    size_t *gramStarts;      //the products with gramKeys[g] are postings[gramStarts[g] .. gramStarts[g + 1])
+    unsigned int *postings;  //product positions, ascending within each trigram
+    size_t gramCount;
+} name_index_t;
+
+//struct to represent the catalog, products are grouped by category and kept in file order within one
+typedef struct {
+    product_t *products;
+    size_t count;
+    size_t capacity;       //grows by doubling so appends are amortized O(1)
+    product_index_t index; //built once by load_catalog_from_file
+    category_t *categories;      //indexed by category ID, in order of first appearance
+    size_t categoryCount;
+    size_t categoryCapacity;
+    int *categorySlots;          //open-addressing table of category ID + 1 by name (0 marks an empty slot)
+    size_t categorySlotCapacity; //always a power of two (0 until the first category is interned)
+    name_index_t names;          //built once by load_catalog_from_file
+    int generated;               //1 when every array is compiled in by catalog_codegen, free_catalog leaves it alone
+} catalog_t;
+
+//an order number as an integer: "<node>-<counter>" is (node << ORDER_ID_NODE_SHIFT) | counter
+//older four digit order numbers have node 0
+typedef unsigned long long order_id_t;
+
+/*struct for creating orders: order number, customer, product number(s),
+quantity of product, and to check if it's a returned order*/
+typedef struct {
+    order_id_t orderId;
+    unsigned int customerId; //the customer's name in the order list's customer pool
+    int productNumber;
+    int quantity;
+    int returnedQuantity; //units returned so far, a partly returned line item keeps the rest
+    unsigned int placedAt; //when the order was placed, seconds since 1970-01-01 UTC (0 if it isn't known)
+    unsigned int column : 31; //position of the line item in its shard's order columns
+    unsigned int isReturn : 1; //indicator for return, set once every unit of the line item has been returned
+} order_t;
+
+//fixed-size block of line items, chunks never move so pointers to their orders stay valid
+typedef struct order_chunk {
+    order_t orders[ORDER_CHUNK_SIZE];
+    size_t count;
+    struct order_chunk *next;
+} order_chunk_t;
+
+//append-only store of line items, the tail pointer makes appends O(1)
+typedef struct {
+    order_chunk_t *head;
+    order_chunk_t *tail;
+    size_t count;
+    arena_t *arena; //where new chunks are carved from
+} order_store_t;
+
+//every line item that shares one key, an order ID or a customer ID
+typedef struct {
+    unsigned long long key;
+    order_t **items; //points into the order store in the order the items were stored, carved from the arena
+    size_t count;    //0 marks an unused slot
+    size_t capacity;
+} order_entry_t;
+
+//open-addressing hash table from a key to its line items
+typedef struct {
+    order_entry_t *slots;
+    size_t capacity; //always a power of two (0 until the first order is indexed)
+    size_t count;    //number of distinct keys
+} order_index_t;
+
+//every line item of one product
+typedef struct {
+    int productNumber;
+    order_t **items; //points into the order store in the order the items were stored, carved from the arena
+    size_t count;    //0 marks an unused slot
+    size_t capacity;
+} product_orders_t;
+
+//open-addressing hash table from product number to the line items that ordered it
+typedef struct {
+    product_orders_t *slots;
+    size_t capacity; //always a power of two (0 until the first order is indexed)
+    size_t count;    //number of distinct products
+} product_orders_index_t;
+
+//one block of the order columns, parallel arrays that reports can scan without touching the line items
+typedef struct {
+    int productNumber[ORDER_COLUMN_BLOCK];
+    int quantity[ORDER_COLUMN_BLOCK];
+    int categoryId[ORDER_COLUMN_BLOCK];          //-1 when the product isn't in the catalog
+    unsigned int customerId[ORDER_COLUMN_BLOCK]; //ID in the order list's customer pool
+    int returnedQuantity[ORDER_COLUMN_BLOCK];    //units of quantity returned so far
+} order_column_block_t;
+
+//the line items of a shard's current store in columns, kept in step with every change to them
+typedef struct {
+    order_column_block_t **blocks; //carved from the shard's arena, the directory itself grows by doubling
+    size_t blockCount;
+    size_t blockCapacity;
+    size_t count;                  //line items in the columns
+} order_columns_t;
+
+//issues unique order numbers: a node prefix plus a 64-bit counter that only moves forward
+typedef struct {
+    unsigned int node;                      //keeps numbers from different nodes apart
+    _Atomic unsigned long long next;        //next counter value to hand out
+    _Atomic unsigned long long limit;       //first counter value not yet reserved on disk
+    pthread_mutex_t lock;                   //serializes writes of the sequence file
+    char filename[FILENAME_MAX];            //where the reservation is persisted (empty to keep it in memory)
+} order_sequence_t;
+
+/*every return processed in a shard: one entry per return of a line item, a copy of the line item whose quantity
+is the units that came back, so several partial returns of one line item are several entries*/
+typedef struct {
+    order_store_t entries;              //in the order the returns were processed
+    order_index_t byNumber;             //order ID -> its entries
+    order_index_t byCustomer;           //customer ID -> their entries
+    product_orders_index_t byProduct;   //product number -> its entries
+} returns_ledger_t;
+
+//one partition of the order store, every line item of an order lives in the shard its order number hashes to
+typedef struct {
+    pthread_mutex_t lock;   //guards everything below
+    order_store_t current;  //every line item placed, fully returned ones are flagged with isReturn
+    returns_ledger_t returns; //every return of the shard's line items
+    order_index_t byNumber; //order ID -> line items in current
+    order_index_t byCustomer; //customer ID -> line items in current
+    product_orders_index_t byProduct; //product number -> line items in current
+    order_columns_t columns;  //current again, as columns for reporting
+    arena_t arena;          //owns every chunk and item list above, released in bulk by free_orders
+} order_shard_t;
+
+//an order that is still being built, line items for the same product are merged before anything is stored
+typedef struct {
+    char customerName[MAX_NAME];
+    order_t *items;      //line items in the order their products were first added
+    size_t count;
+    size_t capacity;
+    int *slots;          //open-addressing table of item index + 1 by product number (0 marks an empty slot)
+    size_t slotCapacity; //always a power of two (0 until the first item is added)
+    int failure;         //why the draft wasn't stored when it was last committed, an ORDER_DRAFT_ value
+    int failedProduct;   //product the failure is about, 0 if none
+} order_draft_t;
+
+/*every customer name once, line items refer to their customer by ID
+IDs are handed out in order from 0 and a name never moves once it has one, so reading a name by ID
+never takes the lock*/
+typedef struct {
+    pthread_mutex_t lock;                      //serializes interning and guards the slots
+    const char **blocks[CUSTOMER_POOL_BLOCKS]; //ID -> name, CUSTOMER_POOL_BLOCK IDs per block
+    _Atomic unsigned int count;                //IDs handed out so far
+    unsigned int *slots;                       //open-addressing table of ID + 1 by name (0 marks an empty slot)
+    size_t slotCapacity;                       //always a power of two (0 until the first name is interned)
+    arena_t arena;                             //owns the names and the blocks
+} customer_pool_t;
+
+struct journal; //see journal.h
+struct live_catalog; //see live_catalog.h
+struct inventory; //see inventory.h
+struct archive; //see archive.h
+
+//struct to represent a list of orders, safe to place orders and returns into from many threads
+typedef struct {
+    order_shard_t shards[ORDER_SHARDS];
+    order_sequence_t sequence;          //source of new order numbers
+    customer_pool_t customers;          //every customer name the line items refer to
+    unsigned long long journalSequence; //last journal record reflected in these orders (the journal writer's once it runs)
+    struct journal *journal;            //where changes are logged as they happen (NULL for none)
+    const catalog_t *catalog;           //where new line items get their category IDs (NULL leaves them -1)
+    struct live_catalog *liveCatalog;   //takes the place of catalog when set, so reloads are followed
+    struct inventory *inventory;        //stock new line items reserve and returns give back (NULL for none), freed with the list
+    struct archive *archive;            //days of orders sealed out of memory (NULL for none), not owned
+} order_list_t;
+
+//function declarations
+
+//allocates an empty catalog
+catalog_t *create_catalog(void);
+
+//allocates an empty order list
+order_list_t *create_orders(void);
+
+//appends a copy of a line item to a store and returns the stored copy
+order_t *append_order(order_store_t *store, const order_t *order);
+
+/*removes every line item and return placed before cutoff (seconds since 1970-01-01 UTC), keeping the rest in
+their order, returns how many line items went. Ones without a placement time stay. The caller holds every
+shard lock*/
+size_t drop_orders_placed_before(order_list_t *orders, unsigned int cutoff);
+
+//returns the shard that holds (or will hold) an order
+order_shard_t *order_shard(const order_list_t *orders, order_id_t orderId);
+
+//adds a line item as it is without journaling it or adding to the returns ledger, used by the loaders
+void add_line_item(order_list_t *orders, const order_t *order);
+
+//adds quantity of a product to an order, merging with its line item for that product, and journals it
+//returns 1 if a new line item was created and 0 if an existing one was updated
+int add_order_quantity(order_list_t *orders, const order_t *order);
+
+//checks a customer name before an order is taken for it: not empty, shorter than MAX_NAME and free of
+//control characters, since a line break would let the name forge line items in the text files
+int is_valid_customer_name(const char *name);
+
+//starts an empty draft for a customer
+void init_order_draft(order_draft_t *draft, const char *customerName);
+
+//adds quantity of a product to a draft in O(1), returns 1 if it's a new line item and 0 if it was merged
+//-1 (adding nothing) if the merged quantity wouldn't fit in an int, the order should be turned away then
+int add_to_order_draft(order_draft_t *draft, int productNumber, int quantity);
+
+//reserves the stock of every line item of a draft, gives it an order number and stores and journals the line
+//items under one shard lock. The draft is left empty (same customer) so it can be reused, returns how many line
+//items were stored. If a quantity isn't positive, a product is short of stock or no order number can be reserved
+//nothing is reserved or stored and no number is given out: 0 is returned, orderNumber is left empty and the draft keeps its items, with failure
+//saying why and failedProduct naming the product
+size_t commit_order_draft(order_list_t *orders, order_draft_t *draft, char *orderNumber);
+
+//frees the memory allocated for a draft
+void free_order_draft(order_draft_t *draft);
+
+//copies up to maxItems line items of an order number into items, from memory in O(1) or else from the day it was
+//sealed into, returns how many line items the order has (0 if it doesn't exist). Customer IDs are the pool's
+size_t find_order(order_list_t *orders, const char *orderNumber, order_t *items, size_t maxItems);
+
+//looks up a shard's line items for an order, a customer or a product in O(1), NULL if there are none
+//the caller holds the shard lock
+const order_entry_t *shard_find_order(const order_shard_t *shard, order_id_t orderId);
+const order_entry_t *shard_find_customer(const order_shard_t *shard, unsigned int customerId);
+const product_orders_t *shard_find_product(const order_shard_t *shard, int productNumber);
+
+//the same three lookups over a shard's returns ledger, the caller holds the shard lock
+const order_entry_t *shard_find_order_returns(const order_shard_t *shard, order_id_t orderId);
+const order_entry_t *shard_find_customer_returns(const order_shard_t *shard, unsigned int customerId);
+const product_orders_t *shard_find_product_returns(const order_shard_t *shard, int productNumber);
+
+//returns the ID of a customer name, adding it to the pool if it's new
+unsigned int intern_customer(customer_pool_t *pool, const char *customerName);
+
+//looks up a customer by name in O(1), returns -1 if no line item has ever named them
+int find_customer(const customer_pool_t *pool, const char *customerName);
+
+//returns the name of a customer ID ("" for an unknown ID), without locking
+const char *customer_name(const customer_pool_t *pool, unsigned int customerId);
+
+//counts the line items in every shard (returned ones included)
+size_t count_line_items(const order_list_t *orders);
+
+//display the products in the catalog txt file a page at a time, all of them or one category or product
+void display_catalog(const catalog_t *catalog);
+
+//placing new order in the system from customer input
+void place_order(order_list_t *orders, const catalog_t *catalog);
+
+//generate a unique order number for customer after order is executed, returns 1 on success and 0 if it
+//couldn't be reserved in the sequence file, since a restart could hand the number out again
+int generate_order_number(order_sequence_t *sequence, order_id_t *orderId);
+
+//restores the order number sequence from its file so numbers stay unique across restarts
+void load_order_sequence(order_sequence_t *sequence, const char *filename);
+
+//moves the sequence past an order number that was loaded from disk
+void observe_order_number(order_sequence_t *sequence, order_id_t orderId);
+
+//reads an order number ("<node>-<counter>" or an older four digit one), returns 0 if it isn't one
+int parse_order_number(const char *orderNumber, order_id_t *orderId);
+
+//writes an order ID the way it's shown to customers, orderNumber holds MAX_ORDER_NUMBER bytes
+void format_order_number(order_id_t orderId, char *orderNumber);
+
+//displays the current orders in the system a page at a time, all of them or one customer, order, product or category
+void display_orders(const order_list_t *orders, const catalog_t *catalog);
+
+//checks if a given product number is valid from the catalog txt file
+int isProductNumberValid(const catalog_t *catalog, int productNumber);
+
+//looks up a product by its product number in O(1), returns NULL if it doesn't exist
+const product_t *find_product(const catalog_t *catalog, int productNumber);
+
+//(re)builds the product number index over every product in the catalog
+void build_product_index(catalog_t *catalog);
+
+//spreads product numbers over a power of two table (Fibonacci hashing), mask picks the slot
+//shared by every table keyed by product number
+size_t hash_product_number(int productNumber, size_t mask);
+
+//hash of a product number under a seed, seed 0 picks the perfect hash bucket and the bucket's seed the slot
+unsigned int perfect_hash_product(int productNumber, unsigned int seed);
+
+//returns the ID of a category name, adding the category if it's new
+int intern_category(catalog_t *catalog, const char *name);
+
+//looks up a category by name in O(1), returns -1 if it doesn't exist
+int find_category(const catalog_t *catalog, const char *name);
+
+//returns the name of a category ID ("" for an unknown ID)
+const char *category_name(const catalog_t *catalog, int categoryId);
+
+//returns the products of a category as one contiguous run and stores their count, NULL if there are none
+const product_t *products_in_category(const catalog_t *catalog, int categoryId, size_t *count);
+
+//counts the products of a category in O(1)
+size_t count_products_in_category(const catalog_t *catalog, int categoryId);
+
+//groups the products by category (stable, so file order holds within a category) and rebuilds the ranges
+//products move, so the product number index must be rebuilt afterwards
+void build_category_index(catalog_t *catalog);
+
+//processes a return for a given order number
+void process_return(order_list_t *orders);
+
+//returns every unit left on an order's line items and journals it, returns how many line items had units left
+//an order sealed out of memory is returned in its day's segment instead (see archive_return)
+size_t return_order(order_list_t *orders, const char *orderNumber);
+
+//returns quantity units of one product of an order and journals it, returns 0 if the order has no line item
+//for the product or fewer units than that left on it (nothing is returned then), 1 otherwise, sealed orders too
+int return_line_item(order_list_t *orders, const char *orderNumber, int productNumber, int quantity);
+
+//adds an entry to the returns ledger as it is, without touching the line items or journaling it, used by the loaders
+void add_return_entry(order_list_t *orders, const order_t *entry);
+
+//units of a product returned on one order, from the ledger in O(1) plus the order's returns
+long long returned_units(const order_list_t *orders, const char *orderNumber, int productNumber);
+
+//units of a product returned on every order, from each shard's ledger in O(1) plus the product's returns
+long long returned_units_of_product(const order_list_t *orders, int productNumber);
+
+//displays the returns processed in the system a page at a time, filtered like display_orders
+void display_returns(const order_list_t *orders, const catalog_t *catalog);
+
+//quit the program
+void quit_program();
+
+//frees the memory allocated for the catalog
+void free_catalog(catalog_t *catalog);
+
+//frees the memory allocated for the orders
+void free_orders(order_list_t *orders);
+
+//loads product information from a file into the catalog
+void load_catalog_from_file(catalog_t *catalog, const char *filename);
+
+//saves customer order information to a file ('customer_information.txt'), the caller must be the only thread
+//only the units that weren't returned are saved, fully returned line items not at all, sealed days are saved first
+void save_customer_information(const order_list_t *orders, const char *filename);
+
+//load customer order information from 'customer_information.txt' file
+void load_customer_information(order_list_t *orders, const char *filename);
+
+//saves the returns ledger to a file ('customer_returns.txt') in the same format as the orders, one line item per return
+//with the units returned as its quantity, sealed days included, the caller must be the only thread
+void save_customer_returns(const order_list_t *orders, const char *filename);
+
+//loads the returns ledger from a 'customer_returns.txt' file, a missing file means there are no returns yet
+void load_customer_returns(order_list_t *orders, const char *filename);
+
 #endif /* CATALOG_SYSTEM_H */
\ No newline at end of file
@@ -0,0 +1,230 @@
+/*
+Stock levels for the products in the catalog. Each product's counter sits on its own cache line and is only
+ever changed with atomic operations: an order reserves its units with a compare-and-swap that fails instead
+of going below zero, and a return adds them back. Intake threads ordering the same product therefore never
+wait on a lock, they retry the swap when another thread got there first.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "inventory.h"
+#include "archive.h"
+
+//finds the slot of a product, or the empty slot where it belongs
+static stock_entry_t *stock_slot(const inventory_t *inventory, int productNumber) 
+{
+    size_t mask = inventory->capacity - 1;
+    size_t slot = hash_product_number(productNumber, mask);
+
+    while (inventory->slots[slot].tracked && inventory->slots[slot].productNumber != productNumber) 
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return &inventory->slots[slot];
+}
+
+//finds a listed product, NULL if the inventory doesn't have it
+static stock_entry_t *find_stock(const inventory_t *inventory, int productNumber) 
+{
+    if (inventory == NULL || inventory->capacity == 0) 
+    {
+        return NULL;
+    }
+
+    stock_entry_t *entry = stock_slot(inventory, productNumber);
+
+    return entry->tracked ? entry : NULL;
+}
+
+//allocates a zeroed, cache line aligned table of slots or exits
+static stock_entry_t *allocate_slots(size_t capacity) 
+{
+    stock_entry_t *slots = (stock_entry_t *)aligned_alloc(INVENTORY_CACHE_LINE, capacity * sizeof(stock_entry_t));
+
+    if (!slots) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memset(slots, 0, capacity * sizeof(stock_entry_t));
+
+    return slots;
+}
+
+inventory_t *create_inventory(void) 
+{
+    inventory_t *inventory = (inventory_t *)calloc(1, sizeof(inventory_t));
+
+    if (!inventory) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return inventory;
+}
+
+void set_stock(inventory_t *inventory, int productNumber, long long stock) 
+{
+    //keep the table at most half full, moving every product over when it doubles
+    if ((inventory->count + 1) * 2 > inventory->capacity) 
+    {
+        stock_entry_t *old = inventory->slots;
+        size_t oldCapacity = inventory->capacity;
+
+        inventory->capacity = oldCapacity == 0 ? 64 : oldCapacity * 2;
+        inventory->slots = allocate_slots(inventory->capacity);
+
+        for (size_t i = 0; i < oldCapacity; i++) 
+        {
+            if (old[i].tracked) 
+            {
+                stock_entry_t *entry = stock_slot(inventory, old[i].productNumber);
+                entry->productNumber = old[i].productNumber;
+                entry->tracked = 1;
+                atomic_init(&entry->stock, atomic_load(&old[i].stock));
+            }
+        }
+
+        free(old);
+    }
+
+    stock_entry_t *entry = stock_slot(inventory, productNumber);
+
+    if (!entry->tracked) 
+    {
+        entry->productNumber = productNumber;
+        entry->tracked = 1;
+        inventory->count++;
+    }
+
+    atomic_store(&entry->stock, stock);
+}
+
+inventory_t *load_inventory(const char *filename, const order_list_t *orders) 
+{
+    FILE *file = fopen(filename, "r");
+
+    if (!file) 
+    {
+        return NULL;
+    }
+
+    inventory_t *inventory = create_inventory();
+    char line[256];
+    size_t lineNumber = 0;
+
+    while (fgets(line, sizeof(line), file) != NULL) 
+    {
+        lineNumber++;
+
+        //the name in front is only there for whoever edits the file
+        const char *product = strstr(line, "product no.");
+        int productNumber;
+        long long stock;
+
+        if (product == NULL) 
+        {
+            continue;
+        }
+
+        if (sscanf(product, "product no. %d, in stock: %lld", &productNumber, &stock) != 2 || stock < 0) 
+        {
+            printf("Invalid stock level on line %zu of %s, skipped\n", lineNumber, filename);
+            continue;
+        }
+
+        set_stock(inventory, productNumber, stock);
+    }
+
+    fclose(file);
+
+    //units on line items that weren't returned are gone from the shelf
+    for (size_t s = 0; s < ORDER_SHARDS; s++) 
+    {
+        for (const order_chunk_t *chunk = orders->shards[s].current.head; chunk != NULL; chunk = chunk->next) 
+        {
+            for (size_t i = 0; i < chunk->count; i++) 
+            {
+                stock_entry_t *entry = find_stock(inventory, chunk->orders[i].productNumber);
+
+                if (entry != NULL) 
+                {
+                    atomic_fetch_sub_explicit(&entry->stock, chunk->orders[i].quantity - chunk->orders[i].returnedQuantity, memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    //and so are the ones on days sealed out of memory, which the archive keeps a total of per product
+    for (size_t i = 0; orders->archive != NULL && i < inventory->capacity; i++) 
+    {
+        stock_entry_t *entry = &inventory->slots[i];
+
+        if (entry->tracked) 
+        {
+            atomic_fetch_sub_explicit(&entry->stock, archive_kept_units(orders->archive, entry->productNumber), memory_order_relaxed);
+        }
+    }
+
+    return inventory;
+}
+
+int reserve_stock(inventory_t *inventory, int productNumber, int quantity) 
+{
+    //taking away a negative quantity would add stock
+    if (quantity <= 0) 
+    {
+        return 0;
+    }
+
+    stock_entry_t *entry = find_stock(inventory, productNumber);
+
+    if (entry == NULL) 
+    {
+        return 1;
+    }
+
+    //the counter is the only shared state, so relaxed ordering is enough; a failed swap reloads it and tries again
+    long long stock = atomic_load_explicit(&entry->stock, memory_order_relaxed);
+
+    do 
+    {
+        if (stock < quantity) 
+        {
+            return 0;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&entry->stock, &stock, stock - quantity,
+                                                    memory_order_relaxed, memory_order_relaxed));
+
+    return 1;
+}
+
+void restock(inventory_t *inventory, int productNumber, int quantity) 
+{
+    stock_entry_t *entry = quantity > 0 ? find_stock(inventory, productNumber) : NULL;
+
+    if (entry != NULL) 
+    {
+        atomic_fetch_add_explicit(&entry->stock, quantity, memory_order_relaxed);
+    }
+}
+
+long long stock_level(const inventory_t *inventory, int productNumber) 
+{
+    stock_entry_t *entry = find_stock(inventory, productNumber);
+
+    return entry != NULL ? atomic_load_explicit(&entry->stock, memory_order_relaxed) : INVENTORY_UNTRACKED;
+}
+
+void free_inventory(inventory_t *inventory) 
+{
+    if (inventory != NULL) 
+    {
+        free(inventory->slots);
+        free(inventory);
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include <stdatomic.h>
+#include "catalog_system.h"
+
+#define INVENTORY_FILE "furniture_inventory.txt"
+#define INVENTORY_CACHE_LINE 64 //bytes each stock counter is padded to
+#define INVENTORY_UNTRACKED -1  //stock_level of a product the inventory doesn't list
+
+//stock of one product, alone on its cache line so threads ordering neighbouring products never share it
+typedef struct {
+    _Alignas(INVENTORY_CACHE_LINE) _Atomic long long stock; //units that can still be ordered, below 0 if the file was lowered
+    int productNumber;
+    int tracked; //0 marks an empty slot
+} stock_entry_t;
+
+/*stock levels by product number. The table is filled before any order is placed and never changes shape
+afterwards, so a reservation is a lookup plus a compare-and-swap on the product's counter and never takes a lock*/
+typedef struct inventory {
+    stock_entry_t *slots; //open addressing by product number, cache line aligned
+    size_t capacity;      //always a power of two (0 until the first product is added)
+    size_t count;         //products listed
+} inventory_t;
+
+//function declarations
+
+//allocates an empty inventory
+inventory_t *create_inventory(void);
+
+//sets the stock of a product, adding it if it's new, only while no order can be placed
+void set_stock(inventory_t *inventory, int productNumber, long long stock);
+
+/*loads the stock levels from an inventory file ('Name, product no. N, in stock: S' per line) and takes off
+the units the loaded orders kept and the units the archive's index totals for its sealed days, so the file
+lists stock received rather than stock left. Returns NULL if the file doesn't exist, orders then take any quantity*/
+inventory_t *load_inventory(const char *filename, const order_list_t *orders);
+
+//takes quantity units of a product out of stock, returns 0 (and takes nothing) if fewer are left or quantity
+//isn't positive, products the inventory doesn't list (or a NULL inventory) are never short
+int reserve_stock(inventory_t *inventory, int productNumber, int quantity);
+
+//puts quantity units of a product back in stock, for returns and reservations that were given up
+//a quantity that isn't positive puts nothing back
+void restock(inventory_t *inventory, int productNumber, int quantity);
+
+//units of a product left in stock, INVENTORY_UNTRACKED if the inventory doesn't list it
+long long stock_level(const inventory_t *inventory, int productNumber);
+
+//frees the memory allocated for the inventory
+void free_inventory(inventory_t *inventory);
+
+#endif /* INVENTORY_H */
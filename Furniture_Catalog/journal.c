@@ -0,0 +1,611 @@
+/*
+Write-ahead journal for the customer order information. Every order line and return becomes one fixed-size
+record as it happens, so saving costs only the new records. Records go through a lock-free queue to a writer
+thread that commits them in groups, one large sequential write per commit interval, and syncs the file as the
+policy says; a crash loses at most the last interval. Startup replays the journal on top of the snapshot, and
+once the journal grows large the writer folds it into a new snapshot.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include "journal.h"
+#include "snapshot.h"
+#include "stats.h"
+
+//FNV-1a over the record up to its checksum field, then over placedAt unless it's 0 like in records written before it
+static uint32_t journal_checksum(const journal_record_t *record) 
+{
+    const unsigned char *bytes = (const unsigned char *)record;
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < offsetof(journal_record_t, checksum); i++) 
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    for (uint32_t placedAt = record->placedAt; placedAt != 0; placedAt >>= 8) 
+    {
+        hash = (hash ^ (placedAt & 0xff)) * 16777619u;
+    }
+
+    return hash;
+}
+
+//applies one record to the orders the same way the menu did when it was written
+static void replay_record(order_list_t *orders, const journal_record_t *record) 
+{
+    if (record->type == JOURNAL_RETURN) 
+    {
+        if (record->productNumber == 0) 
+        {
+            return_order(orders, record->orderNumber);
+        } else {
+            return_line_item(orders, record->orderNumber, record->productNumber, record->quantity);
+        }
+        return;
+    }
+
+    order_t order;
+
+    //the record keeps the strings the menu saw, they're interned and parsed back into IDs here
+    if (!parse_order_number(record->orderNumber, &order.orderId)) 
+    {
+        return;
+    }
+
+    order.customerId = intern_customer(&orders->customers, record->customerName);
+    order.productNumber = record->productNumber;
+    order.quantity = record->quantity;
+    order.isReturn = 0;
+    order.returnedQuantity = 0;
+    order.placedAt = record->placedAt;
+
+    //quantity for a product already on the order is added to its line item
+    add_order_quantity(orders, &order);
+    observe_order_number(&orders->sequence, order.orderId);
+}
+
+//takes every shard lock in index order, committing queued records whenever one is busy, since its holder
+//may be waiting for room in the queue
+static void lock_every_shard(journal_t *journal);
+
+//writes count records, retrying short writes, returns 0 on success and -1 on failure
+static int write_records(int fd, const journal_record_t *records, size_t count) 
+{
+    const char *bytes = (const char *)records;
+    size_t left = count * sizeof(journal_record_t);
+
+    while (left > 0) 
+    {
+        ssize_t written = write(fd, bytes, left);
+
+        if (written < 0) 
+        {
+            if (errno == EINTR) 
+            {
+                continue;
+            }
+
+            return -1;
+        }
+
+        bytes += written;
+        left -= (size_t)written;
+    }
+
+    return 0;
+}
+
+//takes the next record off the queue if its producer has finished with it, only the writer calls this
+static int take_record(journal_t *journal, journal_record_t *record) 
+{
+    journal_cell_t *cell = &journal->queue[journal->dequeued & (JOURNAL_QUEUE_RECORDS - 1)];
+
+    if (atomic_load_explicit(&cell->sequence, memory_order_acquire) != journal->dequeued + 1) 
+    {
+        return 0;
+    }
+
+    *record = cell->record;
+
+    //hand the cell back to the producers for the lap after this one
+    atomic_store_explicit(&cell->sequence, journal->dequeued + JOURNAL_QUEUE_RECORDS, memory_order_release);
+    journal->dequeued++;
+
+    return 1;
+}
+
+//stops appending after a failed write or sync, a torn record is cut off so it can't end replay early later
+static void fail_journal(journal_t *journal) 
+{
+    printf("Error writing file: %s\n", journal->filename);
+
+    if (ftruncate(journal->fd, journal->goodLength) != 0) 
+    {
+        printf("Error truncating file: %s\n", journal->filename);
+    }
+
+    pthread_mutex_lock(&journal->lock);
+    journal->failed = 1;
+    pthread_mutex_unlock(&journal->lock);
+}
+
+//drains the queue into batches and writes them, numbering the records in the order they were queued
+//after a failure the records are still drained, so producers never wait, but dropped
+//returns how many records were written
+static size_t commit_queued(journal_t *journal) 
+{
+    order_list_t *orders = journal->orders;
+    size_t written = 0;
+    size_t count;
+
+    do 
+    {
+        count = 0;
+
+        while (count < JOURNAL_BATCH_RECORDS && take_record(journal, &journal->batch[count])) 
+        {
+            journal_record_t *record = &journal->batch[count++];
+            record->sequence = ++orders->journalSequence;
+            record->checksum = journal_checksum(record);
+        }
+
+        if (count == 0 || journal->failed) 
+        {
+            continue;
+        }
+
+        if (write_records(journal->fd, journal->batch, count) != 0) 
+        {
+            fail_journal(journal);
+            continue;
+        }
+
+        journal->goodLength += (off_t)(count * sizeof(journal_record_t));
+        journal->records += count;
+        written += count;
+
+    } while (count == JOURNAL_BATCH_RECORDS);
+
+    STATS_ADD(STATS_JOURNAL_RECORDS, written);
+
+    return written;
+}
+
+//forces what was written to disk, a failed sync leaves no telling what reached it
+static void sync_journal(journal_t *journal) 
+{
+    if (!journal->failed && fdatasync(journal->fd) != 0) 
+    {
+        fail_journal(journal);
+    }
+}
+
+//writes a fresh snapshot and empties the journal, runs on the writer thread
+static int compact_now(journal_t *journal) 
+{
+    order_list_t *orders = journal->orders;
+
+    //with every shard locked nothing can be queued, so once the queue is drained the orders in memory and
+    //the journal sequence agree and the snapshot sees no half-applied change
+    lock_every_shard(journal);
+    commit_queued(journal);
+
+    int result = -1;
+
+    //the snapshot records the last journal sequence it holds, so a crash before the journal is emptied only
+    //leaves records that replay will skip; it's synced, rename included, before the journal is cut
+    if (save_snapshot(orders, journal->snapshotFilename) == 0) 
+    {
+        if (ftruncate(journal->fd, 0) == 0) 
+        {
+            journal->records = 0;
+            journal->goodLength = 0;
+            result = 0;
+        } else {
+            printf("Error truncating file: %s\n", journal->filename);
+        }
+    }
+
+    for (size_t i = ORDER_SHARDS; i > 0; i--) 
+    {
+        pthread_mutex_unlock(&orders->shards[i - 1].lock);
+    }
+
+    //after a failure the next attempt waits for another full journal rather than retrying every commit
+    journal->compactAt = journal->records + JOURNAL_COMPACT_RECORDS;
+
+    return result;
+}
+
+static void lock_every_shard(journal_t *journal) 
+{
+    order_list_t *orders = journal->orders;
+
+    for (;;) 
+    {
+        size_t locked = 0;
+
+        while (locked < ORDER_SHARDS && pthread_mutex_trylock(&orders->shards[locked].lock) == 0) 
+        {
+            locked++;
+        }
+
+        if (locked == ORDER_SHARDS) 
+        {
+            return;
+        }
+
+        while (locked > 0) 
+        {
+            pthread_mutex_unlock(&orders->shards[--locked].lock);
+        }
+
+        commit_queued(journal);
+        sched_yield();
+    }
+}
+
+//the writer thread: every commit interval (or sooner when woken) it commits whatever was queued
+static void *journal_writer(void *argument) 
+{
+    journal_t *journal = (journal_t *)argument;
+    int unsynced = 0;
+
+    pthread_mutex_lock(&journal->lock);
+
+    for (;;) 
+    {
+        if (!journal->wakeRequested && !journal->stopping) 
+        {
+            int intervalMs = atomic_load(&journal->commitIntervalMs);
+            struct timespec deadline;
+
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += intervalMs / 1000;
+            deadline.tv_nsec += (long)(intervalMs % 1000) * 1000000L;
+
+            if (deadline.tv_nsec >= 1000000000L) 
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+
+            pthread_cond_timedwait(&journal->wake, &journal->lock, &deadline);
+        }
+
+        int stopping = journal->stopping;
+        int flushing = journal->flushRequested || stopping;
+        int compacting = journal->compactRequested;
+
+        journal->wakeRequested = 0;
+        journal->flushRequested = 0;
+
+        pthread_mutex_unlock(&journal->lock);
+
+        STATS_START(timer);
+
+        size_t written = commit_queued(journal);
+        int policy = atomic_load(&journal->syncPolicy);
+
+        unsynced |= written > 0;
+
+        if (unsynced && (policy == JOURNAL_SYNC_COMMIT || (policy == JOURNAL_SYNC_FLUSH && flushing))) 
+        {
+            sync_journal(journal);
+            unsynced = 0;
+        }
+
+        if (written > 0) 
+        {
+            STATS_STOP(STATS_JOURNAL_COMMIT, timer);
+        }
+
+        int compactResult = 0;
+
+        if (compacting || journal->records >= journal->compactAt) 
+        {
+            compactResult = compact_now(journal);
+        }
+
+        pthread_mutex_lock(&journal->lock);
+
+        //records dropped after a failure never count as committed
+        if (!journal->failed) 
+        {
+            journal->committedRecords = journal->dequeued;
+        }
+
+        if (compacting) 
+        {
+            journal->compactRequested = 0;
+            journal->compactResult = compactResult;
+            journal->compactions++;
+        }
+
+        pthread_cond_broadcast(&journal->committed);
+
+        if (stopping) 
+        {
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&journal->lock);
+
+    return NULL;
+}
+
+//wakes the writer up ahead of its interval, the caller holds the journal lock
+static void wake_writer(journal_t *journal) 
+{
+    journal->wakeRequested = 1;
+    pthread_cond_signal(&journal->wake);
+}
+
+long long open_journal(journal_t *journal, order_list_t *orders, const char *filename, const char *snapshotFilename) 
+{
+    snprintf(journal->filename, sizeof(journal->filename), "%s", filename);
+    snprintf(journal->snapshotFilename, sizeof(journal->snapshotFilename), "%s", snapshotFilename);
+    journal->orders = orders;
+    journal->records = 0;
+    journal->compactAt = JOURNAL_COMPACT_RECORDS;
+    journal->fd = -1;
+    journal->running = 0;
+    atomic_init(&journal->commitIntervalMs, JOURNAL_COMMIT_MS);
+    atomic_init(&journal->syncPolicy, JOURNAL_SYNC);
+
+    long long replayed = 0;
+    long validLength = 0;
+    FILE *file = fopen(filename, "rb");
+
+    if (file) 
+    {
+        journal_record_t record;
+
+        //replay up to the first short or corrupt record, which can only be a write cut off by a crash
+        while (fread(&record, sizeof(record), 1, file) == 1 && record.checksum == journal_checksum(&record)) 
+        {
+            //records already folded into the snapshot are skipped
+            if (record.sequence > orders->journalSequence) 
+            {
+                replay_record(orders, &record);
+                orders->journalSequence = record.sequence;
+                replayed++;
+            }
+
+            journal->records++;
+            validLength += (long)sizeof(record);
+        }
+
+        fclose(file);
+
+        //drop the torn tail so new records follow the last good one
+        if (truncate(filename, validLength) != 0) 
+        {
+            printf("Error truncating file: %s\n", filename);
+        }
+    }
+
+    STATS_ADD(STATS_RECORDS_PARSED, (unsigned long long)replayed);
+
+    journal->fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    journal->goodLength = validLength;
+
+    if (journal->fd < 0) 
+    {
+        printf("Error opening file: %s\n", filename);
+        return -1;
+    }
+
+    journal->queue = (journal_cell_t *)malloc(JOURNAL_QUEUE_RECORDS * sizeof(journal_cell_t));
+    journal->batch = (journal_record_t *)malloc(JOURNAL_BATCH_RECORDS * sizeof(journal_record_t));
+
+    if (!journal->queue || !journal->batch) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    //a cell is free for the producer of position p when its sequence is p
+    for (size_t i = 0; i < JOURNAL_QUEUE_RECORDS; i++) 
+    {
+        atomic_init(&journal->queue[i].sequence, i);
+    }
+
+    atomic_init(&journal->enqueued, 0);
+    journal->dequeued = 0;
+    journal->wakeRequested = 0;
+    journal->stopping = 0;
+    journal->committedRecords = 0;
+    journal->failed = 0;
+    journal->flushRequested = 0;
+    journal->compactions = 0;
+    journal->compactRequested = 0;
+    journal->compactResult = 0;
+
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&journal->wake, &attributes);
+    pthread_condattr_destroy(&attributes);
+    pthread_cond_init(&journal->committed, NULL);
+    pthread_mutex_init(&journal->lock, NULL);
+
+    if (pthread_create(&journal->writer, NULL, journal_writer, journal) != 0) 
+    {
+        printf("Could not start the journal writer, changes won't be journaled.\n");
+        close(journal->fd);
+        journal->fd = -1;
+        return -1;
+    }
+
+    journal->running = 1;
+    orders->journal = journal;
+
+    return replayed;
+}
+
+//copies a record into the queue for the writer, callers hold the order's shard lock
+static void append_record(order_list_t *orders, const journal_record_t *record) 
+{
+    journal_t *journal = orders->journal;
+
+    if (journal == NULL) 
+    {
+        return;
+    }
+
+    size_t position = atomic_load_explicit(&journal->enqueued, memory_order_relaxed);
+    journal_cell_t *cell;
+
+    for (;;) 
+    {
+        cell = &journal->queue[position & (JOURNAL_QUEUE_RECORDS - 1)];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+
+        if (sequence == position) 
+        {
+            //the cell is free for this position, claim it unless another producer got there first
+            if (atomic_compare_exchange_weak_explicit(&journal->enqueued, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (sequence < position) 
+        {
+            //the writer hasn't taken the record from the lap before, the queue is full
+            pthread_mutex_lock(&journal->lock);
+            wake_writer(journal);
+            pthread_mutex_unlock(&journal->lock);
+
+            sched_yield();
+            position = atomic_load_explicit(&journal->enqueued, memory_order_relaxed);
+        } else {
+            position = atomic_load_explicit(&journal->enqueued, memory_order_relaxed);
+        }
+    }
+
+    cell->record = *record;
+    atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+}
+
+void journal_order(order_list_t *orders, const order_t *order, int quantity) 
+{
+    journal_record_t record;
+
+    //zeroed so padding and unused string bytes checksum the same on replay
+    memset(&record, 0, sizeof(record));
+    record.type = JOURNAL_ORDER;
+    record.productNumber = order->productNumber;
+    record.quantity = quantity;
+    snprintf(record.customerName, MAX_NAME, "%s", customer_name(&orders->customers, order->customerId));
+    format_order_number(order->orderId, record.orderNumber);
+    record.placedAt = order->placedAt;
+
+    append_record(orders, &record);
+}
+
+void journal_return(order_list_t *orders, order_id_t orderId, int productNumber, int quantity) 
+{
+    journal_record_t record;
+
+    memset(&record, 0, sizeof(record));
+    record.type = JOURNAL_RETURN;
+    record.productNumber = productNumber;
+    record.quantity = quantity;
+    format_order_number(orderId, record.orderNumber);
+
+    append_record(orders, &record);
+}
+
+int flush_journal(journal_t *journal) 
+{
+    if (!journal->running) 
+    {
+        return -1;
+    }
+
+    //everything claimed so far, a record still being copied in holds the barrier until it's done
+    size_t target = atomic_load(&journal->enqueued);
+
+    pthread_mutex_lock(&journal->lock);
+
+    while (journal->committedRecords < target && !journal->failed) 
+    {
+        journal->flushRequested = 1;
+        wake_writer(journal);
+        pthread_cond_wait(&journal->committed, &journal->lock);
+    }
+
+    int result = journal->failed ? -1 : 0;
+
+    pthread_mutex_unlock(&journal->lock);
+
+    return result;
+}
+
+int compact_journal(journal_t *journal) 
+{
+    if (!journal->running) 
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&journal->lock);
+
+    unsigned long long compactions = journal->compactions;
+    journal->compactRequested = 1;
+    wake_writer(journal);
+
+    while (journal->compactions == compactions) 
+    {
+        pthread_cond_wait(&journal->committed, &journal->lock);
+    }
+
+    int result = journal->compactResult;
+
+    pthread_mutex_unlock(&journal->lock);
+
+    return result;
+}
+
+void close_journal(journal_t *journal) 
+{
+    if (!journal->running) 
+    {
+        return;
+    }
+
+    //records still being copied in are waited for, then the writer commits and syncs the rest on its way out
+    flush_journal(journal);
+
+    pthread_mutex_lock(&journal->lock);
+    journal->stopping = 1;
+    wake_writer(journal);
+    pthread_mutex_unlock(&journal->lock);
+
+    pthread_join(journal->writer, NULL);
+    journal->running = 0;
+
+    if (journal->orders->journal == journal) 
+    {
+        journal->orders->journal = NULL;
+    }
+
+    close(journal->fd);
+    journal->fd = -1;
+
+    free(journal->queue);
+    free(journal->batch);
+    pthread_cond_destroy(&journal->wake);
+    pthread_cond_destroy(&journal->committed);
+    pthread_mutex_destroy(&journal->lock);
+}
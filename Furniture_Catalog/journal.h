@@ -0,0 +1,111 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "catalog_system.h"
+
+#define JOURNAL_COMPACT_RECORDS 100000 //journal records that trigger folding the journal into the snapshot
+#define JOURNAL_QUEUE_RECORDS 16384    //records waiting for the writer at most, a power of two
+#define JOURNAL_BATCH_RECORDS 1024     //records the writer hands to the operating system in one write
+
+//how long records gather before the writer commits them as one batch, -DJOURNAL_COMMIT_MS=n to change it
+#ifndef JOURNAL_COMMIT_MS
+#define JOURNAL_COMMIT_MS 10
+#endif
+
+//when the writer forces the journal to disk
+#define JOURNAL_SYNC_NONE 0   //never, the operating system writes it back when it likes
+#define JOURNAL_SYNC_COMMIT 1 //after every group commit
+#define JOURNAL_SYNC_FLUSH 2  //only at flush barriers and when the journal is closed
+
+//default sync policy, -DJOURNAL_SYNC=n to change it
+#ifndef JOURNAL_SYNC
+#define JOURNAL_SYNC JOURNAL_SYNC_COMMIT
+#endif
+
+//kinds of journal records
+#define JOURNAL_ORDER 1  //quantity added to a product of an order
+#define JOURNAL_RETURN 2 //units of one product of an order returned, or every unit left on it for product number 0
+
+//one fixed-size journal record, appended for every order line and every return
+typedef struct {
+    uint64_t sequence;   //increases by one per record, snapshots remember the last one they contain
+    uint32_t type;
+    int32_t productNumber;
+    int32_t quantity;
+    char customerName[MAX_NAME];
+    char orderNumber[MAX_ORDER_NUMBER];
+    uint32_t checksum;   //FNV-1a of everything above (and placedAt once it's set), a torn write at the tail fails it
+    uint32_t placedAt;   //when an order was placed, in what used to be padding so older journals still read (as 0)
+} journal_record_t;
+
+//one slot of the record queue, sequence says whether it is free for a producer or ready for the writer
+typedef struct {
+    _Atomic size_t sequence;
+    journal_record_t record;
+} journal_cell_t;
+
+/*append-only log of the changes made since the last snapshot
+orders and returns only copy their record into a lock-free queue, a writer thread drains it every
+commitIntervalMs (or sooner when asked) and writes everything that piled up with one write, so nothing
+on the order path waits for the disk; the writer also folds the journal into the snapshot*/
+typedef struct journal {
+    journal_cell_t *queue;                 //JOURNAL_QUEUE_RECORDS cells
+    _Alignas(64) _Atomic size_t enqueued;  //records claimed by producers so far
+    _Alignas(64) size_t dequeued;          //records taken by the writer so far, only it touches this
+    journal_record_t *batch;               //JOURNAL_BATCH_RECORDS records the writer fills before writing
+    pthread_t writer;
+    int running;                           //1 while the writer thread runs
+    pthread_mutex_t lock;                  //guards the wake-up and barrier state below
+    pthread_cond_t wake;                   //wakes the writer before its interval is up
+    pthread_cond_t committed;              //broadcast after every group commit
+    int wakeRequested;
+    int stopping;                          //the writer commits what's left and exits
+    size_t committedRecords;               //records written (and synced, per the policy) so far, stops at a failure
+    int failed;                            //1 once a write or sync failed, nothing is appended after it
+    int flushRequested;                    //a flush barrier is waiting, JOURNAL_SYNC_FLUSH syncs for it
+    unsigned long long compactions;        //compactions done, a requester waits for it to move
+    int compactRequested;
+    int compactResult;                     //result of the last compaction
+    int fd;
+    off_t goodLength;                      //bytes of whole records in the file, a failed write is cut back to it
+    char filename[FILENAME_MAX];
+    char snapshotFilename[FILENAME_MAX];   //snapshot the journal is compacted into
+    order_list_t *orders;                  //what the journal logs, locked by the writer to compact
+    size_t records;                        //records written since the last compaction, only the writer touches this
+    size_t compactAt;                      //records that make the writer compact, pushed back when compacting fails
+    _Atomic int commitIntervalMs;          //group commit interval, JOURNAL_COMMIT_MS to start with
+    _Atomic int syncPolicy;                //one of the JOURNAL_SYNC_ values, JOURNAL_SYNC to start with
+} journal_t;
+
+//function declarations
+
+//replays the journal on top of the loaded orders, opens it for appending and starts its writer thread
+//returns records replayed or -1
+long long open_journal(journal_t *journal, order_list_t *orders, const char *filename, const char *snapshotFilename);
+
+//queues a record of quantity added to a product of an order, the caller holds the order's shard lock
+//only waits if the writer has fallen a whole queue behind
+void journal_order(order_list_t *orders, const order_t *order, int quantity);
+
+//queues a record of a return, quantity units of a product or (product number 0) the whole rest of the order
+//the caller holds the order's shard lock
+void journal_return(order_list_t *orders, order_id_t orderId, int productNumber, int quantity);
+
+//flush barrier: waits until every record queued before the call is written, and synced unless the
+//policy is JOURNAL_SYNC_NONE, returns 0 on success and -1 if the journal isn't open or a write or sync has
+//failed, which it keeps returning from then on since the records queued after the failure are dropped
+int flush_journal(journal_t *journal);
+
+//has the writer write a fresh snapshot and empty the journal, and waits for it
+//returns 0 on success and -1 on failure, the writer takes every shard lock so the caller must not hold any
+int compact_journal(journal_t *journal);
+
+//flushes the journal, stops its writer and closes the file
+void close_journal(journal_t *journal);
+
+#endif /* JOURNAL_H */
@@ -0,0 +1,320 @@
+/*
+Hot reload of the catalog. The published catalog is a single atomic pointer that is swapped for a newly
+loaded version, so lookups never wait on a reload. Readers announce the epoch they entered at in a slot of
+their own; a replaced catalog is tagged with the epoch it was published in and freed only once every reader
+inside a read section entered after it. The watcher thread polls the file's size, inode and modification
+time and builds the new catalog on its own thread.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "live_catalog.h"
+
+//the slot a thread reads from, handed to the key's destructor when the thread exits
+typedef struct {
+    live_catalog_t *live;
+    size_t slot;
+} catalog_reader_t;
+
+//gives a thread's slot back once the thread is gone
+static void release_reader_slot(void *value) 
+{
+    catalog_reader_t *reader = (catalog_reader_t *)value;
+
+    atomic_store(&reader->live->readerEpochs[reader->slot], 0);
+    atomic_store(&reader->live->readerClaimed[reader->slot], 0);
+    free(reader);
+}
+
+//the calling thread's slot, claimed the first time it reads
+static catalog_reader_t *reader_slot(live_catalog_t *live) 
+{
+    catalog_reader_t *reader = (catalog_reader_t *)pthread_getspecific(live->readerKey);
+
+    if (reader != NULL) 
+    {
+        return reader;
+    }
+
+    reader = (catalog_reader_t *)malloc(sizeof(catalog_reader_t));
+
+    if (!reader) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    reader->live = live;
+
+    //every slot taken only happens with more reading threads than LIVE_CATALOG_MAX_READERS, wait for one to exit
+    for (;;) 
+    {
+        for (size_t i = 0; i < LIVE_CATALOG_MAX_READERS; i++) 
+        {
+            int expected = 0;
+
+            if (atomic_compare_exchange_strong(&live->readerClaimed[i], &expected, 1)) 
+            {
+                reader->slot = i;
+                live->readerDepth[i] = 0;
+                pthread_setspecific(live->readerKey, reader);
+                return reader;
+            }
+        }
+
+        sched_yield();
+    }
+}
+
+//what the watcher compares between polls, returns 0 if the file couldn't be read
+static int file_fingerprint(const char *filename, long long *modifiedNs, long long *size, unsigned long long *inode) 
+{
+    struct stat status;
+
+    if (stat(filename, &status) != 0) 
+    {
+        return 0;
+    }
+
+    *modifiedNs = (long long)status.st_mtim.tv_sec * 1000000000LL + status.st_mtim.tv_nsec;
+    *size = (long long)status.st_size;
+    *inode = (unsigned long long)status.st_ino;
+
+    return 1;
+}
+
+void live_catalog_init(live_catalog_t *live, catalog_t *catalog) 
+{
+    memset(live, 0, sizeof(live_catalog_t));
+
+    atomic_init(&live->current, catalog);
+    atomic_init(&live->epoch, 1);
+    atomic_init(&live->versions, 1);
+    atomic_init(&live->stopWatching, 0);
+
+    for (size_t i = 0; i < LIVE_CATALOG_MAX_READERS; i++) 
+    {
+        atomic_init(&live->readerEpochs[i], 0);
+        atomic_init(&live->readerClaimed[i], 0);
+    }
+
+    pthread_key_create(&live->readerKey, release_reader_slot);
+    pthread_mutex_init(&live->lock, NULL);
+}
+
+const catalog_t *live_catalog_acquire(live_catalog_t *live) 
+{
+    catalog_reader_t *reader = reader_slot(live);
+
+    //the epoch is announced before the pointer is read, so whatever is read can't be freed under the reader
+    if (live->readerDepth[reader->slot]++ == 0) 
+    {
+        atomic_store(&live->readerEpochs[reader->slot], atomic_load(&live->epoch));
+    }
+
+    return atomic_load(&live->current);
+}
+
+void live_catalog_release(live_catalog_t *live) 
+{
+    catalog_reader_t *reader = reader_slot(live);
+
+    if (--live->readerDepth[reader->slot] == 0) 
+    {
+        atomic_store(&live->readerEpochs[reader->slot], 0);
+    }
+}
+
+void live_catalog_publish(live_catalog_t *live, catalog_t *catalog) 
+{
+    retired_catalog_t *retired = (retired_catalog_t *)malloc(sizeof(retired_catalog_t));
+
+    if (!retired) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_lock(&live->lock);
+
+    //readers that see the new epoch read the pointer after the swap, so only older ones can hold the old catalog
+    retired->catalog = atomic_exchange(&live->current, catalog);
+    retired->epoch = atomic_fetch_add(&live->epoch, 1);
+    retired->next = live->retired;
+    live->retired = retired;
+    atomic_fetch_add(&live->versions, 1);
+
+    pthread_mutex_unlock(&live->lock);
+
+    live_catalog_reclaim(live);
+}
+
+size_t live_catalog_reclaim(live_catalog_t *live) 
+{
+    size_t freed = 0;
+
+    pthread_mutex_lock(&live->lock);
+
+    //the oldest epoch any reader is still inside
+    unsigned long long oldest = atomic_load(&live->epoch);
+
+    for (size_t i = 0; i < LIVE_CATALOG_MAX_READERS; i++) 
+    {
+        unsigned long long entered = atomic_load(&live->readerEpochs[i]);
+
+        if (entered != 0 && entered < oldest) 
+        {
+            oldest = entered;
+        }
+    }
+
+    retired_catalog_t **link = &live->retired;
+
+    while (*link != NULL) 
+    {
+        retired_catalog_t *retired = *link;
+
+        if (retired->epoch < oldest) 
+        {
+            *link = retired->next;
+            free_catalog(retired->catalog);
+            free(retired);
+            freed++;
+        } else {
+            link = &retired->next;
+        }
+    }
+
+    pthread_mutex_unlock(&live->lock);
+
+    return freed;
+}
+
+long long live_catalog_reload(live_catalog_t *live, const char *filename) 
+{
+    catalog_t *catalog = create_catalog();
+
+    //the categories of the published version come first, in the same order, so their IDs carry over
+    const catalog_t *previous = live_catalog_acquire(live);
+
+    for (size_t c = 0; c < previous->categoryCount; c++) 
+    {
+        intern_category(catalog, previous->categories[c].name);
+    }
+
+    live_catalog_release(live);
+
+    load_catalog_from_file(catalog, filename);
+
+    //a missing or empty file (one that is still being written, say) leaves the published version alone
+    if (catalog->count == 0) 
+    {
+        free_catalog(catalog);
+        return -1;
+    }
+
+    long long count = (long long)catalog->count;
+    live_catalog_publish(live, catalog);
+
+    return count;
+}
+
+//polls the catalog file and reloads it whenever it looks different from the last load
+static void *watch_catalog_file(void *argument) 
+{
+    live_catalog_t *live = (live_catalog_t *)argument;
+    struct timespec pause;
+    pause.tv_sec = live->pollMs / 1000;
+    pause.tv_nsec = (long)(live->pollMs % 1000) * 1000000L;
+
+    while (!atomic_load(&live->stopWatching)) 
+    {
+        nanosleep(&pause, NULL);
+
+        long long modifiedNs;
+        long long size;
+        unsigned long long inode;
+
+        if (file_fingerprint(live->filename, &modifiedNs, &size, &inode) &&
+            (modifiedNs != live->modifiedNs || size != live->size || inode != live->inode)) {
+            long long count = live_catalog_reload(live, live->filename);
+
+            //a failed load is retried on the next poll, the file may still be being written
+            if (count >= 0) 
+            {
+                live->modifiedNs = modifiedNs;
+                live->size = size;
+                live->inode = inode;
+                fprintf(stderr, "\nCatalog reloaded: %lld products from %s\n", count, live->filename);
+            }
+        }
+
+        //versions replaced earlier are freed once the readers that could see them have left
+        live_catalog_reclaim(live);
+    }
+
+    return NULL;
+}
+
+int live_catalog_watch(live_catalog_t *live, const char *filename, unsigned int pollMs) 
+{
+    snprintf(live->filename, sizeof(live->filename), "%s", filename);
+    live->pollMs = pollMs > 0 ? pollMs : LIVE_CATALOG_POLL_MS;
+
+    //the published catalog counts as loaded from the file as it is now
+    file_fingerprint(filename, &live->modifiedNs, &live->size, &live->inode);
+
+    atomic_store(&live->stopWatching, 0);
+
+    if (pthread_create(&live->watcher, NULL, watch_catalog_file, live) != 0) 
+    {
+        return -1;
+    }
+
+    live->watching = 1;
+
+    return 0;
+}
+
+void live_catalog_stop(live_catalog_t *live) 
+{
+    if (live->watching) 
+    {
+        atomic_store(&live->stopWatching, 1);
+        pthread_join(live->watcher, NULL);
+        live->watching = 0;
+    }
+}
+
+void live_catalog_free(live_catalog_t *live) 
+{
+    live_catalog_stop(live);
+
+    //the calling thread's slot isn't handed back by the key once the key is gone
+    catalog_reader_t *reader = (catalog_reader_t *)pthread_getspecific(live->readerKey);
+
+    if (reader != NULL) 
+    {
+        pthread_setspecific(live->readerKey, NULL);
+        release_reader_slot(reader);
+    }
+
+    pthread_key_delete(live->readerKey);
+
+    while (live->retired != NULL) 
+    {
+        retired_catalog_t *retired = live->retired;
+        live->retired = retired->next;
+        free_catalog(retired->catalog);
+        free(retired);
+    }
+
+    free_catalog(atomic_load(&live->current));
+    pthread_mutex_destroy(&live->lock);
+}
@@ -0,0 +1,74 @@
+#ifndef LIVE_CATALOG_H
+#define LIVE_CATALOG_H
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "catalog_system.h"
+
+#define LIVE_CATALOG_MAX_READERS 64 //threads that can be inside a read section at once
+#define LIVE_CATALOG_POLL_MS 1000   //how often the watcher checks the catalog file
+
+//a catalog that was replaced, freed once no reader can still be looking at it
+typedef struct retired_catalog {
+    catalog_t *catalog;
+    unsigned long long epoch; //epoch during which it was the published catalog
+    struct retired_catalog *next;
+} retired_catalog_t;
+
+/*the published catalog, swapped whole for a new version while readers keep going
+a published catalog is never changed, readers bracket their use of it with live_catalog_acquire and
+live_catalog_release, which never wait on anything*/
+typedef struct live_catalog {
+    _Atomic(catalog_t *) current;
+    _Atomic unsigned long long epoch;                                //moves forward once per publish, starts at 1
+    _Atomic unsigned long long readerEpochs[LIVE_CATALOG_MAX_READERS]; //epoch each reader entered at, 0 when it's outside
+    _Atomic int readerClaimed[LIVE_CATALOG_MAX_READERS];             //1 while a thread owns the slot
+    unsigned int readerDepth[LIVE_CATALOG_MAX_READERS];              //nested acquires, only touched by the slot's thread
+    pthread_key_t readerKey;                                         //each thread's slot, given back when the thread exits
+    pthread_mutex_t lock;             //serializes publishing and reclaiming
+    retired_catalog_t *retired;       //guarded by lock
+    _Atomic unsigned long long versions; //catalogs published so far, the first one included
+    char filename[FILENAME_MAX];      //file the watcher reloads from
+    unsigned int pollMs;
+    pthread_t watcher;
+    int watching;                     //1 while the watcher thread runs
+    _Atomic int stopWatching;
+    long long modifiedNs;             //what the file looked like when it was last loaded
+    long long size;
+    unsigned long long inode;
+} live_catalog_t;
+
+//function declarations
+
+//publishes the first catalog, which the live catalog owns from now on
+void live_catalog_init(live_catalog_t *live, catalog_t *catalog);
+
+//enters a read section and returns the newest catalog, which stays valid until the matching release
+//sections nest, a thread only leaves once every acquire has been released
+const catalog_t *live_catalog_acquire(live_catalog_t *live);
+
+//leaves the read section entered by the last acquire
+void live_catalog_release(live_catalog_t *live);
+
+//replaces the published catalog with a new one and retires the old one, readers are never held up
+void live_catalog_publish(live_catalog_t *live, catalog_t *catalog);
+
+//frees every retired catalog that no reader can still see, returns how many were freed
+size_t live_catalog_reclaim(live_catalog_t *live);
+
+//loads a new version of the catalog from a file and publishes it, returns its product count or -1
+//categories keep the IDs they had, so line items stored against an older version still name the right one
+long long live_catalog_reload(live_catalog_t *live, const char *filename);
+
+//starts a thread that reloads the catalog whenever the file changes, checking every pollMs milliseconds
+//returns 0 on success and -1 if the thread couldn't be started
+int live_catalog_watch(live_catalog_t *live, const char *filename, unsigned int pollMs);
+
+//stops the watcher thread, if one is running, and waits for it
+void live_catalog_stop(live_catalog_t *live);
+
+//stops the watcher and frees every version, no thread may be inside a read section
+void live_catalog_free(live_catalog_t *live);
+
+#endif /* LIVE_CATALOG_H */
@@ -0,0 +1,349 @@
+/*
+Entry point of the furniture catalog system: loads the catalog and the saved orders, then either runs the
+interactive menu or one of the command line modes (--convert, --export, --batch, --serve). With --watch in front
+of the others the catalog file is reloaded whenever it changes, without stopping order intake.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "catalog_system.h"
+#include "snapshot.h"
+#include "journal.h"
+#include "batch.h"
+#include "stats.h"
+#include "report.h"
+#include "live_catalog.h"
+#include "protocol.h"
+#include "server.h"
+#include "inventory.h"
+#include "archive.h"
+#ifdef CATALOG_GENERATED
+#include "catalog_loader.h"
+#include "catalog_generated.h"
+#endif
+
+//whether a file exists and can be read
+static int file_exists(const char *filename) 
+{
+    FILE *file = fopen(filename, "r");
+
+    if (file) 
+    {
+        fclose(file);
+    }
+
+    return file != NULL;
+}
+
+//loads the snapshot, exits when it's there but can't be read: the text file is older and the journal only
+//holds what came after the snapshot, so starting from them would lose orders
+static long long load_snapshot_or_exit(order_list_t *orders) 
+{
+    long long loaded = load_snapshot(orders, CUSTOMER_SNAPSHOT_FILE);
+
+    if (loaded < 0) 
+    {
+        printf("%s can't be read, it was left as it is along with %s.\n", CUSTOMER_SNAPSHOT_FILE, CUSTOMER_JOURNAL_FILE);
+        printf("If an older build wrote it, run --export with that build and --convert the text files.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return loaded;
+}
+
+//loads the snapshot (or the text file when it's newer) and opens the journal on top of it
+static void load_orders(order_list_t *orders, journal_t *journal) 
+{
+    //load customer information, from the binary snapshot when it's up to date and the text file otherwise
+    if (snapshot_is_current(CUSTOMER_SNAPSHOT_FILE, CUSTOMER_FILE)) 
+    {
+        long long loaded = load_snapshot_or_exit(orders);
+
+        printf("Loaded %lld line items from %s\n", loaded, CUSTOMER_SNAPSHOT_FILE);
+    } else if (file_exists(CUSTOMER_FILE)) 
+    {
+        load_customer_information(orders, CUSTOMER_FILE);
+        load_customer_returns(orders, CUSTOMER_RETURNS_FILE);
+
+        //the text file is newer than the snapshot (or there is none), it replaces whatever was journaled,
+        //so start the snapshot and journal over from it
+        remove(CUSTOMER_JOURNAL_FILE);
+        open_journal(journal, orders, CUSTOMER_JOURNAL_FILE, CUSTOMER_SNAPSHOT_FILE);
+        compact_journal(journal);
+        return;
+    }
+
+    //then replay whatever was journaled after the snapshot was written (everything, before there is one)
+    long long replayed = open_journal(journal, orders, CUSTOMER_JOURNAL_FILE, CUSTOMER_SNAPSHOT_FILE);
+
+    if (replayed > 0) 
+    {
+        printf("Replayed %lld changes from %s\n", replayed, CUSTOMER_JOURNAL_FILE);
+    }
+}
+
+int main(int argc, char *argv[]) 
+{
+    //'--watch' reloads the catalog whenever its file changes, the rest of the command line is read as usual
+    int watch = argc > 1 && strcmp(argv[1], "--watch") == 0;
+
+    if (watch) 
+    {
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
+
+    //'--convert [text file] [snapshot file] [returns file]' turns the text order and returns files into a binary snapshot and exits
+    if (argc > 1 && strcmp(argv[1], "--convert") == 0) 
+    {
+        const char *textFilename = argc > 2 ? argv[2] : CUSTOMER_FILE;
+        const char *snapshotFilename = argc > 3 ? argv[3] : CUSTOMER_SNAPSHOT_FILE;
+        const char *returnsFilename = argc > 4 ? argv[4] : CUSTOMER_RETURNS_FILE;
+
+        return convert_customer_information(textFilename, returnsFilename, snapshotFilename) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    //'--export [text file] [returns file]' writes the sealed days, the snapshot and the journal out as text order and returns files and exits
+    if (argc > 1 && strcmp(argv[1], "--export") == 0) 
+    {
+        order_list_t *orders = create_orders();
+        journal_t journal;
+        archive_t archive;
+
+        if (file_exists(CUSTOMER_SNAPSHOT_FILE)) 
+        {
+            load_snapshot_or_exit(orders);
+        }
+
+        open_journal(&journal, orders, CUSTOMER_JOURNAL_FILE, CUSTOMER_SNAPSHOT_FILE);
+        close_journal(&journal);
+
+        open_archive(&archive, ARCHIVE_DIRECTORY);
+        orders->archive = &archive;
+
+        save_customer_information(orders, argc > 2 ? argv[2] : CUSTOMER_FILE);
+        save_customer_returns(orders, argc > 3 ? argv[3] : CUSTOMER_RETURNS_FILE);
+        free_orders(orders);
+        close_archive(&archive);
+
+        return EXIT_SUCCESS;
+    }
+
+    //'--serve [socket]' answers clients on a Unix domain socket until SIGINT or SIGTERM
+    int serve = argc > 1 && strcmp(argv[1], "--serve") == 0;
+
+    //'--batch' prints placed order numbers on stdout for scripts, so everything said while starting up goes to stderr
+    int batch = argc > 1 && strcmp(argv[1], "--batch") == 0;
+    int batchOutput = -1;
+
+    if (batch) 
+    {
+        fflush(stdout);
+        batchOutput = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+
+    //the server takes its shutdown signals from its event loop, so no other thread may catch them
+    if (serve) 
+    {
+        server_block_signals();
+    }
+
+    //initialize the orders
+    order_list_t *orders = create_orders();
+
+    //continue numbering orders where the last run stopped
+    load_order_sequence(&orders->sequence, "order_sequence.txt");
+
+#ifdef CATALOG_GENERATED
+    //the catalog compiled into the binary is used as it is, unless the file no longer holds what it was generated from
+    catalog_t *furnitureCatalog = &generatedCatalog;
+
+    if (catalog_file_changed(CATALOG_FILE, generatedCatalogHash)) 
+    {
+        printf("%s has changed since the built-in catalog was generated, loading it instead.\n", CATALOG_FILE);
+        furnitureCatalog = create_catalog();
+        load_catalog_from_file(furnitureCatalog, CATALOG_FILE);
+    }
+#else
+    //load existing records from the file (if any)
+    catalog_t *furnitureCatalog = create_catalog();
+    load_catalog_from_file(furnitureCatalog, CATALOG_FILE);
+#endif
+
+    //from here on the catalog is only reached through the live catalog, which a reload swaps out
+    live_catalog_t liveCatalog;
+    live_catalog_init(&liveCatalog, furnitureCatalog);
+
+    //line items take their category IDs from the newest catalog as they are stored
+    orders->liveCatalog = &liveCatalog;
+
+    if (watch && live_catalog_watch(&liveCatalog, CATALOG_FILE, LIVE_CATALOG_POLL_MS) != 0) 
+    {
+        printf("Could not start watching %s, the catalog won't be reloaded.\n", CATALOG_FILE);
+    }
+
+    //load customer information and replay the journal
+    journal_t journal;
+    load_orders(orders, &journal);
+
+    //orders placed before the hot window go to the segments of their days, then leave the journal too
+    archive_t archive;
+    open_archive(&archive, ARCHIVE_DIRECTORY);
+
+    long long sealed = seal_archive(&archive, orders, day_of((unsigned int)time(NULL)) - ARCHIVE_HOT_DAYS + 1);
+
+    if (sealed > 0) 
+    {
+        printf("Sealed %lld line items older than %d days into %s\n", sealed, ARCHIVE_HOT_DAYS, ARCHIVE_DIRECTORY);
+        compact_journal(&journal);
+    } else if (sealed < 0) 
+    {
+        printf("Could not seal old orders into %s, they stay in memory.\n", ARCHIVE_DIRECTORY);
+    }
+
+    orders->archive = &archive;
+
+    //stock is what the inventory file lists less what the loaded orders kept, from here on orders reserve it
+    orders->inventory = load_inventory(INVENTORY_FILE, orders);
+
+    if (orders->inventory != NULL) 
+    {
+        printf("Loaded stock levels of %zu products from %s\n", orders->inventory->count, INVENTORY_FILE);
+    }
+
+    //'--batch [file]' applies order and return records from the file (or stdin) without prompts and exits
+    if (batch) 
+    {
+        FILE *input = argc > 2 && strcmp(argv[2], "-") != 0 ? fopen(argv[2], "r") : stdin;
+
+        if (!input) 
+        {
+            printf("Error opening file: %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+
+        //stdout is the caller's again for the order numbers
+        fflush(stdout);
+        dup2(batchOutput, STDOUT_FILENO);
+        close(batchOutput);
+
+        //the journal is synced once at the end rather than after every group commit
+        atomic_store(&journal.syncPolicy, JOURNAL_SYNC_FLUSH);
+
+        batch_result_t result = run_batch(input, orders, &liveCatalog, stdout, stderr);
+
+        fprintf(stderr, "%zu records: %zu orders placed (%zu line items), %zu returns, %zu rejected\n",
+                result.records, result.ordersPlaced, result.lineItems, result.returns, result.errors);
+
+        if (input != stdin) 
+        {
+            fclose(input);
+        }
+
+        close_journal(&journal);
+        live_catalog_free(&liveCatalog);
+        free_orders(orders);
+        close_archive(&archive);
+        stats_dump(STATS_FILE);
+
+        return result.errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (serve) 
+    {
+        server_result_t result;
+        int status = run_server(argc > 2 ? argv[2] : PROTOCOL_SOCKET, orders, &liveCatalog, &result);
+
+        printf("%zu requests from %zu clients, %zu rejected\n", result.requests, result.connections, result.rejected);
+
+        //every answered request is already journaled, closing the journal syncs it
+        close_journal(&journal);
+        live_catalog_free(&liveCatalog);
+        free_orders(orders);
+        close_archive(&archive);
+        stats_dump(STATS_FILE);
+
+        return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    //display the main menu
+    int choice = 0;
+
+    do 
+    {
+        printf("\n-----Furniture Catalog System-----\n");
+        printf(" +   1. Display Catalog          +\n");
+        printf(" +   2. Place Order              +\n");
+        printf(" +   3. Display Current Orders   +\n");
+        printf(" +   4. Process Return           +\n");
+        printf(" +   5. Display Returns          +\n");
+        printf(" +   6. Quit                     +\n");
+        printf(" +   7. Statistics               +\n");
+        printf(" +   8. Sales Report             +\n");
+        printf("----------------------------------\n");
+
+        printf("Enter your choice: ");
+        scanf("%d", &choice);
+
+        // Clear the input buffer
+        while (getchar() != '\n');
+
+        //each choice works with the catalog as it was published when the choice was made
+        const catalog_t *catalog = live_catalog_acquire(&liveCatalog);
+
+        switch (choice) 
+        {
+            case 1:
+                display_catalog(catalog);
+                break;
+            case 2:
+                place_order(orders, catalog);
+                break;
+            case 3:
+                display_orders(orders, catalog);
+                break;
+            case 4:
+                process_return(orders);
+                break;
+            case 5:
+                display_returns(orders, catalog);
+                break;
+            case 6:
+                quit_program();
+                break;
+            case 7:
+                printf("\n");
+                stats_print(stdout);
+                break;
+            case 8:
+            {
+                sales_report_t report;
+                build_sales_report(&report, orders, catalog);
+                print_sales_report(stdout, &report, catalog);
+                free_sales_report(&report);
+                break;
+            }
+            default:
+                printf("Invalid choice. Please enter a number between 1 and 8.\n");
+        }
+
+        live_catalog_release(&liveCatalog);
+
+    } while (choice != 6);
+
+    //every change is already in the journal, quitting only closes it
+    close_journal(&journal);
+    live_catalog_free(&liveCatalog);
+    free_orders(orders);
+    close_archive(&archive);
+    stats_dump(STATS_FILE);
+
+    return 0;
+}
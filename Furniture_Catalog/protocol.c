@@ -0,0 +1,217 @@
+/*
+Framing and field encoding of the request protocol spoken over the catalog server's Unix socket (see
+protocol.h for the messages). Shared by the server and catalog_client.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "protocol.h"
+
+void protocol_buffer_init(protocol_buffer_t *buffer) 
+{
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+}
+
+void protocol_buffer_free(protocol_buffer_t *buffer) 
+{
+    free(buffer->data);
+    protocol_buffer_init(buffer);
+}
+
+//appends raw bytes, growing the buffer by doubling
+static void put_bytes(protocol_buffer_t *buffer, const void *bytes, size_t count) 
+{
+    if (count == 0) 
+    {
+        return;
+    }
+
+    if (buffer->size + count > buffer->capacity) 
+    {
+        size_t capacity = buffer->capacity == 0 ? 256 : buffer->capacity;
+        while (capacity < buffer->size + count) 
+        {
+            capacity *= 2;
+        }
+
+        unsigned char *data = (unsigned char *)realloc(buffer->data, capacity);
+
+        if (!data) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+
+    memcpy(buffer->data + buffer->size, bytes, count);
+    buffer->size += count;
+}
+
+size_t protocol_begin_frame(protocol_buffer_t *buffer, uint8_t type) 
+{
+    size_t start = buffer->size;
+    uint32_t length = 0;
+
+    put_bytes(buffer, &length, sizeof(length));
+    put_bytes(buffer, &type, sizeof(type));
+
+    return start;
+}
+
+void protocol_end_frame(protocol_buffer_t *buffer, size_t start) 
+{
+    uint32_t length = (uint32_t)(buffer->size - start);
+    memcpy(buffer->data + start, &length, sizeof(length));
+}
+
+void protocol_put_u8(protocol_buffer_t *buffer, uint8_t value) 
+{
+    put_bytes(buffer, &value, sizeof(value));
+}
+
+void protocol_put_u16(protocol_buffer_t *buffer, uint16_t value) 
+{
+    put_bytes(buffer, &value, sizeof(value));
+}
+
+void protocol_put_u32(protocol_buffer_t *buffer, uint32_t value) 
+{
+    put_bytes(buffer, &value, sizeof(value));
+}
+
+void protocol_put_i32(protocol_buffer_t *buffer, int32_t value) 
+{
+    put_bytes(buffer, &value, sizeof(value));
+}
+
+void protocol_put_string(protocol_buffer_t *buffer, const char *text) 
+{
+    size_t length = strlen(text);
+    uint8_t shortLength = (uint8_t)(length > 255 ? 255 : length);
+
+    put_bytes(buffer, &shortLength, sizeof(shortLength));
+    put_bytes(buffer, text, shortLength);
+}
+
+void protocol_put_text(protocol_buffer_t *buffer, const char *text, size_t length) 
+{
+    uint32_t longLength = (uint32_t)length;
+
+    put_bytes(buffer, &longLength, sizeof(longLength));
+    put_bytes(buffer, text, length);
+}
+
+void protocol_put_bytes(protocol_buffer_t *buffer, const void *bytes, size_t count) 
+{
+    put_bytes(buffer, bytes, count);
+}
+
+size_t protocol_frame_length(const unsigned char *data, size_t size) 
+{
+    uint32_t length;
+
+    if (size < sizeof(length)) 
+    {
+        return 0;
+    }
+
+    memcpy(&length, data, sizeof(length));
+
+    //a frame holds at least its type or status byte
+    if (length <= sizeof(length) || length > PROTOCOL_MAX_FRAME) 
+    {
+        return (size_t)-1;
+    }
+
+    return size >= length ? length : 0;
+}
+
+void protocol_reader_init(protocol_reader_t *reader, const unsigned char *data, size_t length) 
+{
+    reader->data = data;
+    reader->size = length;
+    reader->position = sizeof(uint32_t);
+    reader->failed = 0;
+}
+
+//copies the next count bytes out of the frame, or zeroes them and fails if the frame is too short
+static void get_bytes(protocol_reader_t *reader, void *bytes, size_t count) 
+{
+    if (reader->failed || reader->size - reader->position < count) 
+    {
+        reader->failed = 1;
+        memset(bytes, 0, count);
+        return;
+    }
+
+    memcpy(bytes, reader->data + reader->position, count);
+    reader->position += count;
+}
+
+uint8_t protocol_get_u8(protocol_reader_t *reader) 
+{
+    uint8_t value;
+    get_bytes(reader, &value, sizeof(value));
+    return value;
+}
+
+uint16_t protocol_get_u16(protocol_reader_t *reader) 
+{
+    uint16_t value;
+    get_bytes(reader, &value, sizeof(value));
+    return value;
+}
+
+uint32_t protocol_get_u32(protocol_reader_t *reader) 
+{
+    uint32_t value;
+    get_bytes(reader, &value, sizeof(value));
+    return value;
+}
+
+int32_t protocol_get_i32(protocol_reader_t *reader) 
+{
+    int32_t value;
+    get_bytes(reader, &value, sizeof(value));
+    return value;
+}
+
+void protocol_get_string(protocol_reader_t *reader, char *text, size_t size) 
+{
+    uint8_t length = protocol_get_u8(reader);
+
+    if (reader->failed || length >= size || reader->size - reader->position < length) 
+    {
+        reader->failed = 1;
+        text[0] = '\0';
+        return;
+    }
+
+    memcpy(text, reader->data + reader->position, length);
+    text[length] = '\0';
+    reader->position += length;
+}
+
+const char *protocol_get_text(protocol_reader_t *reader, size_t *length) 
+{
+    uint32_t textLength = protocol_get_u32(reader);
+
+    if (reader->failed || reader->size - reader->position < textLength) 
+    {
+        reader->failed = 1;
+        *length = 0;
+        return "";
+    }
+
+    const char *text = (const char *)(reader->data + reader->position);
+    reader->position += textLength;
+    *length = textLength;
+
+    return text;
+}
@@ -0,0 +1,106 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*request protocol between the catalog server (--serve) and its clients over a Unix domain socket
+every message is a frame: a uint32_t length, then that many bytes starting with the request type (or
+the reply status). Numbers are in the host's byte order, both ends run on the same machine. Strings
+are a uint8_t length and that many bytes, texts (listings) a uint32_t length and that many bytes.
+Requests on one connection are answered in order, so a client may send several before reading.
+
+PROTOCOL_PLACE   customer string, uint16_t item count, count x (int32_t product number, int32_t quantity)
+                 -> order number string, uint16_t line items stored
+PROTOCOL_RETURN  order number string, int32_t product number (0 for the whole order), int32_t quantity
+                 -> uint32_t line items returned (whole order) or units returned
+PROTOCOL_PRODUCT int32_t product number -> product name string, category name string
+PROTOCOL_ORDER   order number string -> customer string, uint16_t count, count x (int32_t product number,
+                 int32_t quantity, int32_t returned quantity)
+PROTOCOL_LIST    uint8_t listing (PROTOCOL_LIST_ values), uint8_t filter kind (filter_kind_t), int32_t number,
+                 text string, uint32_t rows to skip, uint16_t rows -> uint8_t 1 if there are more, listing text
+a reply whose status isn't PROTOCOL_OK carries a message string instead*/
+
+#define PROTOCOL_SOCKET "catalog.sock"    //default socket path, next to the data files
+#define PROTOCOL_MAX_FRAME (64 * 1024)    //longest frame either side accepts, length included
+#define PROTOCOL_MAX_ITEMS 1024           //line items one place request may carry
+
+//request types
+#define PROTOCOL_PLACE 1
+#define PROTOCOL_RETURN 2
+#define PROTOCOL_PRODUCT 3
+#define PROTOCOL_ORDER 4
+#define PROTOCOL_LIST 5
+
+//reply statuses
+#define PROTOCOL_OK 0
+#define PROTOCOL_NOT_FOUND 1 //no such product, order or line item
+#define PROTOCOL_INVALID 2   //malformed or rejected request
+#define PROTOCOL_OUT_OF_STOCK 3 //an order asked for more of a product than is left, nothing was placed
+#define PROTOCOL_FAILED 4       //the server couldn't make the change durable, it isn't confirmed
+
+//what a list request lists
+#define PROTOCOL_LIST_ORDERS 0
+#define PROTOCOL_LIST_RETURNS 1
+#define PROTOCOL_LIST_CATALOG 2
+
+//a growable byte buffer frames are built in
+typedef struct {
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+} protocol_buffer_t;
+
+//reads fields off a received frame, failed is set (and stays set) once a field runs past the end
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    size_t position;
+    int failed;
+} protocol_reader_t;
+
+//function declarations
+
+//starts an empty buffer
+void protocol_buffer_init(protocol_buffer_t *buffer);
+
+//frees the memory allocated for the buffer
+void protocol_buffer_free(protocol_buffer_t *buffer);
+
+//starts a frame with its type or status byte, returns where its length goes for protocol_end_frame
+size_t protocol_begin_frame(protocol_buffer_t *buffer, uint8_t type);
+
+//fills in the length of the frame started at start
+void protocol_end_frame(protocol_buffer_t *buffer, size_t start);
+
+//appends fields to the frame being built, strings longer than 255 bytes are cut short
+void protocol_put_u8(protocol_buffer_t *buffer, uint8_t value);
+void protocol_put_u16(protocol_buffer_t *buffer, uint16_t value);
+void protocol_put_u32(protocol_buffer_t *buffer, uint32_t value);
+void protocol_put_i32(protocol_buffer_t *buffer, int32_t value);
+void protocol_put_string(protocol_buffer_t *buffer, const char *text);
+void protocol_put_text(protocol_buffer_t *buffer, const char *text, size_t length);
+
+//appends bytes as they are, such as frames that were already built
+void protocol_put_bytes(protocol_buffer_t *buffer, const void *bytes, size_t count);
+
+//length of the complete frame at the start of data (length field included), 0 if it hasn't all arrived
+//and (size_t)-1 if its length is impossible
+size_t protocol_frame_length(const unsigned char *data, size_t size);
+
+//starts reading the frame at data, whose complete length is length, just past its length field
+void protocol_reader_init(protocol_reader_t *reader, const unsigned char *data, size_t length);
+
+//read fields in the order they were put, a field that doesn't fit reads as 0 (or "") and sets failed
+uint8_t protocol_get_u8(protocol_reader_t *reader);
+uint16_t protocol_get_u16(protocol_reader_t *reader);
+uint32_t protocol_get_u32(protocol_reader_t *reader);
+int32_t protocol_get_i32(protocol_reader_t *reader);
+
+//copies a string into text (size bytes, always terminated), a string that doesn't fit sets failed
+void protocol_get_string(protocol_reader_t *reader, char *text, size_t size);
+
+//points at a text field without copying it, stores its length
+const char *protocol_get_text(protocol_reader_t *reader, size_t *length);
+
+#endif /* PROTOCOL_H */
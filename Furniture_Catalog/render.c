@@ -0,0 +1,548 @@
+/*
+Rendering layer for the catalog and order listings. Rows are formatted into one growing buffer and written
+with a single fwrite per page. Filtered listings walk the order number, customer, product and category
+indexes, so a page costs what it shows rather than what the store holds.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include "render.h"
+#include "archive.h"
+
+void render_init(render_buffer_t *buffer) 
+{
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+}
+
+//makes room for at least extra more bytes plus the terminator
+static void reserve_buffer(render_buffer_t *buffer, size_t extra) 
+{
+    if (buffer->size + extra + 1 <= buffer->capacity) 
+    {
+        return;
+    }
+
+    size_t capacity = buffer->capacity == 0 ? 16384 : buffer->capacity;
+    while (capacity < buffer->size + extra + 1) 
+    {
+        capacity *= 2;
+    }
+
+    char *data = (char *)realloc(buffer->data, capacity);
+
+    if (!data) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    buffer->data = data;
+    buffer->capacity = capacity;
+}
+
+void render_printf(render_buffer_t *buffer, const char *format, ...) 
+{
+    va_list arguments;
+
+    //most rows fit in the space that's already there, so try formatting in place first
+    reserve_buffer(buffer, 256);
+
+    va_start(arguments, format);
+    int length = vsnprintf(buffer->data + buffer->size, buffer->capacity - buffer->size, format, arguments);
+    va_end(arguments);
+
+    if (length < 0) 
+    {
+        return;
+    }
+
+    if ((size_t)length >= buffer->capacity - buffer->size) 
+    {
+        reserve_buffer(buffer, (size_t)length);
+
+        va_start(arguments, format);
+        vsnprintf(buffer->data + buffer->size, buffer->capacity - buffer->size, format, arguments);
+        va_end(arguments);
+    }
+
+    buffer->size += (size_t)length;
+}
+
+void render_flush(render_buffer_t *buffer, FILE *file) 
+{
+    if (buffer->size > 0) 
+    {
+        fwrite(buffer->data, 1, buffer->size, file);
+        fflush(file);
+    }
+
+    buffer->size = 0;
+}
+
+void render_free(render_buffer_t *buffer) 
+{
+    free(buffer->data);
+    render_init(buffer);
+}
+
+int parse_date_range(const char *text, long *firstDay, long *lastDay) 
+{
+    char first[MAX_DATE + 1];
+    char last[MAX_DATE + 1];
+    char rest;
+
+    //a single day is a range of one
+    switch (sscanf(text, " %11s %11s %c", first, last, &rest)) 
+    {
+        case 1:
+            return parse_day(first, firstDay) && parse_day(first, lastDay);
+        case 2:
+            return parse_day(first, firstDay) && parse_day(last, lastDay) && *firstDay <= *lastDay;
+        default:
+            return 0;
+    }
+}
+
+//whether a line item was placed within a range of days, one placed at an unknown time never is
+static int placed_within(const order_t *order, long firstDay, long lastDay) 
+{
+    return order->placedAt != 0 && day_of(order->placedAt) >= firstDay && day_of(order->placedAt) <= lastDay;
+}
+
+//checks whether an item belongs in the listing, returns come from the ledger where every entry does
+//and current orders leave out line items with nothing left
+static int wanted(const order_t *order, const render_filter_t *filter) 
+{
+    return filter->returned || !order->isReturn;
+}
+
+//moves the cursor to the next wanted item of an index list and copies it, returns 0 if the list has none left
+static int scan_list(order_t *const *items, size_t count, const render_filter_t *filter, render_cursor_t *cursor, order_t *row) 
+{
+    for (; cursor->position < count; cursor->position++) 
+    {
+        if (wanted(items[cursor->position], filter)) 
+        {
+            *row = *items[cursor->position];
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+//walks one customer's (or, with a negative customer ID, one product's) lists shard by shard
+static int scan_shards(const order_list_t *orders, const render_filter_t *filter, long long customerId,
+                       int productNumber, render_cursor_t *cursor, order_t *row) 
+{
+    for (; cursor->shard < ORDER_SHARDS; cursor->shard++, cursor->position = 0) 
+    {
+        order_shard_t *shard = (order_shard_t *)&orders->shards[cursor->shard];
+        int found = 0;
+
+        pthread_mutex_lock(&shard->lock);
+
+        //returns are listed from the ledger's own indexes
+        if (customerId >= 0) 
+        {
+            unsigned int id = (unsigned int)customerId;
+            const order_entry_t *entry = filter->returned ? shard_find_customer_returns(shard, id) : shard_find_customer(shard, id);
+            found = entry != NULL && scan_list(entry->items, entry->count, filter, cursor, row);
+        } else {
+            const product_orders_t *entry = filter->returned ? shard_find_product_returns(shard, productNumber) : shard_find_product(shard, productNumber);
+            found = entry != NULL && scan_list(entry->items, entry->count, filter, cursor, row);
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+
+        if (found) 
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+//walks the stores chunk by chunk, shard by shard, for listings without a filter or by date
+static int scan_stores(const order_list_t *orders, const render_filter_t *filter, long firstDay, long lastDay,
+                       render_cursor_t *cursor, order_t *row) 
+{
+    for (; cursor->shard < ORDER_SHARDS; cursor->shard++, cursor->chunk = NULL, cursor->position = 0) 
+    {
+        order_shard_t *shard = (order_shard_t *)&orders->shards[cursor->shard];
+
+        pthread_mutex_lock(&shard->lock);
+
+        //returns are listed from their own store, in the order they were processed
+        const order_store_t *store = filter->returned ? &shard->returns.entries : &shard->current;
+
+        if (cursor->chunk == NULL) 
+        {
+            cursor->chunk = store->head;
+        }
+
+        while (cursor->chunk != NULL) 
+        {
+            for (; cursor->position < cursor->chunk->count; cursor->position++) 
+            {
+                const order_t *order = &cursor->chunk->orders[cursor->position];
+
+                if (wanted(order, filter) && (filter->kind != FILTER_DATE || placed_within(order, firstDay, lastDay))) 
+                {
+                    *row = *order;
+                    pthread_mutex_unlock(&shard->lock);
+                    return 1;
+                }
+            }
+
+            if (cursor->chunk->next == NULL) 
+            {
+                break;
+            }
+
+            cursor->chunk = cursor->chunk->next;
+            cursor->position = 0;
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return 0;
+}
+
+//walks the sealed days from firstDay to lastDay, each one is only held while its next row is copied
+//returns 0 once the days are done, with the cursor ready for the line items still in memory
+static int scan_archive_days(const order_list_t *orders, const render_filter_t *filter, long firstDay, long lastDay,
+                             render_cursor_t *cursor, order_t *row) 
+{
+    archive_t *archive = orders->archive;
+
+    if (archive == NULL) 
+    {
+        return 0;
+    }
+
+    for (size_t index = archive_find_day(archive, firstDay) + cursor->source;
+         index < archive->count && archive->segments[index].day <= lastDay; index++, cursor->source++, cursor->position = 0) {
+        //sealed customers are interned into the orders' pool so the rows render like the rest
+        const archive_segment_t *segment = archive_acquire(archive, (order_list_t *)orders, index);
+
+        if (segment == NULL) 
+        {
+            continue;
+        }
+
+        const order_t *items = filter->returned ? segment->returns : segment->items;
+        size_t count = filter->returned ? segment->returnCount : segment->itemCount;
+
+        for (; cursor->position < count; cursor->position++) 
+        {
+            if (wanted(&items[cursor->position], filter)) 
+            {
+                *row = items[cursor->position];
+                archive_release(archive, index);
+                return 1;
+            }
+        }
+
+        archive_release(archive, index);
+    }
+
+    return 0;
+}
+
+//walks the line items (or returns) of one order through the sealed days whose order numbers may include it
+static int scan_sealed_order(const order_list_t *orders, const render_filter_t *filter, order_id_t orderId,
+                             render_cursor_t *cursor, order_t *row) 
+{
+    archive_t *archive = orders->archive;
+
+    if (archive == NULL) 
+    {
+        return 0;
+    }
+
+    for (size_t index = archive_find_order(archive, orderId, cursor->source); index < archive->count;
+         index = archive_find_order(archive, orderId, index + 1), cursor->position = 0) {
+        cursor->source = index;
+
+        const archive_segment_t *segment = archive_acquire(archive, (order_list_t *)orders, index);
+
+        if (segment == NULL) 
+        {
+            continue;
+        }
+
+        const order_t *items = filter->returned ? segment->returns : segment->items;
+        size_t count = filter->returned ? segment->returnCount : segment->itemCount;
+
+        for (; cursor->position < count; cursor->position++) 
+        {
+            if (items[cursor->position].orderId == orderId && wanted(&items[cursor->position], filter)) 
+            {
+                *row = items[cursor->position];
+                archive_release(archive, index);
+                return 1;
+            }
+        }
+
+        archive_release(archive, index);
+    }
+
+    return 0;
+}
+
+//moves the cursor to the next line item of the listing without passing it, returns 0 and marks the cursor done at the end
+//key is the filter's order or customer ID (or first day), resolved once per page, lastKey the last day of a date filter
+static int find_next_order(const order_list_t *orders, const catalog_t *catalog, const render_filter_t *filter,
+                           long long key, long long lastKey, render_cursor_t *cursor, order_t *row) 
+{
+    int found = 0;
+
+    if (cursor->done) 
+    {
+        return 0;
+    }
+
+    switch (filter->kind) 
+    {
+        case FILTER_ORDER_NUMBER: 
+        {
+            //every line item of an order lives in one shard
+            order_id_t orderId = (order_id_t)key;
+            order_shard_t *shard = order_shard(orders, orderId);
+
+            pthread_mutex_lock(&shard->lock);
+            const order_entry_t *entry = filter->returned ? shard_find_order_returns(shard, orderId) : shard_find_order(shard, orderId);
+            int inMemory = shard_find_order(shard, orderId) != NULL;
+            found = entry != NULL && scan_list(entry->items, entry->count, filter, cursor, row);
+            pthread_mutex_unlock(&shard->lock);
+
+            //an order that isn't in memory any more is in one of the sealed days
+            if (!inMemory) 
+            {
+                found = scan_sealed_order(orders, filter, orderId, cursor, row);
+            }
+            break;
+        }
+        case FILTER_CUSTOMER:
+            found = scan_shards(orders, filter, key, 0, cursor, row);
+            break;
+        case FILTER_PRODUCT:
+            found = scan_shards(orders, filter, -1, filter->number, cursor, row);
+            break;
+        case FILTER_CATEGORY: 
+        {
+            //the category's products from the range index, then each product's line items
+            size_t count;
+            const product_t *products = products_in_category(catalog, filter->number, &count);
+
+            for (; cursor->source < count; cursor->source++, cursor->shard = 0, cursor->position = 0) 
+            {
+                if (scan_shards(orders, filter, -1, products[cursor->source].productNumber, cursor, row)) 
+                {
+                    found = 1;
+                    break;
+                }
+            }
+            break;
+        }
+        case FILTER_DATE:
+            //the shard, chunk and position are still at the start while the sealed days are listed
+            found = scan_archive_days(orders, filter, (long)key, (long)lastKey, cursor, row) ||
+                    scan_stores(orders, filter, (long)key, (long)lastKey, cursor, row);
+            break;
+        default:
+            found = scan_stores(orders, filter, 0, 0, cursor, row);
+            break;
+    }
+
+    if (!found) 
+    {
+        cursor->done = 1;
+    }
+
+    return found;
+}
+
+size_t render_orders(render_buffer_t *buffer, const order_list_t *orders, const catalog_t *catalog,
+                     const render_filter_t *filter, render_cursor_t *cursor, size_t pageSize) 
+{
+    order_id_t orderId = 0;
+    unsigned int customerId = 0;
+    char orderNumber[MAX_ORDER_NUMBER];
+    char placed[MAX_DATE];
+    long long key = 0;
+    long firstDay = 0;
+    long lastDay = 0;
+    size_t rows = 0;
+    order_t row;
+
+    //the filter text becomes an ID once, a name or number that was never seen matches nothing
+    if (filter->kind == FILTER_CUSTOMER) 
+    {
+        key = find_customer(&orders->customers, filter->text);
+    } else if (filter->kind == FILTER_ORDER_NUMBER) 
+    {
+        key = parse_order_number(filter->text, &orderId) ? (long long)orderId : -1;
+    } else if (filter->kind == FILTER_DATE) 
+    {
+        //nothing was placed before 1970, which keeps the first day usable as a key
+        key = parse_date_range(filter->text, &firstDay, &lastDay) ? (firstDay < 0 ? 0 : firstDay) : -1;
+    }
+
+    if (key < 0) 
+    {
+        cursor->done = 1;
+    }
+
+    while (rows < pageSize && find_next_order(orders, catalog, filter, key, lastDay, cursor, &row)) 
+    {
+        //with no buffer the rows are only skipped
+        if (buffer == NULL) 
+        {
+            cursor->position++;
+            rows++;
+            continue;
+        }
+
+        format_order_number(row.orderId, orderNumber);
+
+        //orders from before placement times were kept don't show one
+        if (row.placedAt != 0) 
+        {
+            format_day(day_of(row.placedAt), placed);
+        }
+
+        if (filter->returned) 
+        {
+            render_printf(buffer, "Customer: %s | Product Number: %d | Quantity: %d | Order Number: %s%s%s\n",
+                          customer_name(&orders->customers, row.customerId), row.productNumber, row.quantity, orderNumber,
+                          row.placedAt != 0 ? " | Placed: " : "", row.placedAt != 0 ? placed : "");
+        } else {
+            //print the heading only when the customer or order number changes, and at the top of every page
+            if (rows == 0 || row.customerId != customerId || row.orderId != orderId) 
+            {
+                render_printf(buffer, "Customer: %s (Order No. %s%s%s)\n", customer_name(&orders->customers, row.customerId), orderNumber,
+                              row.placedAt != 0 ? ", placed " : "", row.placedAt != 0 ? placed : "");
+                customerId = row.customerId;
+                orderId = row.orderId;
+            }
+
+            //a partly returned line item shows what was kept
+            if (row.returnedQuantity > 0) 
+            {
+                render_printf(buffer, " | Product Number: %d | Quantity: %d | Returned: %d |\n",
+                              row.productNumber, row.quantity - row.returnedQuantity, row.returnedQuantity);
+            } else {
+                render_printf(buffer, " | Product Number: %d | Quantity: %d |\n", row.productNumber, row.quantity);
+            }
+        }
+
+        cursor->position++;
+        rows++;
+    }
+
+    //look ahead so the caller knows whether there is another page
+    find_next_order(orders, catalog, filter, key, lastDay, cursor, &row);
+
+    return rows;
+}
+
+//checks whether a product is listed, names with a colon and repeats of the product above it are not
+static int listed(const product_t *products, size_t position) 
+{
+    return strchr(products[position].name, ':') == NULL &&
+           (position == 0 || strcmp(products[position].name, products[position - 1].name) != 0);
+}
+
+//moves the cursor to the next product of the listing without passing it, returns NULL and marks the cursor done at the end
+static const product_t *find_next_product(const catalog_t *catalog, const render_filter_t *filter, render_cursor_t *cursor) 
+{
+    if (cursor->done) 
+    {
+        return NULL;
+    }
+
+    if (filter->kind == FILTER_PRODUCT) 
+    {
+        const product_t *product = find_product(catalog, filter->number);
+
+        if (cursor->position == 0 && product != NULL) 
+        {
+            return product;
+        }
+    } else {
+        //one category, or every category in turn
+        size_t lastCategory = filter->kind == FILTER_CATEGORY ? (size_t)filter->number + 1 : catalog->categoryCount;
+
+        if (filter->kind == FILTER_CATEGORY && cursor->source < (size_t)filter->number) 
+        {
+            cursor->source = (size_t)filter->number;
+        }
+
+        for (; cursor->source < lastCategory && cursor->source < catalog->categoryCount; cursor->source++, cursor->position = 0) 
+        {
+            size_t count;
+            const product_t *products = products_in_category(catalog, (int)cursor->source, &count);
+
+            for (; cursor->position < count; cursor->position++) 
+            {
+                if (listed(products, cursor->position)) 
+                {
+                    return &products[cursor->position];
+                }
+            }
+        }
+    }
+
+    cursor->done = 1;
+    return NULL;
+}
+
+size_t render_catalog(render_buffer_t *buffer, const catalog_t *catalog, const render_filter_t *filter,
+                      render_cursor_t *cursor, size_t pageSize) 
+{
+    size_t rows = 0;
+    int currentCategory = -1;
+    const product_t *product;
+
+    while (rows < pageSize && (product = find_next_product(catalog, filter, cursor)) != NULL) 
+    {
+        if (buffer == NULL) 
+        {
+            cursor->position++;
+            rows++;
+            continue;
+        }
+
+        const char *category = category_name(catalog, product->categoryId);
+
+        //print the category when a new one starts, and at the top of every page
+        //products listed before any heading have no category name to print
+        if (product->categoryId != currentCategory && category[0] != '\0') 
+        {
+            if (rows != 0) 
+            {
+                render_printf(buffer, "\n");  //add a newline before printing a new category
+            }
+            render_printf(buffer, "  %s:\n", category);
+        }
+        currentCategory = product->categoryId;
+
+        render_printf(buffer, "    %s, product no. %d\n", product->name, product->productNumber);
+
+        cursor->position++;
+        rows++;
+    }
+
+    find_next_product(catalog, filter, cursor);
+
+    return rows;
+}
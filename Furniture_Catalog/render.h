@@ -0,0 +1,73 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdio.h>
+#include "catalog_system.h"
+
+#define RENDER_PAGE_SIZE 20 //rows shown before asking for the next page
+
+//text formatted in memory and written out with a single fwrite
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+} render_buffer_t;
+
+//what a listing is narrowed down to, each one is served from an index
+typedef enum {
+    FILTER_NONE,
+    FILTER_CUSTOMER,     //text holds the customer name
+    FILTER_ORDER_NUMBER, //text holds the order number
+    FILTER_PRODUCT,      //number holds the product number
+    FILTER_CATEGORY,     //number holds the category ID
+    FILTER_DATE          //text holds the day the orders were placed ("YYYY-MM-DD") or the first and last day of a range
+} filter_kind_t;
+
+typedef struct {
+    filter_kind_t kind;
+    char text[MAX_NAME];
+    int number;
+    int returned; //1 lists the returns ledger instead of current line items
+} render_filter_t;
+
+//where the next page of a listing starts, zeroed for the first page
+typedef struct {
+    size_t source;              //category, product within the category, or sealed day being listed
+    size_t shard;               //shard being listed
+    size_t position;            //next item within the current list or chunk
+    const order_chunk_t *chunk; //chunk being listed when there is no filter
+    int started;                //0 until the first page has been rendered
+    int done;                   //1 once every row has been rendered
+} render_cursor_t;
+
+//function declarations
+
+//reads a date filter's text into its first and last day, returns 0 if it isn't one or two dates in order
+int parse_date_range(const char *text, long *firstDay, long *lastDay);
+
+//starts an empty buffer
+void render_init(render_buffer_t *buffer);
+
+//formats text onto the end of the buffer, growing it as needed
+void render_printf(render_buffer_t *buffer, const char *format, ...);
+
+//writes the buffer to a file in one go and empties it
+void render_flush(render_buffer_t *buffer, FILE *file);
+
+//frees the memory allocated for the buffer
+void render_free(render_buffer_t *buffer);
+
+//renders up to pageSize line items matching the filter from the cursor on, returns the rows rendered
+//a NULL buffer moves the cursor past the rows without formatting them
+//every shard is locked while it's read, the category filter needs the catalog
+//the date filter lists the sealed days of the orders' archive first, then the line items still in memory
+//the order number filter reads the sealed days that can hold the order when it isn't in memory
+size_t render_orders(render_buffer_t *buffer, const order_list_t *orders, const catalog_t *catalog,
+                     const render_filter_t *filter, render_cursor_t *cursor, size_t pageSize);
+
+//renders up to pageSize products (all of them, one category or one product) from the cursor on, returns the rows rendered
+//a NULL buffer moves the cursor past the rows without formatting them
+size_t render_catalog(render_buffer_t *buffer, const catalog_t *catalog, const render_filter_t *filter,
+                      render_cursor_t *cursor, size_t pageSize);
+
+#endif /* RENDER_H */
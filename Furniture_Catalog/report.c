@@ -0,0 +1,601 @@
+/*
+Sales reporting over the order columns. Every kernel here is a plain loop over one column block: the unit
+sums and key ranges are straight reductions the compiler vectorizes, and the per-product and per-customer
+totals are scatter loops into flat arrays, so no line item or name string is touched. Categories are only
+looked up once per product at the end.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include "report.h"
+#include "render.h"
+#include "archive.h"
+
+//sums kept and returned units over a run of line items
+static void sum_units(const int *restrict quantity, const int *restrict returned, size_t count, sales_total_t *total) 
+{
+    long long kept = 0;
+    long long back = 0;
+
+    //two straight column reads, no branch
+    for (size_t i = 0; i < count; i++) 
+    {
+        back += returned[i];
+        kept += quantity[i] - returned[i];
+    }
+
+    total->kept += kept;
+    total->returned += back;
+}
+
+//widens low and high to cover a run of keys
+static void key_range(const int *restrict key, size_t count, int *low, int *high) 
+{
+    int lowest = *low;
+    int highest = *high;
+
+    for (size_t i = 0; i < count; i++) 
+    {
+        lowest = key[i] < lowest ? key[i] : lowest;
+        highest = key[i] > highest ? key[i] : highest;
+    }
+
+    *low = lowest;
+    *high = highest;
+}
+
+//adds a run of line items' units to the totals of their keys, key k lands at k - base
+static void add_units_by_key(const int *restrict key, long long base, const int *restrict quantity,
+                             const int *restrict returned, size_t count,
+                             long long *restrict kept, long long *restrict back) 
+{
+    for (size_t i = 0; i < count; i++) 
+    {
+        size_t slot = (size_t)(key[i] - base);
+
+        back[slot] += returned[i];
+        kept[slot] += quantity[i] - returned[i];
+    }
+}
+
+//totals by product number for catalogs whose numbers are too far apart for a flat array
+typedef struct {
+    product_sales_t *slots; //empty slots have productNumber INT_MIN
+    size_t capacity;
+    size_t count;
+} product_totals_t;
+
+//finds the slot of a product, or the empty slot where it belongs
+static product_sales_t *product_totals_slot(product_totals_t *totals, int productNumber) 
+{
+    size_t mask = totals->capacity - 1;
+    size_t slot = hash_product_number(productNumber, mask);
+
+    while (totals->slots[slot].productNumber != INT_MIN && totals->slots[slot].productNumber != productNumber) 
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return &totals->slots[slot];
+}
+
+//allocates an empty table for up to count products
+static void init_product_totals(product_totals_t *totals, size_t count) 
+{
+    totals->capacity = 64;
+    while (totals->capacity < count * 2) 
+    {
+        totals->capacity *= 2;
+    }
+    totals->count = 0;
+    totals->slots = (product_sales_t *)malloc(totals->capacity * sizeof(product_sales_t));
+
+    if (!totals->slots) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < totals->capacity; i++) 
+    {
+        totals->slots[i].productNumber = INT_MIN;
+    }
+}
+
+//allocates zeroed memory or exits
+static void *allocate_zeroed(size_t count, size_t size) 
+{
+    void *memory = calloc(count > 0 ? count : 1, size);
+
+    if (!memory) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return memory;
+}
+
+//doubles a product table once it's half full
+static void grow_product_totals(product_totals_t *totals) 
+{
+    product_totals_t grown;
+
+    init_product_totals(&grown, totals->capacity);
+
+    for (size_t i = 0; i < totals->capacity; i++) 
+    {
+        if (totals->slots[i].productNumber != INT_MIN) 
+        {
+            *product_totals_slot(&grown, totals->slots[i].productNumber) = totals->slots[i];
+            grown.count++;
+        }
+    }
+
+    free(totals->slots);
+    *totals = grown;
+}
+
+//grows a pair of kept and returned totals indexed by key until slot fits, the new slots start at zero
+static void reach_slot(long long **kept, long long **back, size_t *slots, size_t slot) 
+{
+    if (slot < *slots) 
+    {
+        return;
+    }
+
+    size_t grown = *slots > 0 ? *slots : 64;
+
+    while (grown <= slot) 
+    {
+        grown *= 2;
+    }
+
+    *kept = (long long *)realloc(*kept, grown * sizeof(long long));
+    *back = (long long *)realloc(*back, grown * sizeof(long long));
+
+    if (!*kept || !*back) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memset(*kept + *slots, 0, (grown - *slots) * sizeof(long long));
+    memset(*back + *slots, 0, (grown - *slots) * sizeof(long long));
+    *slots = grown;
+}
+
+//totals of the line items in sealed days, kept by key as the segments are read since there can be far more of them than keys
+typedef struct {
+    sales_total_t overall;
+    size_t lineItems;
+    product_totals_t products;
+    long long *customerKept; //by customer ID
+    long long *customerReturned;
+    size_t customerSlots;
+    size_t customersSeen;
+} sealed_totals_t;
+
+//adds a sealed line item to the totals, returns ledger entries are already counted in their line items
+static void add_sealed_line_item(void *context, const order_t *order, int isReturnEntry) 
+{
+    sealed_totals_t *sealed = (sealed_totals_t *)context;
+
+    if (isReturnEntry) 
+    {
+        return;
+    }
+
+    long long kept = order->quantity - order->returnedQuantity;
+    long long back = order->returnedQuantity;
+
+    sealed->overall.kept += kept;
+    sealed->overall.returned += back;
+    sealed->lineItems++;
+
+    if (sealed->products.count * 2 >= sealed->products.capacity) 
+    {
+        grow_product_totals(&sealed->products);
+    }
+
+    product_sales_t *total = product_totals_slot(&sealed->products, order->productNumber);
+
+    if (total->productNumber == INT_MIN) 
+    {
+        total->productNumber = order->productNumber;
+        total->total.kept = 0;
+        total->total.returned = 0;
+        sealed->products.count++;
+    }
+
+    total->total.kept += kept;
+    total->total.returned += back;
+
+    reach_slot(&sealed->customerKept, &sealed->customerReturned, &sealed->customerSlots, order->customerId);
+    sealed->customerKept[order->customerId] += kept;
+    sealed->customerReturned[order->customerId] += back;
+    sealed->customersSeen = order->customerId >= sealed->customersSeen ? order->customerId + 1 : sealed->customersSeen;
+}
+
+//reads every sealed day into totals, the customers' names are interned into the order store's pool
+static void total_sealed_days(sealed_totals_t *sealed, const order_list_t *orders) 
+{
+    memset(sealed, 0, sizeof(sealed_totals_t));
+    init_product_totals(&sealed->products, 0);
+
+    if (orders->archive == NULL) 
+    {
+        return;
+    }
+
+    scan_archive(orders->archive, (order_list_t *)orders, add_sealed_line_item, sealed);
+}
+
+static void free_sealed_totals(sealed_totals_t *sealed) 
+{
+    free(sealed->products.slots);
+    free(sealed->customerKept);
+    free(sealed->customerReturned);
+}
+
+static int compare_product_numbers(const void *a, const void *b) 
+{
+    int left = ((const product_sales_t *)a)->productNumber;
+    int right = ((const product_sales_t *)b)->productNumber;
+    return (left > right) - (left < right);
+}
+
+void build_sales_report(sales_report_t *report, const order_list_t *orders, const catalog_t *catalog) 
+{
+    size_t counts[ORDER_SHARDS];
+    int lowProduct = INT_MAX;
+    int highProduct = INT_MIN;
+
+    memset(report, 0, sizeof(sales_report_t));
+
+    //sealed days are totalled by key first, their keys widen the ranges the columns are totalled over
+    sealed_totals_t sealed;
+
+    total_sealed_days(&sealed, orders);
+
+    for (size_t i = 0; i < sealed.products.capacity; i++) 
+    {
+        int productNumber = sealed.products.slots[i].productNumber;
+
+        if (productNumber != INT_MIN) 
+        {
+            lowProduct = productNumber < lowProduct ? productNumber : lowProduct;
+            highProduct = productNumber > highProduct ? productNumber : highProduct;
+        }
+    }
+
+    report->lineItems = sealed.lineItems;
+    report->overall = sealed.overall;
+
+    //first pass: key ranges, and how far each shard's columns reach right now
+    //later line items are left out, and the keys of earlier ones never change, so the ranges hold
+    for (size_t s = 0; s < ORDER_SHARDS; s++) 
+    {
+        order_shard_t *shard = (order_shard_t *)&orders->shards[s];
+        const order_columns_t *columns = &shard->columns;
+
+        pthread_mutex_lock(&shard->lock);
+
+        counts[s] = columns->count;
+
+        for (size_t b = 0; b * ORDER_COLUMN_BLOCK < counts[s]; b++) 
+        {
+            size_t count = counts[s] - b * ORDER_COLUMN_BLOCK < ORDER_COLUMN_BLOCK ? counts[s] - b * ORDER_COLUMN_BLOCK : ORDER_COLUMN_BLOCK;
+
+            key_range(columns->blocks[b]->productNumber, count, &lowProduct, &highProduct);
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+
+        report->lineItems += counts[s];
+    }
+
+    //products are totalled in a flat array over their number range when it's narrow enough
+    long long productSpan = report->lineItems > 0 ? (long long)highProduct - lowProduct + 1 : 0;
+    int flatProducts = productSpan <= REPORT_MAX_PRODUCT_SPAN;
+    long long *productKept = NULL;
+    long long *productReturned = NULL;
+    product_totals_t productTotals = { NULL, 0, 0 };
+
+    if (flatProducts) 
+    {
+        productKept = (long long *)allocate_zeroed((size_t)productSpan, sizeof(long long));
+        productReturned = (long long *)allocate_zeroed((size_t)productSpan, sizeof(long long));
+    } else {
+        init_product_totals(&productTotals, report->lineItems);
+    }
+
+    for (size_t i = 0; i < sealed.products.capacity; i++) 
+    {
+        const product_sales_t *total = &sealed.products.slots[i];
+
+        if (total->productNumber == INT_MIN) 
+        {
+            continue;
+        }
+
+        if (flatProducts) 
+        {
+            productKept[total->productNumber - lowProduct] += total->total.kept;
+            productReturned[total->productNumber - lowProduct] += total->total.returned;
+        } else {
+            *product_totals_slot(&productTotals, total->productNumber) = *total;
+            productTotals.count++;
+        }
+    }
+
+
+    //customer IDs are global, the line items counted above were interned before they were stored
+    size_t customerSlots = atomic_load(&((order_list_t *)orders)->customers.count);
+    long long *customerKept = (long long *)allocate_zeroed(customerSlots, sizeof(long long));
+    long long *customerReturned = (long long *)allocate_zeroed(customerSlots, sizeof(long long));
+    unsigned char *customerSeen = (unsigned char *)allocate_zeroed(customerSlots, sizeof(unsigned char));
+
+    //the sealed customers were interned before customerSlots was read
+    for (size_t c = 0; c < sealed.customersSeen; c++) 
+    {
+        if (sealed.customerKept[c] != 0 || sealed.customerReturned[c] != 0) 
+        {
+            customerKept[c] += sealed.customerKept[c];
+            customerReturned[c] += sealed.customerReturned[c];
+            customerSeen[c] = 1;
+        }
+    }
+
+    free_sealed_totals(&sealed);
+
+    //second pass: every kernel over every block
+    for (size_t s = 0; s < ORDER_SHARDS; s++) 
+    {
+        order_shard_t *shard = (order_shard_t *)&orders->shards[s];
+        const order_columns_t *columns = &shard->columns;
+
+        pthread_mutex_lock(&shard->lock);
+
+        for (size_t b = 0; b * ORDER_COLUMN_BLOCK < counts[s]; b++) 
+        {
+            const order_column_block_t *block = columns->blocks[b];
+            size_t count = counts[s] - b * ORDER_COLUMN_BLOCK < ORDER_COLUMN_BLOCK ? counts[s] - b * ORDER_COLUMN_BLOCK : ORDER_COLUMN_BLOCK;
+
+            sum_units(block->quantity, block->returnedQuantity, count, &report->overall);
+            add_units_by_key((const int *)block->customerId, 0, block->quantity, block->returnedQuantity, count, customerKept, customerReturned);
+
+            for (size_t i = 0; i < count; i++) 
+            {
+                customerSeen[block->customerId[i]] = 1;
+            }
+
+            if (flatProducts) 
+            {
+                add_units_by_key(block->productNumber, lowProduct, block->quantity, block->returnedQuantity, count, productKept, productReturned);
+            } else {
+                for (size_t i = 0; i < count; i++) 
+                {
+                    product_sales_t *product = product_totals_slot(&productTotals, block->productNumber[i]);
+
+                    if (product->productNumber == INT_MIN) 
+                    {
+                        product->productNumber = block->productNumber[i];
+                        product->total.kept = 0;
+                        product->total.returned = 0;
+                        productTotals.count++;
+                    }
+
+                    product->total.returned += block->returnedQuantity[i];
+                    product->total.kept += block->quantity[i] - block->returnedQuantity[i];
+                }
+            }
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    //a customer's orders can sit in several shards, their totals already met under the one ID
+    report->customers = (customer_sales_t *)allocate_zeroed(customerSlots, sizeof(customer_sales_t));
+
+    for (size_t c = 0; c < customerSlots; c++) 
+    {
+        if (customerSeen[c]) 
+        {
+            customer_sales_t *customer = &report->customers[report->customerCount++];
+
+            customer->customerName = customer_name(&orders->customers, (unsigned int)c);
+            customer->total.kept = customerKept[c];
+            customer->total.returned = customerReturned[c];
+        }
+    }
+
+    free(customerKept);
+    free(customerReturned);
+    free(customerSeen);
+
+    //products that have line items, in product number order
+    if (flatProducts) 
+    {
+        size_t count = 0;
+
+        for (long long i = 0; i < productSpan; i++) 
+        {
+            count += productKept[i] != 0 || productReturned[i] != 0;
+        }
+
+        report->products = (product_sales_t *)allocate_zeroed(count, sizeof(product_sales_t));
+
+        for (long long i = 0; i < productSpan; i++) 
+        {
+            if (productKept[i] != 0 || productReturned[i] != 0) 
+            {
+                product_sales_t *product = &report->products[report->productCount++];
+                product->productNumber = (int)(lowProduct + i);
+                product->total.kept = productKept[i];
+                product->total.returned = productReturned[i];
+            }
+        }
+
+        free(productKept);
+        free(productReturned);
+    } else {
+        report->products = (product_sales_t *)allocate_zeroed(productTotals.count, sizeof(product_sales_t));
+
+        for (size_t i = 0; i < productTotals.capacity; i++) 
+        {
+            if (productTotals.slots[i].productNumber != INT_MIN) 
+            {
+                report->products[report->productCount++] = productTotals.slots[i];
+            }
+        }
+
+        qsort(report->products, report->productCount, sizeof(product_sales_t), compare_product_numbers);
+        free(productTotals.slots);
+    }
+
+    //categories come from the one catalog the report is printed with, by product, since a reload can renumber
+    //them and the category a line item was stored with may not mean the same any more
+    report->categoryCount = catalog->categoryCount;
+    report->categories = (sales_total_t *)allocate_zeroed(report->categoryCount, sizeof(sales_total_t));
+
+    for (size_t i = 0; i < report->productCount; i++) 
+    {
+        const product_t *product = find_product(catalog, report->products[i].productNumber);
+        sales_total_t *total = product != NULL ? &report->categories[product->categoryId] : &report->uncategorized;
+
+        total->kept += report->products[i].total.kept;
+        total->returned += report->products[i].total.returned;
+    }
+}
+
+size_t top_products(const sales_report_t *report, size_t n, product_sales_t *top) 
+{
+    size_t filled = 0;
+
+    //insertion into a short sorted list, n is small next to the number of products
+    for (size_t i = 0; i < report->productCount; i++) 
+    {
+        const product_sales_t *product = &report->products[i];
+
+        if (filled == n && (n == 0 || product->total.kept <= top[n - 1].total.kept)) 
+        {
+            continue;
+        }
+
+        size_t position = filled < n ? filled++ : n - 1;
+
+        while (position > 0 && top[position - 1].total.kept < product->total.kept) 
+        {
+            top[position] = top[position - 1];
+            position--;
+        }
+        top[position] = *product;
+    }
+
+    return filled;
+}
+
+size_t top_customers(const sales_report_t *report, size_t n, customer_sales_t *top) 
+{
+    size_t filled = 0;
+
+    for (size_t i = 0; i < report->customerCount; i++) 
+    {
+        const customer_sales_t *customer = &report->customers[i];
+
+        if (filled == n && (n == 0 || customer->total.kept <= top[n - 1].total.kept)) 
+        {
+            continue;
+        }
+
+        size_t position = filled < n ? filled++ : n - 1;
+
+        while (position > 0 && top[position - 1].total.kept < customer->total.kept) 
+        {
+            top[position] = top[position - 1];
+            position--;
+        }
+        top[position] = *customer;
+    }
+
+    return filled;
+}
+
+//share of the units that came back, in percent
+static double return_ratio(const sales_total_t *total) 
+{
+    long long units = total->kept + total->returned;
+    return units == 0 ? 0.0 : 100.0 * (double)total->returned / (double)units;
+}
+
+void print_sales_report(FILE *file, const sales_report_t *report, const catalog_t *catalog) 
+{
+    render_buffer_t buffer;
+    product_sales_t topProducts[REPORT_TOP_N];
+    customer_sales_t topCustomers[REPORT_TOP_N];
+
+    render_init(&buffer);
+
+    render_printf(&buffer, "\nSales Report (%zu line items):\n", report->lineItems);
+    render_printf(&buffer, "  Units kept: %lld | Units returned: %lld | Returned: %.1f%%\n",
+                  report->overall.kept, report->overall.returned, return_ratio(&report->overall));
+
+    size_t count = top_products(report, REPORT_TOP_N, topProducts);
+    render_printf(&buffer, "\n  Top products by units kept:\n");
+
+    for (size_t i = 0; i < count; i++) 
+    {
+        const product_t *product = find_product(catalog, topProducts[i].productNumber);
+
+        render_printf(&buffer, "    %s, product no. %d | Kept: %lld | Returned: %lld | Returned: %.1f%%\n",
+                      product != NULL ? product->name : "(not in catalog)", topProducts[i].productNumber,
+                      topProducts[i].total.kept, topProducts[i].total.returned, return_ratio(&topProducts[i].total));
+    }
+
+    count = top_customers(report, REPORT_TOP_N, topCustomers);
+    render_printf(&buffer, "\n  Top customers by units kept:\n");
+
+    for (size_t i = 0; i < count; i++) 
+    {
+        render_printf(&buffer, "    %s | Kept: %lld | Returned: %lld | Returned: %.1f%%\n", topCustomers[i].customerName,
+                      topCustomers[i].total.kept, topCustomers[i].total.returned, return_ratio(&topCustomers[i].total));
+    }
+
+    render_printf(&buffer, "\n  Categories:\n");
+
+    //the report was built against this catalog, so it has every one of its categories
+    for (size_t c = 0; c < catalog->categoryCount || c < report->categoryCount; c++) 
+    {
+        sales_total_t total = { 0, 0 };
+
+        if (c < report->categoryCount) 
+        {
+            total = report->categories[c];
+        }
+
+        render_printf(&buffer, "    %s | Kept: %lld | Returned: %lld | Returned: %.1f%%\n", category_name(catalog, (int)c),
+                      total.kept, total.returned, return_ratio(&total));
+    }
+
+    if (report->uncategorized.kept != 0 || report->uncategorized.returned != 0) 
+    {
+        render_printf(&buffer, "    (not in catalog) | Kept: %lld | Returned: %lld | Returned: %.1f%%\n",
+                      report->uncategorized.kept, report->uncategorized.returned, return_ratio(&report->uncategorized));
+    }
+
+    render_printf(&buffer, "\n");
+    render_flush(&buffer, file);
+    render_free(&buffer);
+}
+
+void free_sales_report(sales_report_t *report) 
+{
+    free(report->products);
+    free(report->categories);
+    free(report->customers);
+    memset(report, 0, sizeof(sales_report_t));
+}
@@ -0,0 +1,55 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdio.h>
+#include "catalog_system.h"
+
+#define REPORT_TOP_N 10                       //products and customers listed by print_sales_report
+#define REPORT_MAX_PRODUCT_SPAN (1 << 24)     //widest product number range totalled in a flat array
+
+//units on line items that were kept and that were returned
+typedef struct {
+    long long kept;
+    long long returned;
+} sales_total_t;
+
+typedef struct {
+    int productNumber;
+    sales_total_t total;
+} product_sales_t;
+
+typedef struct {
+    const char *customerName; //points into the order store's customer pool
+    sales_total_t total;
+} customer_sales_t;
+
+//sales totals over every line item in the order store and its sealed days
+typedef struct {
+    sales_total_t overall;
+    size_t lineItems;
+    product_sales_t *products;   //every product with line items, in product number order
+    size_t productCount;
+    sales_total_t *categories;   //indexed by category ID of the catalog the report was built against
+    size_t categoryCount;
+    sales_total_t uncategorized; //products the catalog the report was built against doesn't have
+    customer_sales_t *customers; //every customer, in no particular order
+    size_t customerCount;
+} sales_report_t;
+
+//function declarations
+
+//totals the sealed days of the archive (if any) and the order columns of every shard, each shard is locked while it's read
+//products are put in their categories as catalog has them, print the report with the same catalog
+void build_sales_report(sales_report_t *report, const order_list_t *orders, const catalog_t *catalog);
+
+//fills top with up to n products (or customers) with the most units kept, best first, returns how many were filled
+size_t top_products(const sales_report_t *report, size_t n, product_sales_t *top);
+size_t top_customers(const sales_report_t *report, size_t n, customer_sales_t *top);
+
+//writes the overall totals, the top products and customers and every category with its return ratio
+void print_sales_report(FILE *file, const sales_report_t *report, const catalog_t *catalog);
+
+//frees the memory allocated for the report
+void free_sales_report(sales_report_t *report);
+
+#endif /* REPORT_H */
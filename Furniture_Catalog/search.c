@@ -0,0 +1,781 @@
+/*
+Product name search. Two structures are built when the catalog is loaded: the product positions sorted by
+name, which answers a prefix with one binary search, and a trigram index (every three-letter run of every
+lowercased name with the products it appears in) that narrows a substring or misspelled query down to a
+short list of candidates. Case never matters.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "search.h"
+
+//ASCII lowercase without going through the locale, this runs for every character of every name at load
+static inline unsigned char fold(char c) 
+{
+    unsigned char u = (unsigned char)c;
+    return u >= 'A' && u <= 'Z' ? (unsigned char)(u + ('a' - 'A')) : u;
+}
+
+//compares two names ignoring case
+static int compare_folded(const char *left, const char *right) 
+{
+    while (*left != '\0' && fold(*left) == fold(*right)) 
+    {
+        left++;
+        right++;
+    }
+
+    return (int)fold(*left) - (int)fold(*right);
+}
+
+//0 if name starts with prefix ignoring case, otherwise which side of the prefix the name sorts on
+static int compare_prefix(const char *name, const char *prefix) 
+{
+    for (; *prefix != '\0'; name++, prefix++) 
+    {
+        int difference = (int)fold(*name) - (int)fold(*prefix);
+
+        if (difference != 0) 
+        {
+            return difference;
+        }
+    }
+
+    return 0;
+}
+
+//1 if text appears anywhere in name ignoring case
+static int contains_folded(const char *name, const char *text) 
+{
+    for (; *name != '\0'; name++) 
+    {
+        if (compare_prefix(name, text) == 0) 
+        {
+            return 1;
+        }
+    }
+
+    return *text == '\0';
+}
+
+//three lowercased characters packed into one key
+static uint32_t trigram(const char *text) 
+{
+    return ((uint32_t)fold(text[0]) << 16) | ((uint32_t)fold(text[1]) << 8) | fold(text[2]);
+}
+
+//a product position and its name, sorted together
+typedef struct {
+    const char *name;
+    unsigned int position;
+} name_entry_t;
+
+static void swap_entries(name_entry_t *entries, size_t a, size_t b) 
+{
+    name_entry_t swap = entries[a];
+    entries[a] = entries[b];
+    entries[b] = swap;
+}
+
+//multikey quicksort: partitions on one character at a time, so a prefix shared by every name is only read once
+static void sort_names(name_entry_t *entries, size_t count, size_t depth) 
+{
+    while (count > 16) 
+    {
+        swap_entries(entries, 0, count / 2);
+        unsigned char pivot = fold(entries[0].name[depth]);
+        size_t less = 0;
+        size_t greater = count;
+        size_t i = 1;
+
+        //[0, less) sorts before the pivot character, [less, i) matches it, [greater, count) sorts after it
+        while (i < greater) 
+        {
+            unsigned char c = fold(entries[i].name[depth]);
+
+            if (c < pivot) 
+            {
+                swap_entries(entries, less++, i++);
+            } else if (c > pivot) 
+            {
+                swap_entries(entries, i, --greater);
+            } else {
+                i++;
+            }
+        }
+
+        sort_names(entries, less, depth);
+        sort_names(entries + greater, count - greater, depth);
+
+        //names that ended at this depth are equal
+        if (pivot == '\0') 
+        {
+            return;
+        }
+
+        entries += less;
+        count = greater - less;
+        depth++;
+    }
+
+    for (size_t i = 1; i < count; i++) 
+    {
+        name_entry_t entry = entries[i];
+        size_t j = i;
+
+        while (j > 0 && compare_folded(entries[j - 1].name + depth, entry.name + depth) > 0) 
+        {
+            entries[j] = entries[j - 1];
+            j--;
+        }
+        entries[j] = entry;
+    }
+}
+
+//allocates memory or exits
+static void *allocate(size_t count, size_t size) 
+{
+    void *memory = malloc((count > 0 ? count : 1) * size);
+
+    if (!memory) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return memory;
+}
+
+//distinct trigrams seen while building, each gets a dense ID in order of first appearance
+typedef struct {
+    uint32_t *keys;     //trigram + 1 (0 marks an empty slot)
+    unsigned int *ids;
+    size_t capacity;    //always a power of two
+    size_t count;
+} gram_table_t;
+
+static size_t gram_slot(const gram_table_t *table, uint32_t gram) 
+{
+    size_t mask = table->capacity - 1;
+    size_t slot = (size_t)((gram * 2654435769u) >> 8) & mask;
+
+    while (table->keys[slot] != 0 && table->keys[slot] != gram + 1) 
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+//returns the dense ID of a trigram, adding it if it's new
+static unsigned int gram_id(gram_table_t *table, uint32_t gram) 
+{
+    size_t slot = gram_slot(table, gram);
+
+    if (table->keys[slot] != 0) 
+    {
+        return table->ids[slot];
+    }
+
+    //keep the table at most half full, rehashing every trigram when it doubles
+    if ((table->count + 1) * 2 > table->capacity) 
+    {
+        gram_table_t grown;
+        grown.capacity = table->capacity * 2;
+        grown.count = table->count;
+        grown.keys = (uint32_t *)calloc(grown.capacity, sizeof(uint32_t));
+        grown.ids = (unsigned int *)allocate(grown.capacity, sizeof(unsigned int));
+
+        if (!grown.keys) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        for (size_t i = 0; i < table->capacity; i++) 
+        {
+            if (table->keys[i] != 0) 
+            {
+                size_t moved = gram_slot(&grown, table->keys[i] - 1);
+                grown.keys[moved] = table->keys[i];
+                grown.ids[moved] = table->ids[i];
+            }
+        }
+
+        free(table->keys);
+        free(table->ids);
+        *table = grown;
+        slot = gram_slot(table, gram);
+    }
+
+    table->keys[slot] = gram + 1;
+    table->ids[slot] = (unsigned int)table->count;
+
+    return (unsigned int)table->count++;
+}
+
+//(trigram, first ID) pairs, sorted so the trigrams can be binary searched
+typedef struct {
+    uint32_t gram;
+    unsigned int id;
+} gram_order_t;
+
+static int compare_gram_order(const void *a, const void *b) 
+{
+    uint32_t left = ((const gram_order_t *)a)->gram;
+    uint32_t right = ((const gram_order_t *)b)->gram;
+    return (left > right) - (left < right);
+}
+
+void build_name_index(catalog_t *catalog) 
+{
+    name_index_t *index = &catalog->names;
+    size_t count = catalog->count;
+
+    free(index->byName);
+    free(index->gramKeys);
+    free(index->gramStarts);
+    free(index->postings);
+    memset(index, 0, sizeof(name_index_t));
+
+    //names in order, ignoring case
+    name_entry_t *entries = (name_entry_t *)allocate(count, sizeof(name_entry_t));
+    size_t gramTotal = 0;
+
+    for (size_t i = 0; i < count; i++) 
+    {
+        size_t length = strlen(catalog->products[i].name);
+
+        entries[i].name = catalog->products[i].name;
+        entries[i].position = (unsigned int)i;
+        gramTotal += length >= 3 ? length - 2 : 0;
+    }
+
+    sort_names(entries, count, 0);
+
+    index->byName = (unsigned int *)allocate(count, sizeof(unsigned int));
+
+    for (size_t i = 0; i < count; i++) 
+    {
+        index->byName[i] = entries[i].position;
+    }
+
+    free(entries);
+
+    //first pass: the dense ID of every trigram of every name, and how many names each one is in
+    gram_table_t table;
+    table.capacity = 1024;
+    table.count = 0;
+    table.keys = (uint32_t *)calloc(table.capacity, sizeof(uint32_t));
+    table.ids = (unsigned int *)allocate(table.capacity, sizeof(unsigned int));
+
+    if (!table.keys) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned int *gramIds = (unsigned int *)allocate(gramTotal, sizeof(unsigned int));
+    size_t *counts = NULL;
+    unsigned int *lastPosition = NULL; //position + 1 of the last name counted for each ID, so repeats count once
+    size_t countCapacity = 0;
+    size_t filled = 0;
+
+    for (size_t i = 0; i < count; i++) 
+    {
+        const char *name = catalog->products[i].name;
+
+        for (size_t c = 0; name[c] != '\0' && name[c + 1] != '\0' && name[c + 2] != '\0'; c++) 
+        {
+            unsigned int id = gram_id(&table, trigram(name + c));
+
+            if (id == countCapacity) 
+            {
+                countCapacity = countCapacity == 0 ? 1024 : countCapacity * 2;
+                counts = (size_t *)realloc(counts, countCapacity * sizeof(size_t));
+                lastPosition = (unsigned int *)realloc(lastPosition, countCapacity * sizeof(unsigned int));
+
+                if (!counts || !lastPosition) 
+                {
+                    printf("Memory allocation failure.\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                memset(counts + id, 0, (countCapacity - id) * sizeof(size_t));
+                memset(lastPosition + id, 0, (countCapacity - id) * sizeof(unsigned int));
+            }
+
+            gramIds[filled++] = id;
+
+            if (lastPosition[id] != i + 1) 
+            {
+                lastPosition[id] = (unsigned int)i + 1;
+                counts[id]++;
+            }
+        }
+    }
+
+    //the trigrams in ascending order, each list starts where the ones before it end
+    size_t gramCount = table.count;
+    gram_order_t *order = (gram_order_t *)allocate(gramCount, sizeof(gram_order_t));
+
+    for (size_t slot = 0; slot < table.capacity; slot++) 
+    {
+        if (table.keys[slot] != 0) 
+        {
+            order[table.ids[slot]].gram = table.keys[slot] - 1;
+            order[table.ids[slot]].id = table.ids[slot];
+        }
+    }
+
+    free(table.keys);
+    free(table.ids);
+    qsort(order, gramCount, sizeof(gram_order_t), compare_gram_order);
+
+    index->gramKeys = (unsigned int *)allocate(gramCount, sizeof(unsigned int));
+    index->gramStarts = (size_t *)allocate(gramCount + 1, sizeof(size_t));
+    size_t *next = (size_t *)allocate(gramCount, sizeof(size_t)); //where each ID's next position goes
+    size_t postingCount = 0;
+
+    for (size_t g = 0; g < gramCount; g++) 
+    {
+        index->gramKeys[g] = order[g].gram;
+        index->gramStarts[g] = postingCount;
+        next[order[g].id] = postingCount;
+        postingCount += counts[order[g].id];
+    }
+
+    index->gramStarts[gramCount] = postingCount;
+    index->gramCount = gramCount;
+    free(order);
+
+    //second pass: names in position order, so every list comes out ascending
+    index->postings = (unsigned int *)allocate(postingCount, sizeof(unsigned int));
+    filled = 0;
+
+    if (lastPosition != NULL) 
+    {
+        memset(lastPosition, 0, countCapacity * sizeof(unsigned int));
+    }
+
+    for (size_t i = 0; i < count; i++) 
+    {
+        size_t length = strlen(catalog->products[i].name);
+
+        for (size_t c = 0; c + 2 < length; c++) 
+        {
+            unsigned int id = gramIds[filled++];
+
+            if (lastPosition[id] != i + 1) 
+            {
+                lastPosition[id] = (unsigned int)i + 1;
+                index->postings[next[id]++] = (unsigned int)i;
+            }
+        }
+    }
+
+    free(gramIds);
+    free(counts);
+    free(lastPosition);
+    free(next);
+}
+
+size_t search_products_by_prefix(const catalog_t *catalog, const char *prefix, const product_t **matches, size_t maxMatches) 
+{
+    const name_index_t *index = &catalog->names;
+    size_t low = 0;
+    size_t high = catalog->count;
+
+    if (index->byName == NULL) 
+    {
+        return 0;
+    }
+
+    //first name that doesn't sort before the prefix
+    while (low < high) 
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (compare_prefix(catalog->products[index->byName[middle]].name, prefix) < 0) 
+        {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    size_t filled = 0;
+
+    for (size_t i = low; i < catalog->count && filled < maxMatches; i++) 
+    {
+        const product_t *product = &catalog->products[index->byName[i]];
+
+        if (compare_prefix(product->name, prefix) != 0) 
+        {
+            break;
+        }
+
+        matches[filled++] = product;
+    }
+
+    return filled;
+}
+
+//the posting list of a trigram, empty when no name has it
+static const unsigned int *find_postings(const name_index_t *index, uint32_t gram, size_t *count) 
+{
+    size_t low = 0;
+    size_t high = index->gramCount;
+
+    while (low < high) 
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (index->gramKeys[middle] < gram) 
+        {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (low == index->gramCount || index->gramKeys[low] != gram) 
+    {
+        *count = 0;
+        return NULL;
+    }
+
+    *count = index->gramStarts[low + 1] - index->gramStarts[low];
+    return &index->postings[index->gramStarts[low]];
+}
+
+//first index at or after from whose position is at least position, galloping so a walk over ascending
+//positions costs about the log of each step rather than of the whole list
+static size_t seek_posting(const unsigned int *postings, size_t count, size_t from, unsigned int position) 
+{
+    size_t step = 1;
+    size_t low = from;
+    size_t high = from;
+
+    while (high < count && postings[high] < position) 
+    {
+        low = high + 1;
+        high += step;
+        step *= 2;
+    }
+
+    if (high > count) 
+    {
+        high = count;
+    }
+
+    while (low < high) 
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (postings[middle] < position) 
+        {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+//a query trigram with its posting list
+typedef struct {
+    const unsigned int *postings;
+    size_t count;
+} gram_list_t;
+
+static int compare_gram_lists(const void *a, const void *b) 
+{
+    size_t left = ((const gram_list_t *)a)->count;
+    size_t right = ((const gram_list_t *)b)->count;
+    return (left > right) - (left < right);
+}
+
+//looks up every distinct trigram of the query, shortest list first, returns how many there are
+static size_t query_grams(const name_index_t *index, const char *text, gram_list_t *lists) 
+{
+    uint32_t seen[MAX_PRODUCT_NAME];
+    size_t count = 0;
+    size_t length = strlen(text);
+
+    for (size_t c = 0; c + 2 < length && count < MAX_PRODUCT_NAME; c++) 
+    {
+        uint32_t gram = trigram(text + c);
+        int repeated = 0;
+
+        for (size_t g = 0; g < count; g++) 
+        {
+            repeated |= seen[g] == gram;
+        }
+
+        if (!repeated) 
+        {
+            seen[count] = gram;
+            lists[count].postings = find_postings(index, gram, &lists[count].count);
+            count++;
+        }
+    }
+
+    qsort(lists, count, sizeof(gram_list_t), compare_gram_lists);
+
+    return count;
+}
+
+size_t search_products_by_substring(const catalog_t *catalog, const char *text, const product_t **matches, size_t maxMatches) 
+{
+    gram_list_t lists[MAX_PRODUCT_NAME];
+    size_t cursors[MAX_PRODUCT_NAME] = { 0 };
+    size_t filled = 0;
+
+    if (text[0] == '\0') 
+    {
+        return 0;
+    }
+
+    //one or two characters have no trigram, every name is checked
+    if (strlen(text) < 3 || catalog->names.postings == NULL) 
+    {
+        for (size_t i = 0; i < catalog->count && filled < maxMatches; i++) 
+        {
+            if (contains_folded(catalog->products[i].name, text)) 
+            {
+                matches[filled++] = &catalog->products[i];
+            }
+        }
+
+        return filled;
+    }
+
+    //a match has every trigram of the text: walk the shortest list and skip positions missing from any other,
+    //only the names that survive are read to check the trigrams are really in a row
+    size_t gramCount = query_grams(&catalog->names, text, lists);
+
+    for (size_t i = 0; i < lists[0].count && filled < maxMatches; i++) 
+    {
+        unsigned int position = lists[0].postings[i];
+        int inAll = 1;
+
+        for (size_t g = 1; g < gramCount && inAll; g++) 
+        {
+            cursors[g] = seek_posting(lists[g].postings, lists[g].count, cursors[g], position);
+            inAll = cursors[g] < lists[g].count && lists[g].postings[cursors[g]] == position;
+        }
+
+        if (inAll && contains_folded(catalog->products[position].name, text)) 
+        {
+            matches[filled++] = &catalog->products[position];
+        }
+    }
+
+    return filled;
+}
+
+//a fuzzy candidate and the number of query trigrams its name shares
+typedef struct {
+    unsigned int position;
+    size_t hits;
+} fuzzy_candidate_t;
+
+static int compare_candidates(const void *a, const void *b) 
+{
+    const fuzzy_candidate_t *left = (const fuzzy_candidate_t *)a;
+    const fuzzy_candidate_t *right = (const fuzzy_candidate_t *)b;
+
+    if (left->hits != right->hits) 
+    {
+        return left->hits < right->hits ? 1 : -1;
+    }
+
+    return (left->position > right->position) - (left->position < right->position);
+}
+
+//the kept candidates are a heap with the one that ranks last on top, so it is the one a better candidate replaces
+static void sift_candidate_down(fuzzy_candidate_t *heap, size_t count, size_t index) 
+{
+    for (;;) 
+    {
+        size_t last = index;
+        size_t left = index * 2 + 1;
+        size_t right = left + 1;
+
+        if (left < count && compare_candidates(&heap[left], &heap[last]) > 0) 
+        {
+            last = left;
+        }
+        if (right < count && compare_candidates(&heap[right], &heap[last]) > 0) 
+        {
+            last = right;
+        }
+        if (last == index) 
+        {
+            return;
+        }
+
+        fuzzy_candidate_t swapped = heap[index];
+        heap[index] = heap[last];
+        heap[last] = swapped;
+        index = last;
+    }
+}
+
+static void keep_candidate(fuzzy_candidate_t *heap, size_t *count, size_t capacity, fuzzy_candidate_t candidate) 
+{
+    if (*count < capacity) 
+    {
+        size_t index = (*count)++;
+
+        heap[index] = candidate;
+
+        while (index > 0 && compare_candidates(&heap[index], &heap[(index - 1) / 2]) > 0) 
+        {
+            size_t parent = (index - 1) / 2;
+            fuzzy_candidate_t swapped = heap[index];
+
+            heap[index] = heap[parent];
+            heap[parent] = swapped;
+            index = parent;
+        }
+    } else if (compare_candidates(&candidate, &heap[0]) < 0) 
+    {
+        heap[0] = candidate;
+        sift_candidate_down(heap, *count, 0);
+    }
+}
+
+size_t search_products_fuzzy(const catalog_t *catalog, const char *text, const product_t **matches, size_t maxMatches) 
+{
+    gram_list_t lists[MAX_PRODUCT_NAME];
+    size_t cursors[MAX_PRODUCT_NAME] = { 0 };
+
+    if (catalog->names.postings == NULL) 
+    {
+        return 0;
+    }
+
+    size_t gramCount = query_grams(&catalog->names, text, lists);
+
+    if (gramCount == 0 || maxMatches == 0) 
+    {
+        return 0;
+    }
+
+    size_t needed = gramCount > SEARCH_FUZZY_MISSING_GRAMS ? gramCount - SEARCH_FUZZY_MISSING_GRAMS : 1;
+    size_t allowedMisses = gramCount - needed;
+
+    //a name that lacks at most allowedMisses trigrams is in at least one of the allowedMisses + 1 shortest lists,
+    //those are merged in position order and every other list is galloped through alongside them,
+    //every name is scored but only the best ones are kept
+    size_t sourceLists = allowedMisses + 1;
+    size_t capacity = maxMatches < SEARCH_MAX_CANDIDATES ? maxMatches : SEARCH_MAX_CANDIDATES;
+    fuzzy_candidate_t *candidates = (fuzzy_candidate_t *)allocate(capacity, sizeof(fuzzy_candidate_t));
+    size_t candidateCount = 0;
+
+    for (;;) 
+    {
+        //next position in any of the source lists
+        unsigned int position = 0;
+        int found = 0;
+
+        for (size_t g = 0; g < sourceLists; g++) 
+        {
+            if (cursors[g] < lists[g].count && (!found || lists[g].postings[cursors[g]] < position)) 
+            {
+                position = lists[g].postings[cursors[g]];
+                found = 1;
+            }
+        }
+
+        if (!found) 
+        {
+            break;
+        }
+
+        //count the trigrams the name shares, giving up once too many are missing
+        size_t hits = 0;
+        size_t misses = 0;
+
+        for (size_t g = 0; g < gramCount && misses <= allowedMisses; g++) 
+        {
+            cursors[g] = seek_posting(lists[g].postings, lists[g].count, cursors[g], position);
+
+            if (cursors[g] < lists[g].count && lists[g].postings[cursors[g]] == position) 
+            {
+                hits++;
+            } else {
+                misses++;
+            }
+        }
+
+        if (misses <= allowedMisses) 
+        {
+            fuzzy_candidate_t candidate = { position, hits };
+
+            keep_candidate(candidates, &candidateCount, capacity, candidate);
+        }
+
+        //step the source lists past the position
+        for (size_t g = 0; g < sourceLists; g++) 
+        {
+            cursors[g] = seek_posting(lists[g].postings, lists[g].count, cursors[g], position + 1);
+        }
+    }
+
+    qsort(candidates, candidateCount, sizeof(fuzzy_candidate_t), compare_candidates);
+
+    size_t filled = 0;
+
+    for (; filled < candidateCount && filled < maxMatches; filled++) 
+    {
+        matches[filled] = &catalog->products[candidates[filled].position];
+    }
+
+    free(candidates);
+
+    return filled;
+}
+
+size_t search_products(const catalog_t *catalog, const char *query, const product_t **matches, size_t maxMatches) 
+{
+    size_t filled = search_products_by_prefix(catalog, query, matches, maxMatches);
+
+    //names that contain the query further in come after the ones that start with it
+    //every prefix match is a substring match too, so that many extra are asked for
+    if (filled < maxMatches) 
+    {
+        const product_t **found = (const product_t **)allocate(filled + maxMatches, sizeof(const product_t *));
+        size_t count = search_products_by_substring(catalog, query, found, filled + maxMatches);
+        size_t prefixMatches = filled;
+
+        for (size_t i = 0; i < count && filled < maxMatches; i++) 
+        {
+            int listed = 0;
+
+            for (size_t m = 0; m < prefixMatches && !listed; m++) 
+            {
+                listed = matches[m] == found[i];
+            }
+
+            if (!listed) 
+            {
+                matches[filled++] = found[i];
+            }
+        }
+
+        free(found);
+    }
+
+    if (filled == 0) 
+    {
+        filled = search_products_fuzzy(catalog, query, matches, maxMatches);
+    }
+
+    return filled;
+}
@@ -0,0 +1,27 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "catalog_system.h"
+
+#define SEARCH_MAX_RESULTS 10          //matches place_order lists for a name query
+#define SEARCH_MAX_CANDIDATES 4096     //best scoring products a fuzzy search keeps at most
+#define SEARCH_FUZZY_MISSING_GRAMS 3   //trigrams a fuzzy match may lack, one typo breaks up to three
+
+//function declarations
+
+//(re)builds the name search index over every product, products must not move afterwards
+void build_name_index(catalog_t *catalog);
+
+//products whose names start with prefix (ignoring case), in name order, returns how many were filled
+size_t search_products_by_prefix(const catalog_t *catalog, const char *prefix, const product_t **matches, size_t maxMatches);
+
+//products whose names contain text anywhere (ignoring case), in catalog order, returns how many were filled
+size_t search_products_by_substring(const catalog_t *catalog, const char *text, const product_t **matches, size_t maxMatches);
+
+//products whose names share most of the trigrams of text, so a typo or two still finds them, best first
+size_t search_products_fuzzy(const catalog_t *catalog, const char *text, const product_t **matches, size_t maxMatches);
+
+//prefix matches if there are any, otherwise substring matches, otherwise fuzzy ones
+size_t search_products(const catalog_t *catalog, const char *query, const product_t **matches, size_t maxMatches);
+
+#endif /* SEARCH_H */
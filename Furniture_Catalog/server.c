@@ -0,0 +1,959 @@
+/*
+Server mode for the catalog system. One thread owns the orders and the live catalog and answers every
+client connected to a Unix domain socket from a non-blocking, level-triggered epoll loop. Requests are
+framed (see protocol.h), a client may pipeline several, and replies go back in the order they were asked.
+Replies are held until the end of each round of events: if any request of the round placed or returned
+something, the journal is flushed once for all of them before a single reply goes out. If the flush fails
+the round's confirmations are replaced with PROTOCOL_FAILED, and no more orders or returns are taken.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+#include "protocol.h"
+#include "render.h"
+#include "journal.h"
+
+//one connected client, buffered both ways
+typedef struct {
+    int fd;
+    unsigned char *input;      //received bytes not yet answered, always starting at a frame
+    size_t inputSize;
+    size_t inputCapacity;
+    protocol_buffer_t output;  //replies not yet sent
+    size_t outputSent;         //bytes of output already sent
+    unsigned int events;       //what epoll is watching the client for
+    render_filter_t listFilter; //the listing this client paged through last
+    uint8_t listing;
+    const catalog_t *listCatalog; //catalog version the listing was rendered against
+    render_cursor_t listCursor;   //where its next page starts
+    uint32_t listRows;            //rows it has been sent, the skip that asks for the next page
+    int replying;                 //1 while it waits for the end of the round to send its replies
+    int closing;                  //1 once it hung up or sent a malformed frame, it's closed after its replies
+    size_t *confirmations;        //where this round's place and return confirmations start in output
+    size_t confirmationCount;
+    size_t confirmationCapacity;
+} connection_t;
+
+typedef struct {
+    int epollFd;
+    int listenFd;
+    int signalFd;
+    connection_t **connections; //by file descriptor, NULL where there is no client
+    size_t connectionCapacity;
+    size_t connectionCount;
+    order_list_t *orders;
+    live_catalog_t *catalog;
+    server_result_t *result;
+    connection_t *replying[SERVER_MAX_EVENTS]; //clients answered this round, each is reported by epoll once per wait
+    size_t replyingCount;
+    int journaled; //1 once a request of this round queued journal records
+    int readOnly;  //1 once the journal couldn't be flushed, orders and returns are refused from then on
+    int stopping;
+} server_t;
+
+void server_block_signals(void) 
+{
+    sigset_t signals;
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+}
+
+//starts a reply frame with its status, and for anything but PROTOCOL_OK its message too
+static size_t begin_reply(server_t *server, connection_t *connection, uint8_t status, const char *message) 
+{
+    size_t start = protocol_begin_frame(&connection->output, status);
+
+    if (status != PROTOCOL_OK) 
+    {
+        protocol_put_string(&connection->output, message);
+        server->result->rejected++;
+    }
+
+    return start;
+}
+
+//sends a reply that is only a status and a message
+static void reply_error(server_t *server, connection_t *connection, uint8_t status, const char *message) 
+{
+    protocol_end_frame(&connection->output, begin_reply(server, connection, status, message));
+}
+
+//marks the reply about to be begun as a confirmation that holds until the round's journal flush
+static void begin_confirmation(server_t *server, connection_t *connection) 
+{
+    if (connection->confirmationCount == connection->confirmationCapacity) 
+    {
+        size_t capacity = connection->confirmationCapacity == 0 ? 16 : connection->confirmationCapacity * 2;
+        size_t *confirmations = (size_t *)realloc(connection->confirmations, capacity * sizeof(size_t));
+
+        if (!confirmations) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        connection->confirmations = confirmations;
+        connection->confirmationCapacity = capacity;
+    }
+
+    connection->confirmations[connection->confirmationCount++] = connection->output.size;
+    server->journaled = 1;
+}
+
+//replaces the round's confirmations of a client with PROTOCOL_FAILED replies, the rest of its output stays
+static void fail_confirmations(server_t *server, connection_t *connection) 
+{
+    protocol_buffer_t output;
+    size_t copied = 0;
+
+    protocol_buffer_init(&output);
+
+    for (size_t i = 0; i < connection->confirmationCount; i++) 
+    {
+        size_t start = connection->confirmations[i];
+        uint32_t length;
+
+        memcpy(&length, connection->output.data + start, sizeof(length));
+        protocol_put_bytes(&output, connection->output.data + copied, start - copied);
+
+        size_t frame = protocol_begin_frame(&output, PROTOCOL_FAILED);
+        protocol_put_string(&output, "not saved, the journal could not be written");
+        protocol_end_frame(&output, frame);
+        server->result->rejected++;
+
+        copied = start + length;
+    }
+
+    //what went before the first confirmation is copied as it was, so the bytes already sent still line up
+    protocol_put_bytes(&output, connection->output.data + copied, connection->output.size - copied);
+    protocol_buffer_free(&connection->output);
+    connection->output = output;
+}
+
+//validates an order completely before any of it is stored, like a batch order record
+static void serve_place(server_t *server, connection_t *connection, protocol_reader_t *request) 
+{
+    char customerName[MAX_NAME];
+    protocol_get_string(request, customerName, sizeof(customerName));
+    uint16_t count = protocol_get_u16(request);
+
+    if (request->failed || !is_valid_customer_name(customerName)) 
+    {
+        reply_error(server, connection, PROTOCOL_INVALID, "customer name missing, too long or holding control characters");
+        return;
+    }
+
+    if (count == 0) 
+    {
+        reply_error(server, connection, PROTOCOL_INVALID, "order has no line items");
+        return;
+    }
+
+    if (count > PROTOCOL_MAX_ITEMS) 
+    {
+        reply_error(server, connection, PROTOCOL_INVALID, "too many line items");
+        return;
+    }
+
+    if (server->readOnly) 
+    {
+        reply_error(server, connection, PROTOCOL_FAILED, "orders can't be saved, the journal could not be written");
+        return;
+    }
+
+    order_draft_t draft;
+    init_order_draft(&draft, customerName);
+
+    //the whole order is checked against one version of the catalog
+    const catalog_t *catalog = live_catalog_acquire(server->catalog);
+    uint8_t status = PROTOCOL_OK;
+    const char *message = "";
+
+    for (uint16_t i = 0; i < count && status == PROTOCOL_OK; i++) 
+    {
+        int productNumber = protocol_get_i32(request);
+        int quantity = protocol_get_i32(request);
+
+        if (request->failed) 
+        {
+            status = PROTOCOL_INVALID;
+            message = "line items cut short";
+        } else if (!isProductNumberValid(catalog, productNumber)) 
+        {
+            status = PROTOCOL_NOT_FOUND;
+            message = "product number does not exist";
+        } else if (quantity <= 0) 
+        {
+            status = PROTOCOL_INVALID;
+            message = "invalid quantity";
+        } else if (add_to_order_draft(&draft, productNumber, quantity) < 0) 
+        {
+            status = PROTOCOL_INVALID;
+            message = "quantity too large";
+        }
+    }
+
+    live_catalog_release(server->catalog);
+
+    if (status != PROTOCOL_OK) 
+    {
+        free_order_draft(&draft);
+        reply_error(server, connection, status, message);
+        return;
+    }
+
+    char orderNumber[MAX_ORDER_NUMBER];
+    size_t itemCount = commit_order_draft(server->orders, &draft, orderNumber);
+    int failure = draft.failure;
+    int failedProduct = draft.failedProduct;
+    free_order_draft(&draft);
+
+    if (itemCount == 0) 
+    {
+        char message[64];
+
+        if (failure == ORDER_DRAFT_BAD_QUANTITY) 
+        {
+            snprintf(message, sizeof(message), "invalid quantity for product %d", failedProduct);
+            reply_error(server, connection, PROTOCOL_INVALID, message);
+        } else if (failure == ORDER_DRAFT_NO_NUMBER) 
+        {
+            reply_error(server, connection, PROTOCOL_FAILED, "no order number could be reserved");
+        } else {
+            snprintf(message, sizeof(message), "not enough of product %d in stock", failedProduct);
+            reply_error(server, connection, PROTOCOL_OUT_OF_STOCK, message);
+        }
+        return;
+    }
+
+    begin_confirmation(server, connection);
+
+    size_t start = begin_reply(server, connection, PROTOCOL_OK, NULL);
+    protocol_put_string(&connection->output, orderNumber);
+    protocol_put_u16(&connection->output, (uint16_t)itemCount);
+    protocol_end_frame(&connection->output, start);
+}
+
+//returns a whole order, or some units of one of its products
+static void serve_return(server_t *server, connection_t *connection, protocol_reader_t *request) 
+{
+    char orderNumber[MAX_ORDER_NUMBER];
+    protocol_get_string(request, orderNumber, sizeof(orderNumber));
+    int productNumber = protocol_get_i32(request);
+    int quantity = protocol_get_i32(request);
+    uint32_t returned;
+
+    if (request->failed || orderNumber[0] == '\0') 
+    {
+        reply_error(server, connection, PROTOCOL_INVALID, "order number missing or too long");
+        return;
+    }
+
+    if (server->readOnly) 
+    {
+        reply_error(server, connection, PROTOCOL_FAILED, "returns can't be saved, the journal could not be written");
+        return;
+    }
+
+    if (productNumber == 0) 
+    {
+        returned = (uint32_t)return_order(server->orders, orderNumber);
+
+        if (returned == 0) 
+        {
+            reply_error(server, connection, PROTOCOL_NOT_FOUND, "order number not found or already returned");
+            return;
+        }
+    } else {
+        if (quantity <= 0) 
+        {
+            reply_error(server, connection, PROTOCOL_INVALID, "quantity must be positive");
+            return;
+        }
+
+        if (!return_line_item(server->orders, orderNumber, productNumber, quantity)) 
+        {
+            reply_error(server, connection, PROTOCOL_NOT_FOUND, "no such product on the order with that many units left");
+            return;
+        }
+
+        returned = (uint32_t)quantity;
+    }
+
+    begin_confirmation(server, connection);
+
+    size_t start = begin_reply(server, connection, PROTOCOL_OK, NULL);
+    protocol_put_u32(&connection->output, returned);
+    protocol_end_frame(&connection->output, start);
+}
+
+static void serve_product(server_t *server, connection_t *connection, protocol_reader_t *request) 
+{
+    int productNumber = protocol_get_i32(request);
+
+    if (request->failed) 
+    {
+        reply_error(server, connection, PROTOCOL_INVALID, "product number missing");
+        return;
+    }
+
+    const catalog_t *catalog = live_catalog_acquire(server->catalog);
+    const product_t *product = find_product(catalog, productNumber);
+
+    if (product == NULL) 
+    {
+        reply_error(server, connection, PROTOCOL_NOT_FOUND, "product number does not exist");
+    } else {
+        size_t start = begin_reply(server, connection, PROTOCOL_OK, NULL);
+        protocol_put_string(&connection->output, product->name);
+        protocol_put_string(&connection->output, category_name(catalog, product->categoryId));
+        protocol_end_frame(&connection->output, start);
+    }
+
+    live_catalog_release(server->catalog);
+}
+
+//sends every line item of an order, copied under its shard's lock or read from the day it was sealed into
+static void serve_order(server_t *server, connection_t *connection, protocol_reader_t *request) 
+{
+    char orderNumber[MAX_ORDER_NUMBER];
+    protocol_get_string(request, orderNumber, sizeof(orderNumber));
+
+    if (request->failed || orderNumber[0] == '\0') 
+    {
+        reply_error(server, connection, PROTOCOL_INVALID, "order number missing or too long");
+        return;
+    }
+
+    //an order merges line items by product, so this only cuts off orders of thousands of products
+    size_t fits = (PROTOCOL_MAX_FRAME - 512) / (3 * sizeof(int32_t));
+    order_t *items = (order_t *)malloc(fits * sizeof(order_t));
+
+    if (!items) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t count = find_order(server->orders, orderNumber, items, fits);
+
+    if (count == 0) 
+    {
+        free(items);
+        reply_error(server, connection, PROTOCOL_NOT_FOUND, "order number not found");
+        return;
+    }
+
+    if (count > fits) 
+    {
+        count = fits;
+    }
+
+    size_t start = begin_reply(server, connection, PROTOCOL_OK, NULL);
+    protocol_put_string(&connection->output, customer_name(&server->orders->customers, items[0].customerId));
+    protocol_put_u16(&connection->output, (uint16_t)count);
+
+    for (size_t i = 0; i < count; i++) 
+    {
+        protocol_put_i32(&connection->output, items[i].productNumber);
+        protocol_put_i32(&connection->output, items[i].quantity);
+        protocol_put_i32(&connection->output, items[i].returnedQuantity);
+    }
+
+    protocol_end_frame(&connection->output, start);
+    free(items);
+}
+
+//renders one page of a listing, the rows before it are stepped over without being formatted
+static void serve_list(server_t *server, connection_t *connection, protocol_reader_t *request) 
+{
+    uint8_t listing = protocol_get_u8(request);
+    render_filter_t filter;
+    memset(&filter, 0, sizeof(filter)); //padding included, filters are compared whole
+
+    filter.kind = (filter_kind_t)protocol_get_u8(request);
+    filter.number = protocol_get_i32(request);
+    protocol_get_string(request, filter.text, sizeof(filter.text));
+    uint32_t skip = protocol_get_u32(request);
+    uint16_t rows = protocol_get_u16(request);
+
+    if (request->failed || listing > PROTOCOL_LIST_CATALOG || filter.kind > FILTER_DATE) 
+    {
+        reply_error(server, connection, PROTOCOL_INVALID, "malformed list request");
+        return;
+    }
+
+    //the catalog only narrows down by product and category
+    if (listing == PROTOCOL_LIST_CATALOG && filter.kind != FILTER_NONE && filter.kind != FILTER_PRODUCT && filter.kind != FILTER_CATEGORY) 
+    {
+        reply_error(server, connection, PROTOCOL_INVALID, "the catalog can only be listed by product or category");
+        return;
+    }
+
+    long firstDay;
+    long lastDay;
+
+    if (filter.kind == FILTER_DATE && !parse_date_range(filter.text, &firstDay, &lastDay)) 
+    {
+        reply_error(server, connection, PROTOCOL_INVALID, "dates are YYYY-MM-DD [YYYY-MM-DD]");
+        return;
+    }
+
+    if (rows == 0 || rows > SERVER_MAX_ROWS) 
+    {
+        rows = SERVER_MAX_ROWS;
+    }
+
+    filter.returned = listing == PROTOCOL_LIST_RETURNS;
+
+    const catalog_t *catalog = live_catalog_acquire(server->catalog);
+
+    //a category can be asked for by name
+    if (filter.kind == FILTER_CATEGORY && filter.text[0] != '\0') 
+    {
+        filter.number = find_category(catalog, filter.text);
+    }
+
+    if (filter.kind == FILTER_CATEGORY && (filter.number < 0 || (size_t)filter.number >= catalog->categoryCount)) 
+    {
+        live_catalog_release(server->catalog);
+        reply_error(server, connection, PROTOCOL_NOT_FOUND, "no such category");
+        return;
+    }
+
+    render_buffer_t buffer;
+    render_cursor_t *cursor = &connection->listCursor;
+    render_init(&buffer);
+
+    //asking for the page after the last one sent resumes from the saved cursor, anything else starts over
+    //(chunks never move, so the cursor stays valid as orders come in)
+    int resumes = skip > 0 && skip == connection->listRows && listing == connection->listing && catalog == connection->listCatalog &&
+                  memcmp(&filter, &connection->listFilter, sizeof(filter)) == 0;
+
+    if (!resumes) 
+    {
+        memset(cursor, 0, sizeof(*cursor));
+        connection->listFilter = filter;
+        connection->listing = listing;
+        connection->listCatalog = catalog;
+        connection->listRows = 0;
+
+        //the cursor is moved past the rows before the page without formatting them
+        if (skip > 0) 
+        {
+            if (listing == PROTOCOL_LIST_CATALOG) 
+            {
+                connection->listRows = (uint32_t)render_catalog(NULL, catalog, &filter, cursor, skip);
+            } else {
+                connection->listRows = (uint32_t)render_orders(NULL, server->orders, catalog, &filter, cursor, skip);
+            }
+        }
+    }
+
+    if (listing == PROTOCOL_LIST_CATALOG) 
+    {
+        connection->listRows += (uint32_t)render_catalog(&buffer, catalog, &filter, cursor, rows);
+    } else {
+        connection->listRows += (uint32_t)render_orders(&buffer, server->orders, catalog, &filter, cursor, rows);
+    }
+
+    live_catalog_release(server->catalog);
+
+    size_t start = begin_reply(server, connection, PROTOCOL_OK, NULL);
+    protocol_put_u8(&connection->output, cursor->done ? 0 : 1);
+    protocol_put_text(&connection->output, buffer.data, buffer.size);
+    protocol_end_frame(&connection->output, start);
+
+    render_free(&buffer);
+}
+
+//answers one complete request frame
+static void serve_request(server_t *server, connection_t *connection, const unsigned char *frame, size_t length) 
+{
+    protocol_reader_t request;
+    protocol_reader_init(&request, frame, length);
+
+    switch (protocol_get_u8(&request)) 
+    {
+        case PROTOCOL_PLACE:
+            serve_place(server, connection, &request);
+            break;
+        case PROTOCOL_RETURN:
+            serve_return(server, connection, &request);
+            break;
+        case PROTOCOL_PRODUCT:
+            serve_product(server, connection, &request);
+            break;
+        case PROTOCOL_ORDER:
+            serve_order(server, connection, &request);
+            break;
+        case PROTOCOL_LIST:
+            serve_list(server, connection, &request);
+            break;
+        default:
+            reply_error(server, connection, PROTOCOL_INVALID, "unknown request type");
+            break;
+    }
+
+    server->result->requests++;
+}
+
+//changes what epoll watches a client for, only when it differs
+static void watch_connection(server_t *server, connection_t *connection, unsigned int events) 
+{
+    if (connection->events == events) 
+    {
+        return;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = connection->fd;
+
+    epoll_ctl(server->epollFd, EPOLL_CTL_MOD, connection->fd, &event);
+    connection->events = events;
+}
+
+static void close_connection(server_t *server, connection_t *connection) 
+{
+    epoll_ctl(server->epollFd, EPOLL_CTL_DEL, connection->fd, NULL);
+    close(connection->fd);
+
+    server->connections[connection->fd] = NULL;
+    server->connectionCount--;
+
+    free(connection->input);
+    free(connection->confirmations);
+    protocol_buffer_free(&connection->output);
+    free(connection);
+}
+
+//accepts every client waiting on the listening socket
+static void accept_connections(server_t *server) 
+{
+    while (1) 
+    {
+        int fd = accept4(server->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (fd < 0) 
+        {
+            //EAGAIN once the backlog is empty, anything else is the client's problem
+            return;
+        }
+
+        if (server->connectionCount >= SERVER_MAX_CONNECTIONS) 
+        {
+            close(fd);
+            continue;
+        }
+
+        //the connection table grows by doubling to cover the highest descriptor
+        if ((size_t)fd >= server->connectionCapacity) 
+        {
+            size_t capacity = server->connectionCapacity == 0 ? 64 : server->connectionCapacity;
+            while (capacity <= (size_t)fd) 
+            {
+                capacity *= 2;
+            }
+
+            connection_t **connections = (connection_t **)realloc(server->connections, capacity * sizeof(connection_t *));
+
+            if (!connections) 
+            {
+                printf("Memory allocation failure.\n");
+                exit(EXIT_FAILURE);
+            }
+
+            memset(connections + server->connectionCapacity, 0, (capacity - server->connectionCapacity) * sizeof(connection_t *));
+            server->connections = connections;
+            server->connectionCapacity = capacity;
+        }
+
+        connection_t *connection = (connection_t *)calloc(1, sizeof(connection_t));
+
+        if (!connection) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        connection->fd = fd;
+        connection->events = EPOLLIN;
+        protocol_buffer_init(&connection->output);
+
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+
+        if (epoll_ctl(server->epollFd, EPOLL_CTL_ADD, fd, &event) != 0) 
+        {
+            close(fd);
+            free(connection);
+            continue;
+        }
+
+        server->connections[fd] = connection;
+        server->connectionCount++;
+        server->result->connections++;
+    }
+}
+
+//reads whatever the client has sent, returns 0 once it has hung up or failed
+static int receive(connection_t *connection) 
+{
+    while (1) 
+    {
+        //room for at least one more frame, a frame never grows the buffer past two of them
+        if (connection->inputCapacity - connection->inputSize < PROTOCOL_MAX_FRAME) 
+        {
+            size_t capacity = connection->inputSize + PROTOCOL_MAX_FRAME;
+            unsigned char *input = (unsigned char *)realloc(connection->input, capacity);
+
+            if (!input) 
+            {
+                printf("Memory allocation failure.\n");
+                exit(EXIT_FAILURE);
+            }
+
+            connection->input = input;
+            connection->inputCapacity = capacity;
+        }
+
+        ssize_t received = recv(connection->fd, connection->input + connection->inputSize,
+                                connection->inputCapacity - connection->inputSize, 0);
+
+        if (received > 0) 
+        {
+            connection->inputSize += (size_t)received;
+
+            //level-triggered, so the rest is picked up on the next wait once these frames are answered
+            if (connection->inputSize >= PROTOCOL_MAX_FRAME) 
+            {
+                return 1;
+            }
+        } else if (received == 0) 
+        {
+            return 0;
+        } else {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+    }
+}
+
+//answers the complete frames received so far, unless too many replies are already waiting, returns 0 on a malformed frame
+static int answer(server_t *server, connection_t *connection) 
+{
+    size_t position = 0;
+    int valid = 1;
+
+    while (connection->output.size - connection->outputSent < SERVER_MAX_PENDING) 
+    {
+        size_t length = protocol_frame_length(connection->input + position, connection->inputSize - position);
+
+        if (length == (size_t)-1) 
+        {
+            valid = 0;
+            break;
+        }
+
+        if (length == 0) 
+        {
+            break;
+        }
+
+        serve_request(server, connection, connection->input + position, length);
+        position += length;
+    }
+
+    //keep the partial frame (and any frames held back) at the start of the buffer
+    memmove(connection->input, connection->input + position, connection->inputSize - position);
+    connection->inputSize -= position;
+
+    return valid;
+}
+
+//sends as many waiting replies as the socket takes, returns 0 if the client is gone
+static int transmit(connection_t *connection) 
+{
+    while (connection->outputSent < connection->output.size) 
+    {
+        ssize_t sent = send(connection->fd, connection->output.data + connection->outputSent,
+                            connection->output.size - connection->outputSent, MSG_NOSIGNAL);
+
+        if (sent < 0) 
+        {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+
+        connection->outputSent += (size_t)sent;
+    }
+
+    //everything went out, start the buffer over
+    connection->output.size = 0;
+    connection->outputSent = 0;
+
+    return 1;
+}
+
+//reads and answers for one client, the replies wait in its output until the end of the round
+static void serve_connection(server_t *server, connection_t *connection, unsigned int events) 
+{
+    if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !receive(connection)) 
+    {
+        connection->closing = 1;
+    }
+
+    if (!answer(server, connection)) 
+    {
+        connection->closing = 1;
+    }
+
+    if (!connection->replying) 
+    {
+        connection->replying = 1;
+        server->replying[server->replyingCount++] = connection;
+    }
+}
+
+//sends what a client was answered this round, then watches it for whatever it's waiting on
+static void reply_to_connection(server_t *server, connection_t *connection) 
+{
+    connection->replying = 0;
+    connection->confirmationCount = 0;
+
+    //a client that hung up still gets the replies that fit in the socket
+    if (!transmit(connection) || connection->closing) 
+    {
+        close_connection(server, connection);
+        return;
+    }
+
+    int backlogged = connection->output.size - connection->outputSent >= SERVER_MAX_PENDING ||
+                     connection->inputSize >= PROTOCOL_MAX_FRAME;
+    unsigned int watched = 0;
+
+    //a client that doesn't read its replies isn't read from until it catches up
+    if (!backlogged) 
+    {
+        watched |= EPOLLIN;
+    }
+
+    //frames held back behind unsent replies are answered in a later round, a writable socket starts it
+    if (connection->outputSent < connection->output.size || protocol_frame_length(connection->input, connection->inputSize) != 0) 
+    {
+        watched |= EPOLLOUT;
+    }
+
+    watch_connection(server, connection, watched);
+}
+
+//binds the listening socket, replacing a socket file left behind by a server that is no longer running
+static int listen_on(const char *socketPath) 
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (strlen(socketPath) >= sizeof(address.sun_path)) 
+    {
+        printf("Socket path too long: %s\n", socketPath);
+        return -1;
+    }
+
+    strcpy(address.sun_path, socketPath);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd < 0) 
+    {
+        printf("Error creating socket: %s\n", socketPath);
+        return -1;
+    }
+
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0) 
+    {
+        if (errno != EADDRINUSE) 
+        {
+            printf("Error binding socket: %s\n", socketPath);
+            close(fd);
+            return -1;
+        }
+
+        //only a socket nobody answers on is stale
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int live = probe >= 0 && connect(probe, (struct sockaddr *)&address, sizeof(address)) == 0;
+
+        if (probe >= 0) 
+        {
+            close(probe);
+        }
+
+        if (live) 
+        {
+            printf("Another server is already running on %s\n", socketPath);
+            close(fd);
+            return -1;
+        }
+
+        unlink(socketPath);
+
+        if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0) 
+        {
+            printf("Error binding socket: %s\n", socketPath);
+            close(fd);
+            return -1;
+        }
+    }
+
+    if (listen(fd, SOMAXCONN) != 0) 
+    {
+        printf("Error listening on socket: %s\n", socketPath);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int run_server(const char *socketPath, order_list_t *orders, live_catalog_t *catalog, server_result_t *result) 
+{
+    server_t server;
+    memset(&server, 0, sizeof(server));
+    memset(result, 0, sizeof(*result));
+
+    server.orders = orders;
+    server.catalog = catalog;
+    server.result = result;
+
+    //SIGINT and SIGTERM arrive as events, so shutdown happens between requests
+    //(blocked here for this thread, server_block_signals covers the threads started before it)
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    server.signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    server.listenFd = listen_on(socketPath);
+    server.epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (server.signalFd < 0 || server.listenFd < 0 || server.epollFd < 0) 
+    {
+        if (server.listenFd >= 0) 
+        {
+            close(server.listenFd);
+            unlink(socketPath);
+        }
+        if (server.signalFd >= 0) 
+        {
+            close(server.signalFd);
+        }
+        if (server.epollFd >= 0) 
+        {
+            close(server.epollFd);
+        }
+        return -1;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = server.listenFd;
+    epoll_ctl(server.epollFd, EPOLL_CTL_ADD, server.listenFd, &event);
+    event.data.fd = server.signalFd;
+    epoll_ctl(server.epollFd, EPOLL_CTL_ADD, server.signalFd, &event);
+
+    printf("Serving orders on %s, stop with Ctrl+C\n", socketPath);
+    fflush(stdout);
+
+    struct epoll_event events[SERVER_MAX_EVENTS];
+
+    while (!server.stopping) 
+    {
+        int ready = epoll_wait(server.epollFd, events, SERVER_MAX_EVENTS, -1);
+
+        if (ready < 0) 
+        {
+            if (errno == EINTR) 
+            {
+                continue;
+            }
+            break;
+        }
+
+        for (int i = 0; i < ready; i++) 
+        {
+            int fd = events[i].data.fd;
+
+            if (fd == server.listenFd) 
+            {
+                accept_connections(&server);
+            } else if (fd == server.signalFd) 
+            {
+                server.stopping = 1;
+            } else if ((size_t)fd < server.connectionCapacity && server.connections[fd] != NULL) 
+            {
+                serve_connection(&server, server.connections[fd], events[i].events);
+            }
+        }
+
+        //a placed order or return is only confirmed once its records are written (and synced, per the policy),
+        //one flush covers every request of the round
+        if (server.journaled && orders->journal != NULL && flush_journal(orders->journal) != 0) 
+        {
+            if (!server.readOnly) 
+            {
+                printf("The journal could not be written, orders and returns are refused from now on.\n");
+                fflush(stdout);
+            }
+
+            server.readOnly = 1;
+
+            for (size_t i = 0; i < server.replyingCount; i++) 
+            {
+                fail_confirmations(&server, server.replying[i]);
+            }
+        }
+        server.journaled = 0;
+
+        for (size_t i = 0; i < server.replyingCount; i++) 
+        {
+            reply_to_connection(&server, server.replying[i]);
+        }
+        server.replyingCount = 0;
+    }
+
+    //every reply that went out was journaled first, requests not answered yet are dropped with their clients
+    for (size_t fd = 0; fd < server.connectionCapacity; fd++) 
+    {
+        if (server.connections[fd] != NULL) 
+        {
+            close_connection(&server, server.connections[fd]);
+        }
+    }
+
+    free(server.connections);
+    close(server.listenFd);
+    close(server.signalFd);
+    close(server.epollFd);
+    unlink(socketPath);
+
+    return 0;
+}
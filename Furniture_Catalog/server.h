@@ -0,0 +1,30 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "catalog_system.h"
+#include "live_catalog.h"
+
+#define SERVER_MAX_CONNECTIONS 1024     //clients connected at once, more are turned away
+#define SERVER_MAX_EVENTS 64            //readiness events taken from epoll per wait
+#define SERVER_MAX_PENDING (1024 * 1024) //reply bytes a client may leave unread before its requests wait
+#define SERVER_MAX_ROWS 200             //listing rows one list request returns at most
+
+//counts from one server run
+typedef struct {
+    size_t connections; //clients accepted
+    size_t requests;    //requests answered
+    size_t rejected;    //requests answered with anything but PROTOCOL_OK
+} server_result_t;
+
+//function declarations
+
+//blocks SIGINT and SIGTERM so the server can take them from its event loop instead
+//must run before any other thread is started, threads inherit the mask
+void server_block_signals(void);
+
+/*serves place, return, product, order and list requests (see protocol.h) on a Unix domain socket until
+SIGINT or SIGTERM, one thread answers every client from a non-blocking epoll loop so the orders have a
+single owner. Returns 0 after a clean shutdown and -1 if the socket couldn't be set up*/
+int run_server(const char *socketPath, order_list_t *orders, live_catalog_t *catalog, server_result_t *result);
+
+#endif /* SERVER_H */
@@ -0,0 +1,385 @@
+/*
+Binary snapshots of the customer order information. A snapshot is one header, arrays of fixed-size
+line item and return records and a table of customer names, so loading is a single mmap plus a pass over the records instead of parsing
+'customer_information.txt' line by line.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snapshot.h"
+#include "stats.h"
+
+//growable table of NUL-terminated strings written after the records
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+} string_table_t;
+
+//appends a string to the table and returns its offset
+static uint32_t add_string(string_table_t *table, const char *text) 
+{
+    size_t length = strlen(text) + 1;
+
+    if (table->size + length > table->capacity) 
+    {
+        size_t capacity = table->capacity == 0 ? 4096 : table->capacity;
+        while (capacity < table->size + length) 
+        {
+            capacity *= 2;
+        }
+
+        char *data = (char *)realloc(table->data, capacity);
+
+        if (!data) 
+        {
+            printf("Memory allocation failure.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        table->data = data;
+        table->capacity = capacity;
+    }
+
+    uint32_t offset = (uint32_t)table->size;
+    memcpy(table->data + table->size, text, length);
+    table->size += length;
+
+    return offset;
+}
+
+//writes the line items (or the returns ledger) of every shard as records, returns how many were written
+static uint64_t write_records(FILE *file, const order_list_t *orders, int returns) 
+{
+    snapshot_record_t record = { 0, 0, 0, 0, 0, 0, 0 };
+    uint64_t written = 0;
+
+    for (size_t s = 0; s < ORDER_SHARDS; s++) 
+    {
+        const order_store_t *store = returns ? &orders->shards[s].returns.entries : &orders->shards[s].current;
+
+        for (const order_chunk_t *chunk = store->head; chunk != NULL; chunk = chunk->next) 
+        {
+            for (size_t i = 0; i < chunk->count; i++) 
+            {
+                const order_t *order = &chunk->orders[i];
+
+                //customer IDs are written as they are, the string table keeps the pool's order
+                record.orderId = order->orderId;
+                record.customerId = order->customerId;
+                record.productNumber = order->productNumber;
+                record.quantity = order->quantity;
+                record.returnedQuantity = returns ? 0 : order->returnedQuantity;
+                record.placedAt = order->placedAt;
+
+                fwrite(&record, sizeof(record), 1, file);
+                written++;
+            }
+        }
+    }
+
+    return written;
+}
+
+int save_snapshot(const order_list_t *orders, const char *filename) 
+{
+    //write to a temporary file and rename it over the old snapshot so a crash never leaves half a file
+    char tempFilename[FILENAME_MAX];
+    snprintf(tempFilename, sizeof(tempFilename), "%s.tmp", filename);
+
+    FILE *file = fopen(tempFilename, "wb");
+
+    if (!file) 
+    {
+        printf("Error opening file: %s\n", tempFilename);
+        return -1;
+    }
+
+    snapshot_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.recordSize = sizeof(snapshot_record_t);
+    header.journalSequence = orders->journalSequence;
+
+    //the header is rewritten with the final counts once the records are out
+    fwrite(&header, sizeof(header), 1, file);
+
+    //every line item, then every return in the same layout
+    header.recordCount = write_records(file, orders, 0);
+    header.returnCount = write_records(file, orders, 1);
+
+    //with every shard locked no line item can bring in a new customer, so the names cover every record
+    string_table_t strings = { NULL, 0, 0 };
+    header.customerCount = atomic_load(&((order_list_t *)orders)->customers.count);
+
+    for (unsigned int id = 0; id < header.customerCount; id++) 
+    {
+        add_string(&strings, customer_name(&orders->customers, id));
+    }
+
+    header.stringsSize = strings.size;
+
+    if (strings.size > 0) 
+    {
+        fwrite(strings.data, 1, strings.size, file);
+    }
+    free(strings.data);
+
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+
+    //the data reaches the disk before the rename can, or a crash could leave the new name on an empty file
+    int failed = fflush(file) != 0 || ferror(file) || fsync(fileno(file)) != 0;
+
+    if (fclose(file) != 0 || failed) 
+    {
+        printf("Error writing file: %s\n", tempFilename);
+        remove(tempFilename);
+        return -1;
+    }
+
+    if (rename(tempFilename, filename) != 0 || sync_directory_of(filename) != 0) 
+    {
+        printf("Error writing file: %s\n", filename);
+        return -1;
+    }
+
+    return 0;
+}
+
+int replace_file(const char *filename, const void *data, size_t size) 
+{
+    char tempFilename[FILENAME_MAX];
+    snprintf(tempFilename, sizeof(tempFilename), "%s.tmp", filename);
+
+    FILE *file = fopen(tempFilename, "wb");
+
+    if (!file) 
+    {
+        printf("Error opening file: %s\n", tempFilename);
+        return -1;
+    }
+
+    int failed = fwrite(data, 1, size, file) != size || fflush(file) != 0 || fsync(fileno(file)) != 0;
+
+    if (fclose(file) != 0 || failed) 
+    {
+        printf("Error writing file: %s\n", tempFilename);
+        remove(tempFilename);
+        return -1;
+    }
+
+    if (rename(tempFilename, filename) != 0 || sync_directory_of(filename) != 0) 
+    {
+        printf("Error writing file: %s\n", filename);
+        return -1;
+    }
+
+    return 0;
+}
+
+int sync_directory_of(const char *filename) 
+{
+    char directory[FILENAME_MAX];
+    snprintf(directory, sizeof(directory), "%s", filename);
+
+    char *slash = strrchr(directory, '/');
+
+    if (slash == NULL) 
+    {
+        snprintf(directory, sizeof(directory), ".");
+    } else if (slash == directory) 
+    {
+        slash[1] = '\0';
+    } else {
+        *slash = '\0';
+    }
+
+    int fd = open(directory, O_RDONLY | O_DIRECTORY);
+
+    if (fd < 0) 
+    {
+        return -1;
+    }
+
+    int result = fsync(fd);
+    close(fd);
+
+    return result;
+}
+
+long long read_snapshot(const char *filename, customer_pool_t *customers, snapshot_visit_t visit, void *context,
+                        unsigned long long *journalSequence) 
+{
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0) 
+    {
+        return -1;
+    }
+
+    struct stat info;
+
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(snapshot_header_t)) 
+    {
+        close(fd);
+        return -1;
+    }
+
+    size_t fileSize = (size_t)info.st_size;
+    const unsigned char *mapped = (const unsigned char *)mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapped == MAP_FAILED) 
+    {
+        return -1;
+    }
+
+    //version 4 records are the same up to the placement time they don't have
+    const snapshot_header_t *header = (const snapshot_header_t *)mapped;
+    size_t recordSize = header->version == SNAPSHOT_VERSION ? sizeof(snapshot_record_t) : SNAPSHOT_RECORD_V4_SIZE;
+    size_t recordRoom = (fileSize - sizeof(snapshot_header_t)) / recordSize;
+
+    //the counts are checked against what fits in the file before they're multiplied, so a corrupt header can't wrap
+    int countsFit = header->recordCount <= recordRoom && header->returnCount <= recordRoom - header->recordCount;
+    size_t recordsEnd = countsFit ? sizeof(snapshot_header_t) + (header->recordCount + header->returnCount) * recordSize : fileSize + 1;
+
+    //refuse anything written by another version, layout or byte order, or cut short
+    //every name takes at least its terminator, so there can't be more names than string bytes
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version < SNAPSHOT_OLDEST_VERSION || header->version > SNAPSHOT_VERSION || header->byteOrder != SNAPSHOT_BYTE_ORDER ||
+        header->recordSize != recordSize || recordsEnd > fileSize ||
+        header->stringsSize != fileSize - recordsEnd || header->customerCount > header->stringsSize ||
+        (header->stringsSize > 0 && mapped[fileSize - 1] != '\0')) {
+        printf("Invalid snapshot file: %s\n", filename);
+        munmap((void *)mapped, fileSize);
+        return -1;
+    }
+
+    if (journalSequence != NULL) 
+    {
+        *journalSequence = header->journalSequence;
+    }
+
+    //records and strings are used straight out of the mapping
+    const unsigned char *records = mapped + sizeof(snapshot_header_t);
+    const char *strings = (const char *)(mapped + recordsEnd);
+    long long loaded = 0;
+
+    //the names are interned once, records then only translate the snapshot's customer ID to the pool's
+    unsigned int *customerIds = (unsigned int *)malloc((header->customerCount + 1) * sizeof(unsigned int));
+
+    if (!customerIds) 
+    {
+        printf("Memory allocation failure.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t customerCount = 0;
+
+    for (size_t offset = 0; offset < header->stringsSize && customerCount < header->customerCount; customerCount++) 
+    {
+        customerIds[customerCount] = customers != NULL ? intern_customer(customers, strings + offset) : (unsigned int)customerCount;
+        offset += strlen(strings + offset) + 1;
+    }
+
+    for (uint64_t i = 0; i < header->recordCount + header->returnCount; i++) 
+    {
+        const snapshot_record_t *record = (const snapshot_record_t *)(records + i * recordSize);
+
+        if (record->customerId >= customerCount) 
+        {
+            printf("Invalid snapshot record %llu in %s\n", (unsigned long long)i, filename);
+            continue;
+        }
+
+        order_t order;
+        order.orderId = record->orderId;
+        order.customerId = customerIds[record->customerId];
+        order.productNumber = record->productNumber;
+        order.quantity = record->quantity;
+        order.returnedQuantity = record->returnedQuantity;
+        order.placedAt = header->version == SNAPSHOT_VERSION ? record->placedAt : 0;
+        order.column = 0;
+
+        if (i < header->recordCount) 
+        {
+            order.isReturn = order.returnedQuantity >= order.quantity;
+            visit(context, &order, 0);
+            loaded++;
+        } else {
+            order.isReturn = 1;
+            visit(context, &order, 1);
+        }
+    }
+
+    free(customerIds);
+    munmap((void *)mapped, fileSize);
+
+    STATS_ADD(STATS_RECORDS_PARSED, (unsigned long long)loaded);
+
+    return loaded;
+}
+
+//adds a snapshot record to the order list it was read for
+static void load_record(void *context, const order_t *order, int isReturnEntry) 
+{
+    order_list_t *orders = (order_list_t *)context;
+
+    if (isReturnEntry) 
+    {
+        add_return_entry(orders, order);
+    } else {
+        add_line_item(orders, order);
+    }
+
+    observe_order_number(&orders->sequence, order->orderId);
+}
+
+long long load_snapshot(order_list_t *orders, const char *filename) 
+{
+    //journal records up to the snapshot's are already part of it
+    return read_snapshot(filename, &orders->customers, load_record, orders, &orders->journalSequence);
+}
+
+int snapshot_is_current(const char *snapshotFilename, const char *textFilename) 
+{
+    struct stat snapshotInfo;
+    struct stat textInfo;
+
+    if (stat(snapshotFilename, &snapshotInfo) != 0) 
+    {
+        return 0;
+    }
+
+    //a text file edited after the snapshot was written wins
+    return stat(textFilename, &textInfo) != 0 || textInfo.st_mtime <= snapshotInfo.st_mtime;
+}
+
+int convert_customer_information(const char *textFilename, const char *returnsFilename, const char *snapshotFilename) 
+{
+    order_list_t *orders = create_orders();
+
+    load_customer_information(orders, textFilename);
+    load_customer_returns(orders, returnsFilename);
+
+    int result = save_snapshot(orders, snapshotFilename);
+
+    if (result == 0) 
+    {
+        printf("Converted %zu line items from %s to %s\n", count_line_items(orders), textFilename, snapshotFilename);
+    }
+
+    free_orders(orders);
+
+    return result;
+}
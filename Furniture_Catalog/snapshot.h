@@ -0,0 +1,75 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "catalog_system.h"
+
+#define SNAPSHOT_MAGIC "FCSNAP\0" //8 bytes including the terminator
+#define SNAPSHOT_VERSION 5
+#define SNAPSHOT_OLDEST_VERSION 4 //still read, its records have no placement time
+#define SNAPSHOT_BYTE_ORDER 0x01020304u //reads back differently on a machine of the other endianness
+
+/*binary snapshot of the order store:
+header, then recordCount line item records, then returnCount returns ledger records in the same layout,
+then a string table holding the customerCount customer names in ID order*/
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t recordSize;  //sizeof(snapshot_record_t) when the file was written
+    uint32_t reserved;
+    uint64_t journalSequence; //last journal record folded into this snapshot
+    uint64_t recordCount;
+    uint64_t returnCount; //ledger records, they follow the line items
+    uint64_t customerCount; //names in the string table
+    uint64_t stringsSize; //bytes in the string table, which follows the records
+} snapshot_header_t;
+
+//one line item or one return
+typedef struct {
+    uint64_t orderId;
+    uint32_t customerId; //position of the name in the string table
+    int32_t productNumber;
+    int32_t quantity;         //units returned for a return
+    int32_t returnedQuantity; //0 for a return
+    uint32_t placedAt;        //when the order was placed, not in version 4 records (which end here)
+    uint32_t reserved;
+} snapshot_record_t;
+
+#define SNAPSHOT_RECORD_V4_SIZE offsetof(snapshot_record_t, placedAt)
+
+//called for every line item (isReturnEntry 0) and every return (isReturnEntry 1) read from a snapshot
+typedef void (*snapshot_visit_t)(void *context, const order_t *order, int isReturnEntry);
+
+//function declarations
+
+//writes every line item and return of the orders to a snapshot file, returns 0 on success and -1 on failure
+//the file and the rename into place are on disk before it returns; the caller holds every shard lock (see
+//compact_journal) or is the only thread
+int save_snapshot(const order_list_t *orders, const char *filename);
+
+//maps a snapshot file and bulk-loads its line items and returns, returns the number of line items loaded or -1 if the file is missing or invalid
+long long load_snapshot(order_list_t *orders, const char *filename);
+
+//maps a snapshot file and hands every record to visit, with its customer interned into customers
+//(or left as the file's own customer ID when customers is NULL)
+//returns the number of line items read or -1 if the file is missing or invalid, journalSequence may be NULL
+long long read_snapshot(const char *filename, customer_pool_t *customers, snapshot_visit_t visit, void *context,
+                        unsigned long long *journalSequence);
+
+//replaces a file with size bytes of data through a synced temp file renamed over it, so a crash leaves
+//either the old contents or the new ones, returns 0 on success and -1 on failure
+int replace_file(const char *filename, const void *data, size_t size);
+
+//syncs the directory holding a file, so a file created or renamed there survives a crash, returns 0 on success and -1 on failure
+int sync_directory_of(const char *filename);
+
+//checks that a snapshot exists and was written no earlier than the text file it stands in for
+int snapshot_is_current(const char *snapshotFilename, const char *textFilename);
+
+//converts a 'customer_information.txt' style text file and its returns ledger ('customer_returns.txt', may be
+//missing) into a snapshot, returns 0 on success and -1 on failure
+int convert_customer_information(const char *textFilename, const char *returnsFilename, const char *snapshotFilename);
+
+#endif /* SNAPSHOT_H */
@@ -0,0 +1,159 @@
+/*
+Instrumentation for the catalog system. Every timed operation has a histogram of log2 nanosecond buckets and
+every counter is a single atomic, so recording from many threads takes no locks. The report gives
+percentiles as the upper bound of the bucket they fall in.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "stats.h"
+
+static const char *const opNames[STATS_OP_COUNT] = {
+    "load_catalog_from_file",
+    "load_customer_information",
+    "save_customer_information",
+    "place_order",
+    "process_return",
+    "find_product",
+    "find_order",
+    "find_category",
+    "journal_commit"
+};
+
+static const char *const counterNames[STATS_COUNTER_COUNT] = {
+    "records_parsed",
+    "lookups",
+    "lookup_misses",
+    "allocations",
+    "bytes_allocated",
+    "journal_records"
+};
+
+#ifdef CATALOG_STATS
+
+//latency histogram of one operation
+typedef struct {
+    _Atomic unsigned long long buckets[STATS_BUCKETS];
+    _Atomic unsigned long long count;
+    _Atomic unsigned long long totalNs;
+    _Atomic unsigned long long maxNs;
+} stats_histogram_t;
+
+static stats_histogram_t histograms[STATS_OP_COUNT];
+static _Atomic unsigned long long counters[STATS_COUNTER_COUNT];
+
+long long stats_now_ns(void) 
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void stats_record(stats_op_t op, long long elapsedNs) 
+{
+    stats_histogram_t *histogram = &histograms[op];
+    unsigned long long value = elapsedNs > 0 ? (unsigned long long)elapsedNs : 0;
+    unsigned long long shifted = value;
+    size_t bucket = 0;
+
+    //position of the highest set bit
+    while (shifted > 1) 
+    {
+        shifted >>= 1;
+        bucket++;
+    }
+
+    atomic_fetch_add_explicit(&histogram->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->totalNs, value, memory_order_relaxed);
+
+    unsigned long long max = atomic_load_explicit(&histogram->maxNs, memory_order_relaxed);
+    while (value > max && !atomic_compare_exchange_weak_explicit(&histogram->maxNs, &max, value,
+                                                                 memory_order_relaxed, memory_order_relaxed));
+}
+
+void stats_add(stats_counter_t counter, unsigned long long amount) 
+{
+    atomic_fetch_add_explicit(&counters[counter], amount, memory_order_relaxed);
+}
+
+//upper bound of the bucket that holds the given fraction of an operation's timings
+static unsigned long long percentile(stats_histogram_t *histogram, unsigned long long count, double fraction) 
+{
+    unsigned long long rank = (unsigned long long)(count * fraction);
+    unsigned long long seen = 0;
+
+    for (size_t b = 0; b < STATS_BUCKETS; b++) 
+    {
+        seen += atomic_load_explicit(&histogram->buckets[b], memory_order_relaxed);
+
+        if (seen > rank) 
+        {
+            return b >= 63 ? ~0ULL : (2ULL << b) - 1;
+        }
+    }
+
+    return atomic_load_explicit(&histogram->maxNs, memory_order_relaxed);
+}
+
+void stats_print(FILE *file) 
+{
+    fprintf(file, "%-26s %10s %12s %10s %10s %10s %12s\n", "operation", "count", "total ms", "mean ns", "p50 ns", "p99 ns", "max ns");
+
+    for (size_t op = 0; op < STATS_OP_COUNT; op++) 
+    {
+        stats_histogram_t *histogram = &histograms[op];
+        unsigned long long count = atomic_load_explicit(&histogram->count, memory_order_relaxed);
+        unsigned long long total = atomic_load_explicit(&histogram->totalNs, memory_order_relaxed);
+
+        if (count == 0) 
+        {
+            fprintf(file, "%-26s %10d\n", opNames[op], 0);
+            continue;
+        }
+
+        fprintf(file, "%-26s %10llu %12.3f %10llu %10llu %10llu %12llu\n", opNames[op], count, total / 1e6,
+                total / count, percentile(histogram, count, 0.5), percentile(histogram, count, 0.99),
+                atomic_load_explicit(&histogram->maxNs, memory_order_relaxed));
+    }
+
+    fprintf(file, "\n");
+
+    for (size_t c = 0; c < STATS_COUNTER_COUNT; c++) 
+    {
+        fprintf(file, "%-26s %10llu\n", counterNames[c], atomic_load_explicit(&counters[c], memory_order_relaxed));
+    }
+}
+
+void stats_dump(const char *filename) 
+{
+    FILE *file = fopen(filename, "w");
+
+    if (!file) 
+    {
+        printf("Error opening file: %s\n", filename);
+        return;
+    }
+
+    stats_print(file);
+    fclose(file);
+}
+
+#else
+
+void stats_print(FILE *file) 
+{
+    (void)opNames;
+    (void)counterNames;
+    fprintf(file, "Statistics are not compiled in, rebuild with -DCATALOG_STATS to collect them.\n");
+}
+
+void stats_dump(const char *filename) 
+{
+    (void)filename;
+}
+
+#endif /* CATALOG_STATS */
@@ -0,0 +1,68 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+/*latency and throughput instrumentation, compiled in with -DCATALOG_STATS
+without it the STATS_ macros expand to nothing and the hot paths are unchanged*/
+
+#define STATS_FILE "catalog_stats.txt" //written on exit when statistics are compiled in
+#define STATS_BUCKETS 64                //log2 latency buckets, bucket b holds times below 2^(b+1) ns
+
+//timed operations
+typedef enum {
+    STATS_LOAD_CATALOG,
+    STATS_LOAD_CUSTOMERS,
+    STATS_SAVE_CUSTOMERS,
+    STATS_PLACE_ORDER,
+    STATS_PROCESS_RETURN,
+    STATS_FIND_PRODUCT,
+    STATS_FIND_ORDER,
+    STATS_FIND_CATEGORY,
+    STATS_JOURNAL_COMMIT,
+    STATS_OP_COUNT
+} stats_op_t;
+
+//plain counters
+typedef enum {
+    STATS_RECORDS_PARSED,  //products and line items read from any file
+    STATS_LOOKUPS,         //product, order and category lookups
+    STATS_LOOKUP_MISSES,   //lookups that found nothing
+    STATS_ALLOCATIONS,     //arena blocks and catalog product arrays allocated
+    STATS_BYTES_ALLOCATED,
+    STATS_JOURNAL_RECORDS, //order and return records the journal writer wrote
+    STATS_COUNTER_COUNT
+} stats_counter_t;
+
+#ifdef CATALOG_STATS
+
+//monotonic clock in nanoseconds
+long long stats_now_ns(void);
+
+//adds one timing to an operation's histogram
+void stats_record(stats_op_t op, long long elapsedNs);
+
+//adds to a counter
+void stats_add(stats_counter_t counter, unsigned long long amount);
+
+#define STATS_START(timer) long long timer = stats_now_ns()
+#define STATS_STOP(op, timer) stats_record((op), stats_now_ns() - (timer))
+#define STATS_ADD(counter, amount) stats_add((counter), (amount))
+
+#else
+
+#define STATS_START(timer)
+#define STATS_STOP(op, timer) ((void)0)
+#define STATS_ADD(counter, amount) ((void)0)
+
+#endif /* CATALOG_STATS */
+
+//function declarations
+
+//prints every operation's count, mean, p50, p99 and max and every counter
+void stats_print(FILE *file);
+
+//writes the statistics to a file, does nothing when they aren't compiled in
+void stats_dump(const char *filename);
+
+#endif /* STATS_H */